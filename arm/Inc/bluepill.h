@@ -63,5 +63,11 @@ void uart_init_rts_cts(void);
 
 #define uart_init_extra()
 
+// ----- JOYSTICK -----
+#define JOY_BUFFER_SIZE      2048
+
+// ----- TRACE -----
+#define TRACE_SIZE           512
+
 #endif
 
@@ -0,0 +1,56 @@
+/*
+ * usbd_composite.h - usb composite device with data and telemetry cdc
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef USBD_COMPOSITE_H
+#define USBD_COMPOSITE_H
+
+#include "usbd_cdc.h"
+
+// interfaces 0/1 are the data cdc of USBD_CDC
+// interfaces 2/3 are the telemetry cdc
+#define TEL_COMM_ITF        2
+#define TEL_DATA_ITF        3
+
+#define TEL_IN_EP           0x83
+#define TEL_OUT_EP          0x03
+#define TEL_CMD_EP          0x84
+
+#define TEL_PACKET_SIZE     CDC_DATA_FS_MAX_PACKET_SIZE
+
+// config + 2 * (iad + cdc function)
+#define USB_COMPOSITE_CONFIG_DESC_SIZ   (9 + 2 * (8 + 58))
+
+extern USBD_ClassTypeDef USBD_Composite;
+
+// start sending a telemetry packet. returns USBD_BUSY if one is in flight
+uint8_t USBD_Tel_Transmit(USBD_HandleTypeDef *pdev,uint8_t *buf,uint16_t len);
+
+// callbacks of the telemetry channel (called in usb irq)
+// host opened (dtr=1) or closed (dtr=0) the telemetry port
+extern void telemetry_usb_open(uint8_t dtr);
+// last packet was sent
+extern void telemetry_usb_sent(void);
+// device was configured or reset
+extern void telemetry_usb_reset(void);
+
+#endif
@@ -179,6 +179,19 @@ void dtvlow_recv_delay(uint8_t delay)
   // shouldn't actually be needed.
 }
 
+uint8_t hal_irq_disable(void)
+{
+  uint8_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+void hal_irq_restore(uint8_t state)
+{
+  if(!(state & 1))
+    __enable_irq();
+}
+
 void joy_begin(void)
 {
   joy_out(0);
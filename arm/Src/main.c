@@ -63,6 +63,7 @@
 #include "timer.h"
 #include "dtvlow.h"
 #include "param.h"
+#include "telemetry.h"
 
 /* USER CODE END Includes */
 
@@ -145,6 +146,9 @@ int main(void)
 
   /* USER CODE BEGIN 3 */
     cmdline_handle();
+#ifdef USE_TELEMETRY
+    telemetry_poll();
+#endif
   }
   /* USER CODE END 3 */
 
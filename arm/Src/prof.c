@@ -0,0 +1,60 @@
+/*
+ * prof.c - cycle profiler of the firmware hot paths
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include <stdint.h>
+
+#include <stm32f1xx_hal.h>
+
+#include "board.h"
+
+#include "timer.h"
+#include "prof.h"
+
+#ifdef USE_PROF
+
+prof_entry_t prof[PROF_NUM];
+
+void prof_add(uint8_t id,uint32_t cycles)
+{
+  prof_entry_t *p = &prof[id];
+  p->calls++;
+  p->cycles += cycles;
+  if(cycles > p->max)
+    p->max = cycles;
+}
+
+void prof_reset(void)
+{
+  for(uint8_t i=0;i<PROF_NUM;i++) {
+    prof[i].calls  = 0;
+    prof[i].cycles = 0;
+    prof[i].max    = 0;
+  }
+}
+
+uint8_t prof_ticks_per_us(void)
+{
+  return SystemCoreClock / 1000000;
+}
+
+#endif
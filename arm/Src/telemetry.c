@@ -0,0 +1,248 @@
+/*
+ * telemetry.c - live telemetry stream on the second cdc interface
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include <stdint.h>
+
+#include "usb_device.h"
+#include "usbd_composite.h"
+
+#include "board.h"
+
+#include "hal.h"
+#include "timer.h"
+#include "util.h"
+#include "transfer.h"
+#include "stats.h"
+#include "telemetry.h"
+
+#ifdef USE_TELEMETRY
+
+#define TEL_MASK  (TELEMETRY_SIZE-1)
+
+// ring buffer: head is written in main, tail in usb irq or with irqs off
+static uint8_t tel_buf[TELEMETRY_SIZE];
+static volatile uint16_t tel_head;
+static volatile uint16_t tel_tail;
+
+// host has opened the port
+static volatile uint8_t tel_open;
+// a packet is in flight
+static volatile uint8_t tel_sending;
+static uint8_t tel_packet[TEL_PACKET_SIZE];
+
+static uint16_t tel_dropped;
+static uint16_t stats_time;
+static uint32_t block_start;
+
+// line being formatted (S line is the longest)
+static uint8_t line[16 + STATS_NUM * 9 + 2];
+static uint8_t line_len;
+
+// ----- ring buffer -----
+
+// send next packet. call in usb irq or with irqs disabled
+static void tel_flush(void)
+{
+  if(tel_sending)
+    return;
+
+  uint16_t tail = tel_tail;
+  uint16_t n = (tel_head - tail) & TEL_MASK;
+  if(n == 0)
+    return;
+  if(n > TEL_PACKET_SIZE)
+    n = TEL_PACKET_SIZE;
+
+  for(uint16_t i=0;i<n;i++) {
+    tel_packet[i] = tel_buf[tail];
+    tail = (tail + 1) & TEL_MASK;
+  }
+  if(USBD_Tel_Transmit(&hUsbDeviceFS,tel_packet,n) == USBD_OK) {
+    tel_sending = 1;
+    tel_tail = tail;
+  }
+}
+
+// ----- line formatting -----
+
+static void line_begin(uint8_t type)
+{
+  line[0] = type;
+  line[1] = ' ';
+  dword_to_hex(timer_us(),&line[2]);
+  line_len = 10;
+}
+
+static void line_byte(uint8_t v)
+{
+  line[line_len++] = ' ';
+  byte_to_hex(v,&line[line_len]);
+  line_len += 2;
+}
+
+static void line_word(uint16_t v)
+{
+  line[line_len++] = ' ';
+  word_to_hex(v,&line[line_len]);
+  line_len += 4;
+}
+
+static void line_dword(uint32_t v)
+{
+  line[line_len++] = ' ';
+  dword_to_hex(v,&line[line_len]);
+  line_len += 8;
+}
+
+// queue the line or drop it if the ring is full. never waits
+static void line_end(void)
+{
+  line[line_len++] = '\r';
+  line[line_len++] = '\n';
+
+  // one byte stays free to tell a full from an empty ring
+  uint16_t head = tel_head;
+  uint16_t used = (head - tel_tail) & TEL_MASK;
+  if(used + line_len >= TELEMETRY_SIZE) {
+    if(tel_dropped != 0xffff)
+      tel_dropped++;
+    return;
+  }
+  for(uint8_t i=0;i<line_len;i++) {
+    tel_buf[head] = line[i];
+    head = (head + 1) & TEL_MASK;
+  }
+  tel_head = head;
+
+  uint8_t irq = hal_irq_disable();
+  tel_flush();
+  hal_irq_restore(irq);
+}
+
+static void send_stats(void)
+{
+  stats_time = timer_now();
+  line_begin('S');
+  line_word(tel_dropped);
+#ifdef USE_STATS
+  for(uint8_t i=0;i<STATS_NUM;i++)
+    line_dword(stats[i]);
+#endif
+  line_end();
+}
+
+static void check_stats(void)
+{
+  if((uint16_t)(timer_now() - stats_time) >= TELEMETRY_STATS_INTERVAL)
+    send_stats();
+}
+
+// ----- API -----
+
+void telemetry_block_begin(void)
+{
+  if(!tel_open)
+    return;
+  block_start = timer_us();
+}
+
+void telemetry_block_end(uint8_t bank,uint16_t length,uint8_t result)
+{
+  if(!tel_open)
+    return;
+  uint32_t us = timer_us() - block_start;
+  line_begin('B');
+  line_byte(bank);
+  line_word(length);
+  line_dword(us);
+  line_byte(result);
+  line_end();
+
+  // long transfers do not return to the main loop
+  check_stats();
+}
+
+void telemetry_transfer(void)
+{
+  if(!tel_open)
+    return;
+  line_begin('T');
+  line_byte(transfer_state.result);
+  line_dword(transfer_state.length);
+  line_dword(transfer_state.setup_us);
+  line_dword(transfer_state.data_us);
+  line_dword(transfer_state.end_us);
+  line_end();
+}
+
+void telemetry_error(void)
+{
+  if(!tel_open)
+    return;
+  line_begin('E');
+  line_end();
+}
+
+void telemetry_poll(void)
+{
+  if(!tel_open)
+    return;
+  check_stats();
+  uint8_t irq = hal_irq_disable();
+  tel_flush();
+  hal_irq_restore(irq);
+}
+
+// ----- usb callbacks (irq) -----
+
+void telemetry_usb_open(uint8_t dtr)
+{
+  // a new listener gets no stale lines
+  if(dtr && !tel_open) {
+    tel_tail = tel_head;
+    tel_dropped = 0;
+  }
+  tel_open = dtr;
+}
+
+void telemetry_usb_sent(void)
+{
+  tel_sending = 0;
+  tel_flush();
+}
+
+void telemetry_usb_reset(void)
+{
+  tel_open = 0;
+  tel_sending = 0;
+  tel_tail = tel_head;
+}
+
+#else
+
+// usb class callbacks without telemetry
+void telemetry_usb_open(uint8_t dtr) {}
+void telemetry_usb_sent(void) {}
+void telemetry_usb_reset(void) {}
+
+#endif
@@ -9,6 +9,10 @@
 
 void timer_init(void)
 {
+  // DWT cycle counter for high resolution stamps
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 void timer_delay_1ms(uint16_t timeout)
@@ -26,3 +30,84 @@ uint16_t timer_now(void)
 {
   return HAL_GetTick() & 0xffff;
 }
+
+// ----- us time stamps -----
+// HAL ms tick and the elapsed SysTick counts of the current ms
+
+uint32_t timer_us(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t ms  = HAL_GetTick();
+  uint32_t val = SysTick->VAL;
+  // reload already happened but its interrupt is still pending
+  if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+    ms++;
+    val = SysTick->VAL;
+  }
+  __set_PRIMASK(primask);
+
+  uint32_t load = SysTick->LOAD + 1;
+  return ms * 1000 + ((load - 1 - val) * 1000) / load;
+}
+
+// ----- high resolution stamps -----
+// DWT cycle counter at core clock
+
+uint32_t timer_hires(void)
+{
+  return DWT->CYCCNT;
+}
+
+uint16_t timer_hires_us(uint32_t start)
+{
+  uint32_t us = (DWT->CYCCNT - start) / (SystemCoreClock / 1000000);
+  if(us > 0xffff)
+    return 0xffff;
+  return (uint16_t)us;
+}
+
+// ----- TIM2 -----
+// 100us tick for timed playback
+
+static volatile timer_func_t timer_fast_func;
+
+void TIM2_IRQHandler(void)
+{
+  if(TIM2->SR & TIM_SR_UIF) {
+    TIM2->SR = ~TIM_SR_UIF;
+    timer_fast_func();
+  }
+}
+
+void timer_fast_start(timer_func_t func)
+{
+  // APB1 timers run at twice PCLK1 if APB1 is divided
+  uint32_t clk = HAL_RCC_GetPCLK1Freq();
+  if((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+    clk *= 2;
+
+  timer_fast_func = func;
+  __HAL_RCC_TIM2_CLK_ENABLE();
+
+  // 1 MHz count and update every 100 counts
+  TIM2->CR1  = 0;
+  TIM2->PSC  = (clk / 1000000) - 1;
+  TIM2->ARR  = 100 - 1;
+  TIM2->CNT  = 0;
+  TIM2->EGR  = TIM_EGR_UG;
+  TIM2->SR   = 0;
+  TIM2->DIER = TIM_DIER_UIE;
+
+  HAL_NVIC_SetPriority(TIM2_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(TIM2_IRQn);
+  TIM2->CR1  = TIM_CR1_CEN;
+}
+
+void timer_fast_stop(void)
+{
+  TIM2->CR1  = 0;
+  TIM2->DIER = 0;
+  HAL_NVIC_DisableIRQ(TIM2_IRQn);
+  __HAL_RCC_TIM2_CLK_DISABLE();
+}
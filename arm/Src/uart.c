@@ -31,6 +31,9 @@
 #include "param.h"
 #include "display.h"
 #include "timer.h"
+#include "stats.h"
+#include "trace.h"
+#include "prof.h"
 
 #define CIRCBUF_SIZE 256
 
@@ -92,29 +95,44 @@ void uart_load_rx(uint8_t *data, uint16_t len)
   rx_in = len;
   rx_out = 0;
   rx_buf = data;
+  // USB naks further packets until CDC_Resume_RX()
+  TRACE(TRACE_CTS,0);
 }
 
-uint8_t uart_read(uint8_t *data)
+static uint8_t read_byte(uint8_t *data)
 {
-  timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_SERIAL_READ_AVAIL_TIMEOUT));
-  while(rx_in == rx_out) {
-    if (timer_expired(&t)) {
-      return 0;
+  if(rx_in == rx_out) {
+    timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_SERIAL_READ_AVAIL_TIMEOUT));
+    while(rx_in == rx_out) {
+      if (timer_expired(&t)) {
+        return 0;
+      }
+      __WFI();
     }
-    __WFI();
+    STATS_ADD(STATS_RX_WAIT_MS,(uint16_t)(timer_now() - t.start));
   }
+  STATS_INC(STATS_HOST_RX_BYTES);
 
   *data = rx_buf[rx_out++];
 
   if (rx_in == rx_out)
   {
     // let USB give us another packet
+    TRACE(TRACE_CTS,1);
     CDC_Resume_RX();
   }
 
   return 1;
 }
 
+uint8_t uart_read(uint8_t *data)
+{
+  PROF_ENTER(PROF_UART_READ);
+  uint8_t result = read_byte(data);
+  PROF_EXIT(PROF_UART_READ);
+  return result;
+}
+
 // ---------- send ----------------------------------------------------------
 #if 0
 static Circular_Buffer_t tx_buf;
@@ -157,7 +175,16 @@ uint8_t uart_send(uint8_t data)
 
 uint8_t uart_send(uint8_t data)
 {
-  while (CDC_Transmit_FS(&data,1) != USBD_OK);
+  PROF_ENTER(PROF_UART_SEND);
+  if (CDC_Transmit_FS(&data,1) != USBD_OK) {
+#ifdef USE_STATS
+    uint16_t start = timer_now();
+#endif
+    while (CDC_Transmit_FS(&data,1) != USBD_OK);
+    STATS_ADD(STATS_UDRE_WAIT_MS,(uint16_t)(timer_now() - start));
+  }
+  STATS_INC(STATS_HOST_TX_BYTES);
+  PROF_EXIT(PROF_UART_SEND);
 
   return 1;
 }
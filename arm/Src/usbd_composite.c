@@ -0,0 +1,242 @@
+/*
+ * usbd_composite.c - usb composite device with data and telemetry cdc
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+// The data cdc on interfaces 0/1 is the unchanged USBD_CDC class. This
+// class wraps it and adds a second cdc acm function on interfaces 2/3
+// that only sends data. Both functions are grouped with an interface
+// association descriptor so hosts bind a cdc acm driver to each.
+
+#include "usbd_composite.h"
+#include "usbd_ctlreq.h"
+
+#define USB_DESC_TYPE_IAD   0x0B
+
+// iad and cdc acm function with comm interface itf and data interface itf+1
+#define CDC_FUNCTION_DESC(itf,cmd_ep,out_ep,in_ep) \
+  /* Interface Association Descriptor */ \
+  0x08, USB_DESC_TYPE_IAD, itf, 0x02, 0x02, 0x02, 0x01, 0x00, \
+  /* Comm Interface Descriptor: ACM, AT commands */ \
+  0x09, USB_DESC_TYPE_INTERFACE, itf, 0x00, 0x01, 0x02, 0x02, 0x01, 0x00, \
+  /* Header Functional Descriptor: CDC 1.10 */ \
+  0x05, 0x24, 0x00, 0x10, 0x01, \
+  /* Call Management Functional Descriptor */ \
+  0x05, 0x24, 0x01, 0x00, (itf)+1, \
+  /* ACM Functional Descriptor */ \
+  0x04, 0x24, 0x02, 0x02, \
+  /* Union Functional Descriptor */ \
+  0x05, 0x24, 0x06, itf, (itf)+1, \
+  /* Command Endpoint: Interrupt */ \
+  0x07, USB_DESC_TYPE_ENDPOINT, cmd_ep, 0x03, \
+  LOBYTE(CDC_CMD_PACKET_SIZE), HIBYTE(CDC_CMD_PACKET_SIZE), 0x10, \
+  /* Data Interface Descriptor */ \
+  0x09, USB_DESC_TYPE_INTERFACE, (itf)+1, 0x00, 0x02, 0x0A, 0x00, 0x00, 0x00, \
+  /* Data OUT Endpoint: Bulk */ \
+  0x07, USB_DESC_TYPE_ENDPOINT, out_ep, 0x02, \
+  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE), HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE), 0x00, \
+  /* Data IN Endpoint: Bulk */ \
+  0x07, USB_DESC_TYPE_ENDPOINT, in_ep, 0x02, \
+  LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE), HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE), 0x00
+
+__ALIGN_BEGIN static uint8_t USBD_Composite_CfgDesc[USB_COMPOSITE_CONFIG_DESC_SIZ] __ALIGN_END =
+{
+  /*Configuration Descriptor*/
+  0x09,   /* bLength: Configuration Descriptor size */
+  USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
+  LOBYTE(USB_COMPOSITE_CONFIG_DESC_SIZ),  /* wTotalLength:no of returned bytes */
+  HIBYTE(USB_COMPOSITE_CONFIG_DESC_SIZ),
+  0x04,   /* bNumInterfaces: 4 interfaces */
+  0x01,   /* bConfigurationValue: Configuration value */
+  0x00,   /* iConfiguration: Index of string descriptor describing the configuration */
+  0xC0,   /* bmAttributes: self powered */
+  0x32,   /* MaxPower 100 mA */
+
+  /* data cdc */
+  CDC_FUNCTION_DESC(0x00, CDC_CMD_EP, CDC_OUT_EP, CDC_IN_EP),
+  /* telemetry cdc */
+  CDC_FUNCTION_DESC(TEL_COMM_ITF, TEL_CMD_EP, TEL_OUT_EP, TEL_IN_EP)
+};
+
+// ----- telemetry cdc state -----
+
+// line coding is stored but has no effect
+__ALIGN_BEGIN static uint8_t tel_line_coding[7] __ALIGN_END =
+  { 0x00, 0xc2, 0x01, 0x00, 0x00, 0x00, 0x08 };  /* 115200 8N1 */
+__ALIGN_BEGIN static uint8_t tel_rx_buf[TEL_PACKET_SIZE] __ALIGN_END;
+static uint8_t tel_alt = 0;
+// set while a control write of the telemetry interface is pending
+static uint8_t tel_ctl_rx = 0;
+static volatile uint8_t tel_tx_busy = 0;
+
+static uint8_t is_tel_request(USBD_SetupReqTypedef *req)
+{
+  switch(req->bmRequest & USB_REQ_RECIPIENT_MASK) {
+    case USB_REQ_RECIPIENT_INTERFACE:
+      return LOBYTE(req->wIndex) >= TEL_COMM_ITF;
+    case USB_REQ_RECIPIENT_ENDPOINT:
+      return (LOBYTE(req->wIndex) & 0x7f) >= (TEL_OUT_EP & 0x7f);
+    default:
+      return 0;
+  }
+}
+
+static uint8_t tel_setup(USBD_HandleTypeDef *pdev,USBD_SetupReqTypedef *req)
+{
+  switch(req->bmRequest & USB_REQ_TYPE_MASK) {
+    case USB_REQ_TYPE_CLASS:
+      switch(req->bRequest) {
+        case CDC_GET_LINE_CODING:
+          USBD_CtlSendData(pdev,tel_line_coding,
+                           MIN(req->wLength,sizeof(tel_line_coding)));
+          break;
+        case CDC_SET_LINE_CODING:
+          tel_ctl_rx = 1;
+          USBD_CtlPrepareRx(pdev,tel_line_coding,
+                            MIN(req->wLength,sizeof(tel_line_coding)));
+          break;
+        case CDC_SET_CONTROL_LINE_STATE:
+          telemetry_usb_open(req->wValue & 1);
+          break;
+        default:
+          if(req->wLength)
+            USBD_CtlError(pdev,req);
+          break;
+      }
+      break;
+
+    case USB_REQ_TYPE_STANDARD:
+      if(req->bRequest == USB_REQ_GET_INTERFACE)
+        USBD_CtlSendData(pdev,&tel_alt,1);
+      break;
+
+    default:
+      break;
+  }
+  return USBD_OK;
+}
+
+// ----- class callbacks -----
+
+static uint8_t USBD_Composite_Init(USBD_HandleTypeDef *pdev,uint8_t cfgidx)
+{
+  uint8_t ret = USBD_CDC.Init(pdev,cfgidx);
+
+  USBD_LL_OpenEP(pdev,TEL_IN_EP,USBD_EP_TYPE_BULK,TEL_PACKET_SIZE);
+  USBD_LL_OpenEP(pdev,TEL_OUT_EP,USBD_EP_TYPE_BULK,TEL_PACKET_SIZE);
+  USBD_LL_OpenEP(pdev,TEL_CMD_EP,USBD_EP_TYPE_INTR,CDC_CMD_PACKET_SIZE);
+
+  // received data is ignored
+  USBD_LL_PrepareReceive(pdev,TEL_OUT_EP,tel_rx_buf,TEL_PACKET_SIZE);
+
+  tel_tx_busy = 0;
+  tel_ctl_rx = 0;
+  telemetry_usb_reset();
+  return ret;
+}
+
+static uint8_t USBD_Composite_DeInit(USBD_HandleTypeDef *pdev,uint8_t cfgidx)
+{
+  USBD_LL_CloseEP(pdev,TEL_IN_EP);
+  USBD_LL_CloseEP(pdev,TEL_OUT_EP);
+  USBD_LL_CloseEP(pdev,TEL_CMD_EP);
+
+  tel_tx_busy = 0;
+  telemetry_usb_reset();
+  return USBD_CDC.DeInit(pdev,cfgidx);
+}
+
+static uint8_t USBD_Composite_Setup(USBD_HandleTypeDef *pdev,USBD_SetupReqTypedef *req)
+{
+  if(is_tel_request(req))
+    return tel_setup(pdev,req);
+  return USBD_CDC.Setup(pdev,req);
+}
+
+static uint8_t USBD_Composite_EP0_RxReady(USBD_HandleTypeDef *pdev)
+{
+  if(tel_ctl_rx) {
+    tel_ctl_rx = 0;
+    return USBD_OK;
+  }
+  return USBD_CDC.EP0_RxReady(pdev);
+}
+
+static uint8_t USBD_Composite_DataIn(USBD_HandleTypeDef *pdev,uint8_t epnum)
+{
+  if(epnum == (TEL_IN_EP & 0x7f)) {
+    tel_tx_busy = 0;
+    telemetry_usb_sent();
+    return USBD_OK;
+  }
+  return USBD_CDC.DataIn(pdev,epnum);
+}
+
+static uint8_t USBD_Composite_DataOut(USBD_HandleTypeDef *pdev,uint8_t epnum)
+{
+  if(epnum == TEL_OUT_EP) {
+    USBD_LL_PrepareReceive(pdev,TEL_OUT_EP,tel_rx_buf,TEL_PACKET_SIZE);
+    return USBD_OK;
+  }
+  return USBD_CDC.DataOut(pdev,epnum);
+}
+
+static uint8_t *USBD_Composite_GetCfgDesc(uint16_t *length)
+{
+  *length = sizeof(USBD_Composite_CfgDesc);
+  return USBD_Composite_CfgDesc;
+}
+
+static uint8_t *USBD_Composite_GetDeviceQualifierDesc(uint16_t *length)
+{
+  return USBD_CDC.GetDeviceQualifierDescriptor(length);
+}
+
+USBD_ClassTypeDef USBD_Composite =
+{
+  USBD_Composite_Init,
+  USBD_Composite_DeInit,
+  USBD_Composite_Setup,
+  NULL,                 /* EP0_TxSent, */
+  USBD_Composite_EP0_RxReady,
+  USBD_Composite_DataIn,
+  USBD_Composite_DataOut,
+  NULL,
+  NULL,
+  NULL,
+  USBD_Composite_GetCfgDesc,
+  USBD_Composite_GetCfgDesc,
+  USBD_Composite_GetCfgDesc,
+  USBD_Composite_GetDeviceQualifierDesc,
+};
+
+// ----- telemetry API -----
+
+uint8_t USBD_Tel_Transmit(USBD_HandleTypeDef *pdev,uint8_t *buf,uint16_t len)
+{
+  if(pdev->dev_state != USBD_STATE_CONFIGURED)
+    return USBD_FAIL;
+  if(tel_tx_busy)
+    return USBD_BUSY;
+  tel_tx_busy = 1;
+  USBD_LL_Transmit(pdev,TEL_IN_EP,buf,len);
+  return USBD_OK;
+}
@@ -119,12 +119,22 @@ class AutoType:
     self.type_delay = 6
     self.joy_delay  = 6
     self.reset_state()
+    # plan minimal time moves instead of greedy nearest key moves
+    self.optimize = True
+    # memoized moves: (x,y,token) -> [(real_dx,real_dy,end_x,end_y)]
+    self.plan_cache = {}
+    # estimated type durations of last conversion in 10ms units
+    self.greedy_duration = 0
+    self.plan_duration = 0
+
+  # initial position in virtual keyboard: J (8,2)
+  reset_x = 8
+  reset_y = 2
 
   def reset_state(self):
     """Reset Autotype state"""
-    # initial position in virtual keyboard: J (8,2)
-    self.last_x = 8
-    self.last_y = 2
+    self.last_x = self.reset_x
+    self.last_y = self.reset_y
     self.shift_state = False
 
   def save_state(self):
@@ -157,7 +167,7 @@ class AutoType:
         return CLIENT_ERROR_INVALID_ARGUMENT
     return STATUS_OK
 
-  def parse_special_seq(self,at_seq,seq):
+  def parse_special_seq(self,steps,seq):
     """Parse embedded sequence in {...} block
        This is either a joy stream of a auto type internal command {:...}"""
     if seq == "":
@@ -169,8 +179,9 @@ class AutoType:
       for c in cmds:
         # single char commands
         if c == 'R':
-          self.reset_state()
-          at_seq.append((AutoType_JoyStream,self.joy_delay,"*")) # wait a second
+          self.shift_state = False
+          steps.append(('reset',))
+          steps.append(('seq',(AutoType_JoyStream,self.joy_delay,"*"))) # wait a second
         # assing commands
         else:
           assignment = c.split('=')
@@ -188,66 +199,187 @@ class AutoType:
 
     # joy stream
     else:
-      at_seq.append((AutoType_JoyStream,self.joy_delay,seq))
+      steps.append(('seq',(AutoType_JoyStream,self.joy_delay,seq)))
 
-  def add_move(self,at_seq,x,y):
-    """Add a move to x,y to the sequence list"""
+  # ----- moves on the virtual keyboard -----
 
-    # calc expected delta movement from last position on grid keymap
-    dx = ((x - self.last_x + 17 + 8) % 17) - 8
-    dy = ((y - self.last_y + 5 + 2) % 5) - 2
+  def move(self,last_x,last_y,x,y,sign_x,sign_y):
+    """Move from last_x,last_y to x,y in the given directions. Walks
+       over the wide keys of the real keymap.
+       Returns (real_dx,real_dy,end_x,end_y) or None if x is not reached"""
 
     # calc real delta y movement on real keymap
     real_dy = 0
-    if dy > 0:
-      sign = 1
-    else:
-      sign = -1
-    while y != self.last_y:
-      real_dy += sign
-      if self.last_x == 15:
-        if self.last_y == 0 and sign == 1: # RESTORE
-          self.last_x = 14
-        if self.last_y == 3 and sign == -1: # CRSR
-          self.last_x = 14
-      if self.last_x == 13:
-        if self.last_y == 2 and sign == 1: # SHIFT right
-          self.last_x = 12
-        if self.last_y == 4 and sign == -1: # SHIFT right
-          self.last_x = 12
-      self.last_y = (self.last_y + sign + 5) % 5
+    while y != last_y:
+      real_dy += sign_y
+      if last_x == 15:
+        if last_y == 0 and sign_y == 1: # RESTORE
+          last_x = 14
+        if last_y == 3 and sign_y == -1: # CRSR
+          last_x = 14
+      if last_x == 13:
+        if last_y == 2 and sign_y == 1: # SHIFT right
+          last_x = 12
+        if last_y == 4 and sign_y == -1: # SHIFT right
+          last_x = 12
+      last_y = (last_y + sign_y + 5) % 5
 
     # calc real delta x movement on real keymap
     real_dx = 0
+    while x != last_x:
+      real_dx += sign_x
+      if abs(real_dx) > 17:
+        return None
+      if last_y == 3:
+        if last_x == 12 and sign_x == 1: # SHIFT right
+          last_x = 13
+        if last_x == 14 and sign_x == -1: # SHIFT right
+          last_x = 13
+      if last_y == 1 or last_y == 2:
+        if last_x == 14 and sign_x == 1: # RESTORE/RETURN
+          last_x = 15
+        if last_x == 16 and sign_x == -1: # RESTORE/RETURN
+          last_x = 15
+      last_x = (last_x + sign_x + 17) % 17
+
+    return (real_dx,real_dy,last_x,last_y)
+
+  def move_cost(self,real_dx,real_dy,delay):
+    """Duration of a delta move in 10ms units (see JoyStream):
+       press fire, pulse each step, release fire"""
+    return (4 + 2 * (abs(real_dx) + abs(real_dy))) * delay
+
+  def token_targets(self,token,last_x,last_y,greedy):
+    """Resolve a key token to the possible target positions"""
+    if token == 'space':
+      # SPACE is valid on every x position
+      return [(last_x,4)]
+    elif token == 'shift':
+      if greedy:
+        if last_x > 7:
+          return [(12,3)]
+        else:
+          return [(1,3)]
+      return [(1,3),(12,3)]
+    else:
+      return [token]
+
+  def add_move(self,at_seq,x,y):
+    """Add a move to x,y to the sequence list"""
+
+    # calc expected delta movement from last position on grid keymap
+    dx = ((x - self.last_x + 17 + 8) % 17) - 8
+    dy = ((y - self.last_y + 5 + 2) % 5) - 2
     if dx > 0:
-      sign = 1
+      sign_x = 1
     else:
-      sign = -1
-    while x != self.last_x:
-      real_dx += sign
-      if self.last_y == 3:
-        if self.last_x == 12 and sign == 1: # SHIFT right
-          self.last_x = 13
-        if self.last_x == 14 and sign == -1: # SHIFT right
-          self.last_x = 13
-      if self.last_y == 1 or self.last_y == 2:
-        if self.last_x == 14 and sign == 1: # RESTORE/RETURN
-          self.last_x = 15
-        if self.last_x == 16 and sign == -1: # RESTORE/RETURN
-          self.last_x = 15
-      self.last_x = (self.last_x + sign + 17) % 17
+      sign_x = -1
+    if dy > 0:
+      sign_y = 1
+    else:
+      sign_y = -1
+
+    (real_dx,real_dy,self.last_x,self.last_y) = \
+      self.move(self.last_x,self.last_y,x,y,sign_x,sign_y)
 
     # add to delta list
     at_seq.append((AutoType_DeltaMove,self.type_delay,real_dx,real_dy))
 
+  def plan_moves(self,last_x,last_y,token):
+    """All ways to type a key token from the given position. Results are
+       memoized per (position,token).
+       Returns list of (real_dx,real_dy,end_x,end_y) with unique ends"""
+    key = (last_x,last_y,token)
+    if self.plan_cache.has_key(key):
+      return self.plan_cache[key]
+    best = {}
+    for (x,y) in self.token_targets(token,last_x,last_y,False):
+      for sign_y in (1,-1):
+        for sign_x in (1,-1):
+          m = self.move(last_x,last_y,x,y,sign_x,sign_y)
+          if m == None:
+            continue
+          end = (m[2],m[3])
+          if not best.has_key(end) or \
+             self.move_cost(m[0],m[1],1) < self.move_cost(best[end][0],best[end][1],1):
+            best[end] = m
+    result = best.values()
+    self.plan_cache[key] = result
+    return result
+
+  def resolve_greedy(self,steps):
+    """Convert key steps to moves with the greedy nearest key strategy
+       Returns (at_seq,duration)"""
+    at_seq = []
+    duration = 0
+    for step in steps:
+      if step[0] == 'key':
+        self.type_delay = step[1]
+        (x,y) = self.token_targets(step[2],self.last_x,self.last_y,True)[0]
+        self.add_move(at_seq,x,y)
+        m = at_seq[-1]
+        duration += self.move_cost(m[2],m[3],m[1])
+      elif step[0] == 'reset':
+        self.last_x = self.reset_x
+        self.last_y = self.reset_y
+      else:
+        at_seq.append(step[1])
+    return (at_seq,duration)
+
+  def resolve_optimal(self,steps):
+    """Convert key steps to moves with minimal total duration. This is a
+       shortest path search over the keyboard positions.
+       Returns (at_seq,duration)"""
+    # position -> (cost,back_pointer)
+    # back_pointer is (prev_back_pointer,at_entry) or None
+    states = { (self.last_x,self.last_y) : (0,None) }
+    for step in steps:
+      if step[0] == 'key':
+        delay = step[1]
+        new_states = {}
+        for (pos,(cost,bp)) in states.items():
+          for m in self.plan_moves(pos[0],pos[1],step[2]):
+            c = cost + self.move_cost(m[0],m[1],delay)
+            end = (m[2],m[3])
+            if not new_states.has_key(end) or c < new_states[end][0]:
+              entry = (AutoType_DeltaMove,delay,m[0],m[1])
+              new_states[end] = (c,(bp,entry))
+        states = new_states
+      elif step[0] == 'reset':
+        best = min(states.values())
+        states = { (self.reset_x,self.reset_y) : best }
+      else:
+        for pos in states.keys():
+          (cost,bp) = states[pos]
+          states[pos] = (cost,(bp,step[1]))
+
+    # pick the cheapest end and walk back
+    best_pos = None
+    for pos in states.keys():
+      if best_pos == None or states[pos][0] < states[best_pos][0]:
+        best_pos = pos
+    (duration,bp) = states[best_pos]
+    at_seq = []
+    while bp != None:
+      at_seq.append(bp[1])
+      bp = bp[0]
+    at_seq.reverse()
+    (self.last_x,self.last_y) = best_pos
+    return (at_seq,duration)
+
   def convert_string_to_autotype_seq(self,text):
     """Convert a string to list of delta (x,y) movements required
        to be performed on the virtual keyboard to enter the string.
        Every character gets a delta pair. Additionally, SHIFT delta
-       pairs are inserted if required."""
+       pairs are inserted if required.
 
-    # add initial stream with type delay
-    at_seq = []
+       With optimize set the moves are planned for minimal type time,
+       otherwise the nearest key is taken for each character. The
+       durations of both are kept in greedy_duration and plan_duration."""
+
+    # key steps: ('key',delay,token) with token (x,y), 'space' or 'shift'
+    #            ('seq',at_entry) and ('reset',)
+    steps = []
 
     force_shift = False
     ignore_shift = False
@@ -263,41 +395,32 @@ class AutoType:
 
       # SPACE is valid on every x posiiton
       if c == ' ' or c == 's':
-        x=self.last_x
-        y=4
+        token = 'space'
 
       # SHIFT can be toggled with '_'
       elif c == '_':
-        if self.last_x > 7:
-          x = 12
-        else:
-          x = 1
-        y=3
+        token = 'shift'
         self.shift_state = not self.shift_state
         ignore_shift = self.shift_state
 
       # '~' toggle c= state
       elif c == '~':
-        x = 0
-        y = 3
+        token = (0,3)
 
       # '^' set shift for next char
       elif c == '^':
         if not self.shift_state:
-          if self.last_x > 7:
-            x = 12
-          else:
-            x = 1
-          y=3
+          steps.append(('key',self.type_delay,'shift'))
           self.shift_state = True
         force_shift = True
+        pos += 1
+        continue
 
       # key is in map and available
       elif self.autotype_map.has_key(c):
         # fetch key's position in keymap layout and shift state
         key_info = self.autotype_map[c]
-        x = key_info[0]
-        y = key_info[1]
+        token = (key_info[0],key_info[1])
 
         if ignore_shift:
           pass
@@ -309,11 +432,7 @@ class AutoType:
           # key needs a different shift state
           if shifted != self.shift_state:
             shift_toggle = True
-            if self.last_x > 7:
-              x = 12
-            else:
-              x = 1
-            y = 3
+            token = 'shift'
 
       # special sequence block
       elif c == '{':
@@ -321,7 +440,7 @@ class AutoType:
         if end != -1:
           seq = text[pos+1:end]
           pos = end + 1
-          self.parse_special_seq(at_seq,seq)
+          self.parse_special_seq(steps,seq)
         else:
           pos += 1
         continue
@@ -332,7 +451,7 @@ class AutoType:
         pos += 1
         continue
 
-      self.add_move(at_seq,x,y)
+      steps.append(('key',self.type_delay,token))
 
       # restore shift state
       if shift_toggle:
@@ -341,4 +460,12 @@ class AutoType:
       else:
         pos += 1
 
+    # resolve moves
+    start = (self.last_x,self.last_y)
+    (greedy_seq,self.greedy_duration) = self.resolve_greedy(steps)
+    if not self.optimize:
+      self.plan_duration = self.greedy_duration
+      return greedy_seq
+    (self.last_x,self.last_y) = start
+    (at_seq,self.plan_duration) = self.resolve_optimal(steps)
     return at_seq
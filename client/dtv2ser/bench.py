@@ -0,0 +1,223 @@
+#
+# bench.py - throughput benchmark matrix of the transfer modes
+#
+# Written by
+#  Christian Vogelgsang <chris@vogelgsang.org>
+#
+# This file is part of dtv2ser.
+# See README for copyright notice.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+#  02111-1307  USA.
+#
+
+
+import json
+
+from dtv2ser.status import *
+
+def percentile(values,p):
+  """Nearest rank percentile of a list of values"""
+  if len(values) == 0:
+    return 0
+  s = sorted(values)
+  rank = int(round(p / 100.0 * (len(s) - 1)))
+  return s[rank]
+
+class BenchCell:
+  """All repetitions of one mode/direction/block size combination"""
+
+  def __init__(self,mode,direction,block_size,length):
+    self.mode       = mode
+    self.direction  = direction
+    self.block_size = block_size
+    self.length     = length
+    self.errors     = 0
+    # per repetition: client time in s and ServerTime
+    self.times        = []
+    self.server_times = []
+
+  def key(self):
+    return "%s/%s/0x%04x" % (self.mode,self.direction,self.block_size)
+
+  def add(self,stat):
+    self.times.append(stat[2])
+    self.server_times.append(stat[4])
+
+  def summary(self):
+    """Return a dict with the fields of Bench.fields"""
+    n = len(self.times)
+    client_t = percentile(self.times,50)
+    server_t = percentile(map(lambda x:x.total(),self.server_times),50)
+    def rate(t):
+      if t > 0:
+        return int(self.length / t)
+      return 0
+    def phase(name):
+      return percentile(map(lambda x:getattr(x,name),self.server_times),50)
+    return {
+      "mode"         : self.mode,
+      "direction"    : self.direction,
+      "block_size"   : self.block_size,
+      "length"       : self.length,
+      "reps"         : n,
+      "errors"       : self.errors,
+      "client_bps"   : rate(client_t),
+      "server_bps"   : rate(server_t),
+      "lat_p50_ms"   : round(percentile(self.times,50) * 1000.0,3),
+      "lat_p90_ms"   : round(percentile(self.times,90) * 1000.0,3),
+      "lat_p99_ms"   : round(percentile(self.times,99) * 1000.0,3),
+      "setup_us"     : phase("setup_us"),
+      "data_us"      : phase("data_us"),
+      "end_us"       : phase("end_us")
+    }
+
+class Bench:
+  """Sweep block sizes, directions and transfer modes with repetitions.
+
+     normal  transfers between client and DTV
+     serial  TRANSFER_MODE_SERIAL_ONLY: client <-> dtv2ser only
+     dtv     TRANSFER_MODE_DTV_ONLY: dtv2ser <-> DTV only
+
+     Throughput and phases are medians over the repetitions. Latency is
+     the client time of a whole transfer."""
+
+  modes      = ("normal","serial","dtv")
+  directions = ("read","write")
+
+  # csv columns
+  fields = ("mode","direction","block_size","length","reps","errors",
+            "client_bps","server_bps","lat_p50_ms","lat_p90_ms","lat_p99_ms",
+            "setup_us","data_us","end_us")
+
+  # fields compared with a baseline: name -> True if larger is better
+  compare_fields = {
+    "client_bps" : True,
+    "server_bps" : True,
+    "lat_p50_ms" : False,
+    "lat_p90_ms" : False
+  }
+
+  def __init__(self,dtvcmd,rom,start,length,pattern=0xff):
+    self.dtvcmd  = dtvcmd
+    self.rom     = rom
+    self.start   = start
+    self.length  = length
+    self.pattern = pattern
+    self.cells   = []
+
+  def run_one(self,mode,direction,block_size):
+    """Run a single transfer
+    Returns (result,stat)"""
+    d = self.dtvcmd
+    if mode == "normal":
+      if direction == "read":
+        (result,data,stat) = d.read_memory(self.rom,self.start,self.length,
+                                           block_size=block_size)
+        return (result,stat)
+      else:
+        data = chr(self.pattern) * self.length
+        return d.write_memory(self.rom,self.start,data,block_size=block_size)
+    elif mode == "serial":
+      if direction == "read":
+        return d.diagnose_read_memory_only_client(self.length,pattern=self.pattern,
+                                                  block_size=block_size)
+      else:
+        return d.diagnose_write_memory_only_client(self.length,pattern=self.pattern,
+                                                   block_size=block_size)
+    else:
+      if direction == "read":
+        return d.diagnose_read_memory_only_dtv(self.rom,self.start,self.length,
+                                               pattern=self.pattern,
+                                               block_size=block_size)
+      else:
+        return d.diagnose_write_memory_only_dtv(self.rom,self.start,self.length,
+                                                pattern=self.pattern,
+                                                block_size=block_size)
+
+  def run(self,modes,directions,block_sizes,reps,callback=lambda cell,rep,result:True):
+    """Run the matrix. callback is called after each transfer and may
+    return False to abort.
+    Returns result of the first failed transfer or STATUS_OK"""
+    first_error = STATUS_OK
+    for mode in modes:
+      for direction in directions:
+        for block_size in block_sizes:
+          cell = BenchCell(mode,direction,block_size,self.length)
+          self.cells.append(cell)
+          for rep in xrange(reps):
+            (result,stat) = self.run_one(mode,direction,block_size)
+            if result == STATUS_OK:
+              cell.add(stat)
+            else:
+              cell.errors += 1
+              if first_error == STATUS_OK:
+                first_error = result
+            if not callback(cell,rep,result):
+              return first_error
+    return first_error
+
+  def summaries(self):
+    return map(lambda x:x.summary(),self.cells)
+
+  # ----- output -----
+
+  def to_csv(self):
+    lines = [",".join(self.fields)]
+    for s in self.summaries():
+      lines.append(",".join(map(lambda f:str(s[f]),self.fields)))
+    return "\n".join(lines) + "\n"
+
+  def to_json(self):
+    return json.dumps({ "length" : self.length, "results" : self.summaries() },
+                      indent=1,sort_keys=True,
+                      separators=(",",": ")) + "\n"
+
+  # ----- baseline -----
+
+  def load_baseline(text):
+    """Parse a JSON result file written by to_json
+    Returns dict key -> summary"""
+    results = json.loads(text)["results"]
+    baseline = {}
+    for s in results:
+      key = "%s/%s/0x%04x" % (s["mode"],s["direction"],s["block_size"])
+      baseline[key] = s
+    return baseline
+  load_baseline = staticmethod(load_baseline)
+
+  def compare(self,baseline,tolerance=10.0):
+    """Compare with a baseline. Changes worse than tolerance percent are
+    regressions.
+    Returns list of (key,field,base,now,change_percent,is_regression)"""
+    diffs = []
+    for cell in self.cells:
+      key = cell.key()
+      if not baseline.has_key(key):
+        continue
+      base = baseline[key]
+      now  = cell.summary()
+      for field in sorted(self.compare_fields.keys()):
+        b = base.get(field,0)
+        n = now[field]
+        if b == 0:
+          continue
+        change = (n - b) * 100.0 / b
+        if self.compare_fields[field]:
+          worse = -change
+        else:
+          worse = change
+        diffs.append((key,field,b,n,change,worse > tolerance))
+    return diffs
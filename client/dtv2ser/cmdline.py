@@ -120,6 +120,19 @@ class CmdLine:
     except:
       return (CLIENT_ERROR_INVALID_HEX_NUMBER,0)
 
+  def get_dword(self):
+    """Fetch a 8 hex dword.
+    Returns (result,dword)
+    """
+    (result,data) = self.con.receive_data(10) # xxxxxxxx\r\n
+    if result != STATUS_OK:
+        return (result,0)
+    try:
+      value = int(data[0:8],16)
+      return (STATUS_OK,value)
+    except:
+      return (CLIENT_ERROR_INVALID_HEX_NUMBER,0)
+
   # ----- perform command -----
 
   def do_command(self,cmd):
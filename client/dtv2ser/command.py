@@ -30,7 +30,9 @@ from dtv2ser.transfer import *
 from dtv2ser.autotype import *
 from dtv2ser.joystream import *
 from dtv2ser.screencode import *
+from dtv2ser.pack import Pack
 from dtv2ser.state import State
+from dtv2ser.trace import Trace
 
 class Command:
   """The high level commands of dtv2ser."""
@@ -39,12 +41,35 @@ class Command:
   client_major = 0
   client_minor = 6
 
+  # max number of ranges in a single list transfer of dtv2ser
+  max_list_ranges = 8
+  # how long to wait for a reset with wait_ready
+  reset_ready_timeout = 5.0
+
+  # max number of bytes in a single peek or poke command
+  max_peek_size = 32
+  max_poke_size = 14
+
   def __init__(self,con):
     self.cmdline   = CmdLine(con)
     self.transfer  = Transfer(con)
     self.autoType  = AutoType()
     self.joyStream = JoyStream()
     self.state     = State(self)
+    self.pack      = Pack()
+    # packed transfers are enabled by setting the pack servlet
+    self.pack_servlet = None
+    self.pack_loaded  = False
+    # functions called with (rom,start,length) when DTV memory changes
+    self.mem_listeners = []
+    # boot time in s of last reset with wait_ready
+    self.boot_time = 0
+    # play joy streams from the device buffer with its timer
+    self.joy_buffered = False
+    # has the firmware the 'cs' sys call command? (None=not probed)
+    self.has_sys_call = None
+    # has the firmware the memory commands of USE_MEMCMD? (None=not probed)
+    self.mem_commands = None
 
   # ----- version -----------------------------------------------------------
 
@@ -60,6 +85,129 @@ class Command:
     minor = version & 0xff
     return (result,major,minor)
 
+  # names of the firmware performance counters in reply order
+  stats_names = (
+    "host_rx_bytes","host_tx_bytes","dtv_tx_bytes","dtv_rx_bytes",
+    "blocks","noack1","noack2","noack3","noack4",
+    "checksum_errors","crc_errors",
+    "rts_wait_ms","udre_wait_ms","rx_wait_ms","ack_wait_us","ack_max_us"
+  )
+
+  def query_stats(self,reset=False):
+    """Query the performance counters of the firmware and optionally
+    reset them afterwards.
+    Returns (status,counters) with counters a dict name -> value
+    """
+    flags = 0
+    if reset:
+      flags |= 1
+    result = self.cmdline.do_command('s%02x' % flags)
+    if result != STATUS_OK:
+      return (result,{})
+    (result,num) = self.cmdline.get_byte()
+    if result != STATUS_OK:
+      return (result,{})
+    counters = {}
+    for i in xrange(num):
+      (result,value) = self.cmdline.get_dword()
+      if result != STATUS_OK:
+        return (result,{})
+      if i < len(self.stats_names):
+        counters[self.stats_names[i]] = value
+    return (STATUS_OK,counters)
+
+  # phases of a dtvlow byte with an ack latency histogram
+  stats_ack_phases = 4
+
+  def query_ack_histogram(self):
+    """Query the ack latency histograms of all phases.
+    Bin 0 counts immediate acks, bin n acks after 2^(n-1)..2^n-1 us
+    and the last bin all slower ones.
+    Returns (status,hists) with a list of bin counts per phase
+    """
+    hists = []
+    for phase in xrange(self.stats_ack_phases):
+      result = self.cmdline.do_command('sa%02x' % phase)
+      if result != STATUS_OK:
+        return (result,[])
+      (result,num) = self.cmdline.get_byte()
+      if result != STATUS_OK:
+        return (result,[])
+      bins = []
+      for i in xrange(num):
+        (result,value) = self.cmdline.get_word()
+        if result != STATUS_OK:
+          return (result,[])
+        bins.append(value)
+      hists.append(bins)
+    return (STATUS_OK,hists)
+
+  # profiled functions of prof.h
+  prof_names = (
+    "dtvlow_send_byte","dtvlow_recv_byte","uart_read","uart_send",
+    "transfer_mem","cmdline_handle"
+  )
+
+  def query_profile(self,reset=False):
+    """Query the cycle profile of the firmware hot paths and optionally
+    reset it afterwards. Cycles include nested calls.
+    Returns (status,ticks_per_us,entries) with entries a list of
+    (name,calls,cycles,max_cycles)
+    """
+    flags = 0
+    if reset:
+      flags |= 1
+    result = self.cmdline.do_command('sp%02x' % flags)
+    if result != STATUS_OK:
+      return (result,0,[])
+    (result,num) = self.cmdline.get_byte()
+    if result != STATUS_OK:
+      return (result,0,[])
+    (result,ticks_per_us) = self.cmdline.get_byte()
+    if result != STATUS_OK:
+      return (result,0,[])
+    entries = []
+    for i in xrange(num):
+      values = []
+      for j in xrange(4): # calls, cycles hi/lo, max
+        (result,value) = self.cmdline.get_dword()
+        if result != STATUS_OK:
+          return (result,0,[])
+        values.append(value)
+      if i < len(self.prof_names):
+        name = self.prof_names[i]
+      else:
+        name = "prof_%d" % i
+      entries.append((name,values[0],(values[1] << 32) | values[2],values[3]))
+    return (STATUS_OK,ticks_per_us,entries)
+
+  def read_trace(self,clear=False):
+    """Read the event trace of the firmware and optionally clear it.
+    Returns (status,trace) with a Trace object
+    """
+    flags = 0
+    if clear:
+      flags |= 1
+    result = self.cmdline.do_command('tr%02x' % flags)
+    if result != STATUS_OK:
+      return (result,None)
+    (result,num) = self.cmdline.get_word()
+    if result != STATUS_OK:
+      return (result,None)
+    (result,lost) = self.cmdline.get_word()
+    if result != STATUS_OK:
+      return (result,None)
+    entries = []
+    for i in xrange(num):
+      (result,line) = self.cmdline.con.receive_data(14) # uuuuuuuueeaa\r\n
+      if result != STATUS_OK:
+        return (result,None)
+      try:
+        entries.append(Trace.parse_line(line))
+      except ValueError:
+        return (CLIENT_ERROR_INVALID_HEX_NUMBER,None)
+    return (STATUS_OK,Trace(entries,lost))
+
   def get_client_version(self):
     """Return version of client"""
     return (self.client_major,self.client_minor)
@@ -73,26 +221,244 @@ class Command:
 
   # ----- dtv client commands -----------------------------------------------
 
+  def has_mem_commands(self):
+    """Probe once if the firmware has the memory commands 'k', 'wv', 'lr',
+    'lw', 'rp' and 'wp' (built with USE_MEMCMD). A bare 'k' is rejected
+    with too few arguments if it exists and as unknown otherwise.
+    Return (result,has_commands)
+    """
+    if self.mem_commands == None:
+      result = self.cmdline.do_command("k")
+      if result == CMDLINE_ERROR_TOO_FEW_ARGS | CMDLINE_ERROR_MASK:
+        self.mem_commands = True
+      elif result == CMDLINE_ERROR_UNKNOWN_COMMAND | CMDLINE_ERROR_MASK:
+        self.mem_commands = False
+      else:
+        return (result,False)
+    return (STATUS_OK,self.mem_commands)
+
   def read_memory(self,rom,start,length,callback=lambda x:True,block_size=0x400):
     """Read a memory block from the DTV.
+    If a pack servlet is set then RAM ranges are transferred packed.
     Return (result,data,client_rx_rate,server_rx_rate).
     """
-    cmd = "r%02x%06x%06x" % (rom,start,length)
     self.transfer.begin_rx_rates()
-    (result,data) = self.transfer.do_receive_command(cmd,start,length,callback=callback,block_size=block_size);
+    if self.pack_servlet == None:
+      (result,data) = self.read_raw_memory(rom,start,length,callback,block_size)
+    else:
+      (result,data) = self.read_packed_memory(rom,start,length,callback,block_size)
     stat          = self.transfer.get_rx_rates(length)
     return (result,data,stat)
 
-  def write_memory(self,rom,start,data,callback=lambda x:True,block_size=0x400):
+  def read_raw_memory(self,rom,start,length,callback=lambda x:True,block_size=0x400):
+    """Read a memory block from the DTV byte by byte.
+    Return (result,data).
+    """
+    cmd = "r%02x%06x%06x" % (rom,start,length)
+    return self.transfer.do_receive_command(cmd,start,length,callback=callback,block_size=block_size)
+
+  def write_memory(self,rom,start,data,callback=lambda x:True,block_size=0x400,verify=False):
     """Write a memory block to the DTV
+    If a pack servlet is set then RAM ranges are transferred packed.
+    If verify is set then dtv2ser reads back each written block and compares it.
     Return (result,client_tx_rate,server_tx_rate).
     """
-    cmd = "w%02x%06x%06x" % (rom,start,len(data))
     self.transfer.begin_tx_rates()
-    result    = self.transfer.do_send_command(cmd,start,data,callback=callback,block_size=block_size)
+    if self.pack_servlet == None:
+      result  = self.write_raw_memory(rom,start,data,callback,block_size,verify)
+    else:
+      result  = self.write_packed_memory(rom,start,data,callback,block_size,verify)
     stat      = self.transfer.get_tx_rates(len(data))
+    self.notify_mem_change(rom,start,len(data))
     return (result,stat)
 
+  def write_raw_memory(self,rom,start,data,callback=lambda x:True,block_size=0x400,verify=False):
+    """Write a memory block to the DTV byte by byte.
+    Without the 'wv' command in the firmware the block is read back and
+    compared by the client.
+    Return result.
+    """
+    readback = False
+    if verify:
+      (result,has_commands) = self.has_mem_commands()
+      if result != STATUS_OK:
+        return result
+      readback = not has_commands
+    if verify and not readback:
+      cmd = "wv%02x%06x%06x" % (rom,start,len(data))
+    else:
+      cmd = "w%02x%06x%06x" % (rom,start,len(data))
+    result = self.transfer.do_send_command(cmd,start,data,callback=callback,block_size=block_size)
+    if result != STATUS_OK or not readback:
+      return result
+    (result,verify_data) = self.read_raw_memory(rom,start,len(data),block_size=block_size)
+    if result == STATUS_OK and verify_data != data:
+      result = TRANSFER_ERROR_VERIFY_MISMATCH
+    return result
+
+  def read_memory_list(self,ranges,callback=lambda x:True,block_size=0x400):
+    """Read a list of (rom,start,length) ranges from the DTV.
+    All ranges are transferred with a single command. Without the 'lr'
+    command in the firmware each range is read with its own 'r' command.
+    Return (result,data_list,stat) with the data of each range.
+    """
+    (result,has_commands) = self.has_mem_commands()
+    if result != STATUS_OK:
+      return (result,[],(0,0,0,0))
+    self.transfer.begin_rx_rates()
+    data = ''
+    for i in xrange(0,len(ranges),self.max_list_ranges):
+      part = ranges[i:i+self.max_list_ranges]
+      offset = len(data)
+      if has_commands:
+        (result,part_data) = self.transfer.do_receive_list_command(part,lambda x: callback(offset + x),block_size)
+      else:
+        (result,part_data) = self.read_raw_list(part,lambda x: callback(offset + x),block_size)
+      data += part_data
+      if result != STATUS_OK:
+        break
+    stat = self.transfer.get_rx_rates(len(data))
+    # split into ranges
+    data_list = []
+    pos = 0
+    for (rom,start,length) in ranges:
+      data_list.append(data[pos:pos+length])
+      pos += length
+    return (result,data_list,stat)
+
+  def write_memory_list(self,ranges,data_list,callback=lambda x:True,block_size=0x400):
+    """Write a list of (rom,start) ranges with the data in data_list to the DTV.
+    All ranges are transferred with a single command. Without the 'lw'
+    command in the firmware each range is written with its own 'w' command.
+    Return (result,stat).
+    """
+    (result,has_commands) = self.has_mem_commands()
+    if result != STATUS_OK:
+      return (result,(0,0,0,0))
+    self.transfer.begin_tx_rates()
+    full_ranges = []
+    for i in xrange(len(ranges)):
+      full_ranges.append((ranges[i][0],ranges[i][1],len(data_list[i])))
+    total = 0
+    for i in xrange(0,len(full_ranges),self.max_list_ranges):
+      part = full_ranges[i:i+self.max_list_ranges]
+      data = "".join(data_list[i:i+self.max_list_ranges])
+      offset = total
+      if has_commands:
+        result = self.transfer.do_send_list_command(part,data,lambda x: callback(offset + x),block_size)
+      else:
+        result = self.write_raw_list(part,data,lambda x: callback(offset + x),block_size)
+      if result != STATUS_OK:
+        break
+      total += len(data)
+    stat = self.transfer.get_tx_rates(total)
+    for (rom,start,length) in full_ranges:
+      self.notify_mem_change(rom,start,length)
+    return (result,stat)
+
+  def read_raw_list(self,ranges,callback=lambda x:True,block_size=0x400):
+    """Read a list of (rom,start,length) ranges with one 'r' command each.
+    Return (result,data) with the data of all ranges joined.
+    """
+    data = ''
+    for (rom,start,length) in ranges:
+      offset = len(data)
+      (result,part_data) = self.read_raw_memory(rom,start,length,lambda x: callback(offset + x),block_size)
+      data += part_data
+      if result != STATUS_OK:
+        return (result,data)
+    return (STATUS_OK,data)
+
+  def write_raw_list(self,ranges,data,callback=lambda x:True,block_size=0x400):
+    """Write a list of (rom,start,length) ranges with one 'w' command each.
+    Return result.
+    """
+    pos = 0
+    for (rom,start,length) in ranges:
+      offset = pos
+      result = self.write_raw_memory(rom,start,data[pos:pos+length],lambda x: callback(offset + x),block_size)
+      if result != STATUS_OK:
+        return result
+      pos += length
+    return STATUS_OK
+
+  def crc_memory(self,rom,start,length,callback=lambda x:True,block_size=0x400):
+    """Read the CRC16 of each block of a memory range from the DTV.
+    Only the checksums are transferred via serial.
+    Return (result,crc_list,stat) with crc_list of (start,length,crc16).
+    """
+    self.transfer.begin_rx_rates()
+    cmd = "k%02x%06x%06x" % (rom,start,length)
+    (result,crc_list) = self.transfer.do_crc_command(cmd,start,length,callback=callback,block_size=block_size)
+    stat = self.transfer.get_rx_rates(length)
+    return (result,crc_list,stat)
+
+  def diff_memory(self,rom,start,data,callback=lambda x:True,block_size=0x400):
+    """Compare data with DTV memory by block CRC16s.
+    Without the 'k' command in the firmware the whole range is read back and
+    the CRC16s are calculated by the client.
+    Return (result,blocks) with the (start,length) of all differing blocks.
+    """
+    (result,has_commands) = self.has_mem_commands()
+    if result != STATUS_OK:
+      return (result,[])
+    if has_commands:
+      (result,crc_list,stat) = self.crc_memory(rom,start,len(data),callback,block_size)
+    else:
+      (result,crc_list) = self.crc_read_memory(rom,start,len(data),callback,block_size)
+    if result != STATUS_OK:
+      return (result,[])
+    blocks = []
+    for (pos,size,crc16) in crc_list:
+      offset = pos - start
+      if self.transfer.calc_crc16(data[offset:offset+size]) != crc16:
+        blocks.append((pos,size))
+    return (STATUS_OK,blocks)
+
+  def crc_read_memory(self,rom,start,length,callback=lambda x:True,block_size=0x400):
+    """Read a memory range and calculate the CRC16 of each block like 'k'.
+    Return (result,crc_list) with crc_list of (start,length,crc16).
+    """
+    (result,data) = self.read_raw_memory(rom,start,length,callback,block_size)
+    if result != STATUS_OK:
+      return (result,[])
+    crc_list = []
+    for offset in xrange(0,length,block_size):
+      block = data[offset:offset+block_size]
+      crc_list.append((start + offset,len(block),self.transfer.calc_crc16(block)))
+    return (STATUS_OK,crc_list)
+
+  def sync_memory(self,rom,start,data,callback=lambda x:True,block_size=0x400,verify=False):
+    """Write only the blocks of data that differ from DTV memory.
+    Return (result,stat,num_blocks) with the number of written blocks.
+    """
+    begin_time = time.time()
+    (result,blocks) = self.diff_memory(rom,start,data,callback,block_size)
+    if result != STATUS_OK:
+      return (result,(0,0,0,0),0)
+
+    # join adjacent blocks to larger writes
+    runs = []
+    for (pos,size) in blocks:
+      if len(runs) > 0 and runs[-1][0] + runs[-1][1] == pos:
+        runs[-1] = (runs[-1][0],runs[-1][1] + size)
+      else:
+        runs.append((pos,size))
+
+    total = 0
+    for (pos,size) in runs:
+      offset = pos - start
+      (result,stat) = self.write_memory(rom,pos,data[offset:offset+size],
+                                        lambda x: callback(offset + x),block_size,verify)
+      if result != STATUS_OK:
+        break
+      total += size
+
+    # report the whole operation
+    self.transfer.tx_begin_time = begin_time
+    stat = self.transfer.get_tx_rates(total)
+    return (result,stat,len(blocks))
+
   def write_boot_memory(self,start,data,callback=lambda x:True):
     """Write a boot memory block to the DTV
     Return (result,client_tx_rate,server_tx_rate).
@@ -100,20 +466,172 @@ class Command:
     self.transfer.begin_tx_rates()
     result    = self.transfer.do_send_boot(start,data,callback=callback)
     stat      = self.transfer.get_tx_rates(len(data))
+    self.notify_mem_change(0,start,len(data))
     return (result,stat)
 
-  def dtv_reset(self,mode=RESET_NORMAL):
+  def dtv_reset(self,mode=RESET_NORMAL,wait_ready=False):
     """Reset the DTV and enter dtvtrans if dtvmon is available.
+    With wait_ready dtv2ser returns as soon as dtvtrans answers and the
+    measured boot time is stored in boot_time.
     Return result.
     """
+    if wait_ready:
+      mode |= RESET_WAIT_READY
     result = self.cmdline.do_command("x%02x" % mode)
     if result != STATUS_OK:
       return result
-    result = self.cmdline.get_status_byte()
+    if wait_ready:
+      result = self.cmdline.wait_for_data(self.reset_ready_timeout)
+      if result == STATUS_OK:
+        result = self.cmdline.get_status_byte()
+        (word_result,boot_ms) = self.cmdline.get_word()
+        if result == STATUS_OK:
+          result = word_result
+        self.boot_time = boot_ms / 1000.0
+    else:
+      result = self.cmdline.get_status_byte()
     # a reset invalidates the state
     self.state.invalidate()
+    if wait_ready and result == STATUS_OK:
+      self.state.set_alive()
+    self.notify_mem_change(0,0,0x200000)
     return result
 
+  def notify_mem_change(self,rom,start,length):
+    """Tell all users of resident DTV code that a memory range changed"""
+    # overwritten the pack servlet?
+    if self.pack.hits_servlet(rom,start,length):
+      self.pack_loaded = False
+    for listener in self.mem_listeners:
+      listener(rom,start,length)
+
+  # ----- packed transfers --------------------------------------------------
+
+  def set_pack_servlet(self,data):
+    """Enable packed transfers with the contents of pack_srv.prg.
+    Pass None to disable them again.
+    """
+    self.pack_servlet = data
+    self.pack_loaded  = False
+
+  def load_pack_servlet(self,block_size=0x400):
+    """Upload the pack servlet if it is not already in DTV memory.
+    Return result.
+    """
+    if self.pack_loaded:
+      return STATUS_OK
+    result = self.write_raw_memory(0,self.pack.servlet_start,self.pack_servlet,block_size=block_size)
+    if result == STATUS_OK:
+      self.pack_loaded = True
+    return result
+
+  def read_packed_chunk(self,start,length,callback=lambda x:True,block_size=0x400):
+    """Pack a RAM chunk on the DTV and fetch the packed stream.
+    Falls back to a raw read if packing does not pay off.
+    Return (result,data).
+    """
+    result = self.load_pack_servlet(block_size)
+    if result != STATUS_OK:
+      return (result,'')
+
+    # pass range to servlet
+    param = self.pack.param_data(start,length)
+    result = self.write_raw_memory(0,self.pack.servlet_param,param,block_size=block_size)
+    if result != STATUS_OK:
+      return (result,'')
+
+    # pack it
+    (result,sr,acc,xr,yr,duration) = self.sys_call(self.pack.servlet_pack_rle,timeout=5.0)
+    if result != STATUS_OK:
+      return (result,'')
+    if acc != self.pack.servlet_pack_ok:
+      return self.read_raw_memory(0,start,length,callback,block_size)
+
+    # fetch packed stream and unpack it
+    packed_length = xr | (yr << 8)
+    callback(0)
+    (result,packed) = self.read_raw_memory(0,self.pack.servlet_buffer,packed_length,block_size=block_size)
+    if result != STATUS_OK:
+      return (result,'')
+    return self.pack.rle_decode(packed,length)
+
+  def read_packed_memory(self,rom,start,length,callback=lambda x:True,block_size=0x400):
+    """Read a memory block and pack all RAM chunks that are large enough.
+    Return (result,data).
+    """
+    begin_time = time.time()
+    data = ''
+    for (pos,size,packable) in self.pack.split_range(rom,start,length):
+      offset = pos - start
+      chunk_callback = lambda x: callback(offset + x)
+      if packable:
+        (result,chunk) = self.read_packed_chunk(pos,size,chunk_callback,block_size)
+      else:
+        (result,chunk) = self.read_raw_memory(rom,pos,size,chunk_callback,block_size)
+      if result != STATUS_OK:
+        return (result,data)
+      data += chunk
+
+    # report the effective rate of the whole operation
+    self.transfer.update_client_rx_rate(length,time.time() - begin_time)
+    self.transfer.server_rx_rate = self.transfer.client_rx_rate
+    return (STATUS_OK,data)
+
+  def write_packed_chunk(self,start,data,begin,end,window_begin,block_size=0x400):
+    """Pack data[begin:end] and let the servlet unpack it to start+begin.
+    Falls back to a raw write if packing does not pay off.
+    Return result.
+    """
+    packed = self.pack.lz_encode(data,begin,end,window_begin)
+    if len(packed) >= end - begin:
+      return self.write_raw_memory(0,start+begin,data[begin:end],block_size=block_size)
+
+    result = self.load_pack_servlet(block_size)
+    if result != STATUS_OK:
+      return result
+
+    # upload packed stream and its target
+    result = self.write_raw_memory(0,self.pack.servlet_buffer,packed,block_size=block_size)
+    if result != STATUS_OK:
+      return result
+    param = self.pack.param_data(start+begin,len(packed))
+    result = self.write_raw_memory(0,self.pack.servlet_param,param,block_size=block_size)
+    if result != STATUS_OK:
+      return result
+
+    # unpack it and compare checksum
+    (result,sr,acc,xr,yr,duration) = self.sys_call(self.pack.servlet_unpack_lz,timeout=5.0)
+    if result != STATUS_OK:
+      return result
+    if acc != 0 or (xr,yr) != self.pack.checksum(data[begin:end]):
+      return TRANSFER_ERROR_VERIFY_MISMATCH
+    return STATUS_OK
+
+  def write_packed_memory(self,rom,start,data,callback=lambda x:True,block_size=0x400,verify=False):
+    """Write a memory block and pack all RAM chunks that are large enough.
+    Packed chunks are always verified by the unpack checksum.
+    Return result.
+    """
+    begin_time = time.time()
+    length = len(data)
+    # packed chunks may refer back to all RAM already written
+    window_begin = max(0,self.pack.pack_range_begin - start)
+    for (pos,size,packable) in self.pack.split_range(rom,start,length):
+      begin = pos - start
+      chunk_callback = lambda x: callback(begin + x)
+      if packable:
+        callback(begin)
+        result = self.write_packed_chunk(start,data,begin,begin+size,window_begin,block_size)
+      else:
+        result = self.write_raw_memory(rom,pos,data[begin:begin+size],chunk_callback,block_size,verify)
+      if result != STATUS_OK:
+        return result
+
+    # report the effective rate of the whole operation
+    self.transfer.update_client_tx_rate(length,time.time() - begin_time)
+    self.transfer.server_tx_rate = self.transfer.client_tx_rate
+    return STATUS_OK
+
   # ----- dtvtrans commands -------------------------------------------------
 
   def is_alive(self,timeout=0.5):
@@ -170,10 +688,52 @@ class Command:
     return (STATUS_OK,output[0],output[1],output[2],output[3])
 
   def sys_call(self,ptr,sr=0,acc=0,xr=0,yr=0,iocfg=7,timeout=10.0,mode=0):
-    """perform a sys call and wait for result
+    """perform a sys call and wait for result.
+    dtv2ser runs CMD_SYS, waits for dtvtrans and fetches CMD_SYS_RESULT.
+    A firmware without 'cs' (built without USE_SYSCMD) is detected on the
+    first call and then polled from the client.
     Return (result,sr,acc,xr,yr,duration)
     """
+    if self.has_sys_call == False:
+      return self.sys_call_polled(ptr,sr,acc,xr,yr,iocfg,timeout,mode)
+
+    (lo,hi) = self.lohi(ptr)
+    # timeout in 10ms, dtv2ser counts in a 16 bit ms timer
+    tms = min(int(timeout * 100),0x1999)
+    cmd = "cs%02x%02x%02x%02x%02x%02x%02x%02x%04x" % (mode,lo,hi,sr,acc,xr,yr,iocfg,tms)
+    result = self.cmdline.do_command(cmd)
+    if self.has_sys_call == None:
+      if result & CMDLINE_ERROR_MASK:
+        # 'cs' is unknown or parsed as 'c' with invalid arguments
+        self.has_sys_call = False
+        return self.sys_call_polled(ptr,sr,acc,xr,yr,iocfg,timeout,mode)
+      self.has_sys_call = True
+    if result != STATUS_OK:
+      return (result,0,0,0,0,0)
+
+    # wait for sys call to return
+    result = self.cmdline.wait_for_data(timeout + 1.0)
+    if result != STATUS_OK:
+      return (result,0,0,0,0,0)
+    result = self.cmdline.get_status_byte()
+    (word_result,duration_ms) = self.cmdline.get_word()
+    duration = duration_ms / 1000.0
+    if result != STATUS_OK:
+      return (result,0,0,0,0,duration)
+    if word_result != STATUS_OK:
+      return (word_result,0,0,0,0,duration)
+
+    # fetch result
+    (result,output) = self.cmdline.get_output_bytes(4)
+    if result != STATUS_OK:
+      return (result,0,0,0,0,duration)
+    return (STATUS_OK,output[0],output[1],output[2],output[3],duration)
 
+  def sys_call_polled(self,ptr,sr=0,acc=0,xr=0,yr=0,iocfg=7,timeout=10.0,mode=0):
+    """perform a sys call with CMD_SYS, poll dtvtrans with is alive until
+    the call returned and fetch CMD_SYS_RESULT.
+    Return (result,sr,acc,xr,yr,duration)
+    """
     # do sys
     result = self.sys(ptr,sr,acc,xr,yr,iocfg,mode=mode)
     if result != STATUS_OK:
@@ -352,7 +912,7 @@ class Command:
     stream = self.joyStream.generate_wiggle_stream(duration,delay)
     print "\t%d seconds of wiggling with %d ms delay" % (duration,delay*10)
     print "\tsending joy stream with %d bytes" % len(stream)
-    return self.transfer.do_joy_stream(stream,callback)
+    return self.transfer.do_joy_stream(stream,callback,self.joy_buffered)
 
   def joy_rawkey(self,delta,delay,callback=lambda x:True):
     """Press a single key on the virtual DTV keyboard by specifying the
@@ -360,7 +920,7 @@ class Command:
     stream = self.joyStream.generate_delta_move_stream(delta,delay)
     print "\tpressing raw key at",delta,"with",delay*10,"ms delay"
     print "\tsending joy stream with %d bytes" % len(stream)
-    return self.transfer.do_joy_stream(stream,callback)
+    return self.transfer.do_joy_stream(stream,callback,self.joy_buffered)
 
   def joy_stream(self,string,
                  joy_delay=0,
@@ -378,7 +938,7 @@ class Command:
     if test_mode:
       return STATUS_OK,0
     else:
-      return self.transfer.do_joy_stream_seq(js_seq,callback)
+      return self.transfer.do_joy_stream_seq(js_seq,callback,self.joy_buffered)
 
   def joy_type(self,string,
                screen_code=False,
@@ -387,6 +947,7 @@ class Command:
                start_key='',
                verbose=False,
                test_mode=False,
+               greedy=False,
                callback=lambda x:True):
     """Type a string on the virtual DTV keyboard"""
 
@@ -394,6 +955,7 @@ class Command:
     status=self.autoType.setup(start_key,type_delay,joy_delay)
     if status != STATUS_OK:
       return status
+    self.autoType.optimize = not greedy
 
     # conver string from auto type
     if screen_code:
@@ -406,6 +968,10 @@ class Command:
 
     at_seq=self.autoType.convert_string_to_autotype_seq(string)
     print "\tauto type:  typing %d joy string bytes with %d sequence entries" % (len(string),len(at_seq))
+    if not greedy:
+      greedy_time = self.autoType.greedy_duration / 100.0
+      plan_time = self.autoType.plan_duration / 100.0
+      print "\tkey planner: %.2fs est. move time, %.2fs saved vs. greedy moves" % (plan_time,greedy_time - plan_time)
     js_seq,total_cmds = self.joyStream.convert_autotype_seq(at_seq)
     print "\tjoy stream: sending stream with %d segment(s) and %d total bytes" % (len(js_seq),total_cmds)
     if verbose:
@@ -414,7 +980,7 @@ class Command:
     if test_mode:
       return STATUS_OK,0
     else:
-      return self.transfer.do_joy_stream_seq(js_seq,callback)
+      return self.transfer.do_joy_stream_seq(js_seq,callback,self.joy_buffered)
 
   # ----- diagnose commands -------------------------------------------------
 
@@ -425,7 +991,7 @@ class Command:
     if pattern != self.transfer.get_diagnose_pattern():
       result = self.transfer.set_diagnose_pattern(pattern)
       if result != STATUS_OK:
-        return result
+        return (result,None)
 
     cmd = "r%02x%06x%06x" % (rom,start,length)
     self.transfer.begin_rx_rates()
@@ -440,7 +1006,7 @@ class Command:
     if pattern != self.transfer.get_diagnose_pattern():
       result = self.transfer.set_diagnose_pattern(pattern)
       if result != STATUS_OK:
-        return result
+        return (result,None)
 
     cmd = "w%02x%06x%06x" % (rom,start,length)
     self.transfer.begin_tx_rates()
@@ -455,7 +1021,7 @@ class Command:
     if pattern != self.transfer.get_diagnose_pattern():
       result = self.transfer.set_diagnose_pattern(pattern)
       if result != STATUS_OK:
-        return result
+        return (result,None)
 
     cmd = "r00000000%06x" % length
     self.transfer.begin_rx_rates()
@@ -470,7 +1036,7 @@ class Command:
     if pattern != self.transfer.get_diagnose_pattern():
       result = self.transfer.set_diagnose_pattern(pattern)
       if result != STATUS_OK:
-        return result
+        return (result,None)
 
     cmd = "w00000000%06x" % length
     self.transfer.begin_tx_rates()
@@ -480,11 +1046,62 @@ class Command:
 
   # ----- high level commands -----------------------------------------------
 
+  def peek_memory(self,rom,start,length):
+    """Read a few bytes of memory inline with the 'rp' command.
+    Without 'rp' a normal read transfer is used.
+    Return (result,data)
+    """
+    (result,has_cmds) = self.has_mem_commands()
+    if result != STATUS_OK:
+      return (result,'')
+    if not has_cmds:
+      (result,data,stat) = self.read_memory(rom,start,length)
+      return (result,data)
+    data = ''
+    while length > 0:
+      size = min(length,self.max_peek_size)
+      result = self.cmdline.do_command("rp%02x%06x%02x" % (rom,start,size))
+      if result != STATUS_OK:
+        return (result,data)
+      (result,output) = self.cmdline.get_output_bytes(size)
+      if result != STATUS_OK:
+        return (result,data)
+      data += "".join(map(chr,output))
+      start += size
+      length -= size
+    return (STATUS_OK,data)
+
+  def poke_memory(self,rom,start,data):
+    """Write a few bytes of memory inline with the 'wp' command.
+    Without 'wp' a normal write transfer is used.
+    Return result
+    """
+    (result,has_cmds) = self.has_mem_commands()
+    if result != STATUS_OK:
+      return result
+    if not has_cmds:
+      (result,stat) = self.write_memory(rom,start,data)
+      return result
+    pos = 0
+    length = len(data)
+    while pos < length:
+      chunk = data[pos:pos+self.max_poke_size]
+      cmd = "wp%02x%06x" % (rom,start+pos) + "".join(map(lambda x: "%02x" % ord(x),chunk))
+      result = self.cmdline.do_command(cmd)
+      if result != STATUS_OK:
+        return result
+      result = self.cmdline.get_status_byte()
+      if result != STATUS_OK:
+        return result
+      pos += len(chunk)
+    self.notify_mem_change(rom,start,length)
+    return STATUS_OK
+
   def read_word(self,addr):
     """Read a word form memory in lo hi format
     Return (result,value)
     """
-    (result,data,stat) = self.read_memory(0,addr,2)
+    (result,data) = self.peek_memory(0,addr,2)
     if result != STATUS_OK:
       return (result,0)
     value = ord(data[0]) | (ord(data[1])<<8)
@@ -495,14 +1112,13 @@ class Command:
     Return result
     """
     data = chr(val & 0xff) + chr((val >> 8) & 0xff)
-    (result,stat) = self.write_memory(0,addr,data)
-    return result
+    return self.poke_memory(0,addr,data)
 
   def read_byte(self,addr):
     """Read a byte form memory
     Return (result,value)
     """
-    (result,data,stat) = self.read_memory(0,addr,1)
+    (result,data) = self.peek_memory(0,addr,1)
     if result != STATUS_OK:
       return (result,0)
     value = ord(data[0])
@@ -513,5 +1129,4 @@ class Command:
     Return result
     """
     data = chr(val & 0xff)
-    (result,stat) = self.write_memory(0,addr,data)
-    return result
+    return self.poke_memory(0,addr,data)
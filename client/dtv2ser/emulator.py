@@ -0,0 +1,870 @@
+#
+# emulator.py - software emulation of a dtv2ser device with a DTV
+#
+# Written by
+#  Christian Vogelgsang <chris@vogelgsang.org>
+#
+# This file is part of dtv2ser.
+# See README for copyright notice.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+#  02111-1307  USA.
+#
+
+import os
+import select
+import time
+import errno
+
+from dtv2ser.status import *
+
+# crc16 of avr-libc _crc16_update() (poly 0xa001) as used by the firmware
+crc16_table = []
+for i in xrange(256):
+  crc = i
+  for j in xrange(8):
+    if crc & 1:
+      crc = (crc >> 1) ^ 0xA001
+    else:
+      crc = crc >> 1
+  crc16_table.append(crc)
+
+def crc16_update(crc,data):
+  """Update crc16 with all bytes of data string"""
+  for c in data:
+    crc = (crc >> 8) ^ crc16_table[(crc ^ ord(c)) & 0xff]
+  return crc
+
+class EmuHangup(Exception):
+  """The client closed the connection"""
+  pass
+
+class EmuLink:
+  """Byte stream to the client on a file descriptor (pty master or socket)
+     that simulates the bandwidth of the serial line and the turnaround
+     latency of the device (e.g. the poll interval of a USB adapter)."""
+
+  def __init__(self,fd,speed=230400,latency=0.0):
+    self.fd = fd
+    # bytes per second with 8N1 framing (0 = unlimited)
+    if speed > 0:
+      self.bps = speed / 10.0
+    else:
+      self.bps = 0
+    self.latency = latency
+    self.rx_buf = ''
+    # time the line is free again for the next byte
+    self.line_free = 0.0
+    # data was received since the last send: next reply pays latency
+    self.turnaround = False
+    self.rx_bytes = 0
+    self.tx_bytes = 0
+
+  def pace(self,num):
+    """Delay until num bytes passed the simulated line"""
+    if self.bps == 0:
+      return
+    now = time.time()
+    self.line_free = max(self.line_free,now) + num / self.bps
+    delay = self.line_free - now
+    # sleep only in larger steps: single bytes take a few us
+    if delay > 0.001:
+      time.sleep(delay)
+
+  def fill(self,timeout):
+    """Wait up to timeout seconds for data of the client.
+    Returns True if data was read"""
+    try:
+      (r,w,x) = select.select([self.fd],[],[],timeout)
+    except select.error,e:
+      if e[0] == errno.EINTR:
+        return False
+      raise
+    if len(r) == 0:
+      return False
+    try:
+      data = os.read(self.fd,4096)
+    except OSError,e:
+      # a pty master without slave reports EIO
+      if e.errno == errno.EIO:
+        raise EmuHangup()
+      raise
+    if data == '':
+      raise EmuHangup()
+    self.rx_buf += data
+    return True
+
+  def available(self):
+    """Is data of the client available?"""
+    if len(self.rx_buf) > 0:
+      return True
+    return self.fill(0)
+
+  def read(self,num,timeout):
+    """Read num bytes. timeout is the max time between two bytes.
+    Returns the data which is shorter on a time out"""
+    while len(self.rx_buf) < num:
+      if not self.fill(timeout):
+        break
+    data = self.rx_buf[:num]
+    self.rx_buf = self.rx_buf[num:]
+    if len(data) > 0:
+      self.pace(len(data))
+      self.rx_bytes += len(data)
+      self.turnaround = True
+    return data
+
+  def read_byte(self,timeout):
+    """Read a byte. Returns its value or None on time out"""
+    data = self.read(1,timeout)
+    if data == '':
+      return None
+    return ord(data)
+
+  def drain(self):
+    """Discard all received data"""
+    while self.available():
+      self.rx_buf = ''
+
+  def send(self,data):
+    """Send data to the client"""
+    if self.turnaround:
+      self.turnaround = False
+      if self.latency > 0:
+        time.sleep(self.latency)
+    self.pace(len(data))
+    while len(data) > 0:
+      try:
+        n = os.write(self.fd,data)
+      except OSError,e:
+        if e.errno == errno.EAGAIN:
+          select.select([],[self.fd],[],1.0)
+          continue
+        raise EmuHangup()
+      data = data[n:]
+      self.tx_bytes += n
+
+class Emulator:
+  """Emulate the firmware of a dtv2ser device and an attached DTV running
+     dtvtrans on an EmuLink. Commands, transfer framing, timeouts and the
+     error cycle follow the firmware in server/. The DTV is a RAM and ROM
+     image without a CPU: sys calls return the passed registers."""
+
+  # firmware version reported by 'v': matches the client
+  version_major = 0
+  version_minor = 6
+
+  # dtvtrans server on the DTV
+  dtv_revision  = (1,0)
+  dtv_impl      = "DTV2SER EMULATOR"
+  dtv_port      = 0          # joy1
+  dtv_mode      = 0          # RAM
+  dtv_start     = 0x00f800
+  dtv_end       = 0x00ffff
+  # time the DTV needs to boot into dtvtrans after a reset
+  boot_time     = 0.05
+  # ms the knock is held with wait ready (DTVLOW_RESET_KNOCK_HOLD)
+  reset_knock_hold = 100
+
+  mem_size      = 0x200000
+  cmdline_size  = 40
+  max_ranges    = 8
+  peek_max_size = 32
+
+  # firmware limits of the command line parser
+  max_arg_byte  = 16
+
+  stats_num       = 16
+  stats_ack_bins  = 16
+
+  # default parameters of param.c
+  default_param_bytes = [2,5,0,3,2]
+  default_param_words = [500,10,1000,500,500,500,500,0x400,20]
+
+  joy_loop_depth = 2
+
+  def __init__(self,dtv_rate=0,verbose=False):
+    self.link = None
+    # dtvlow bytes per second (0 = unlimited)
+    self.dtv_rate = dtv_rate
+    self.dtv_free = 0.0
+    self.verbose = verbose
+
+    self.ram = bytearray(self.mem_size)
+    self.rom = bytearray('\xff' * self.mem_size)
+    self.alive = True
+    # registers of the last CMD_SYS: sr,acc,xr,yr
+    self.sys_regs = [0,0,0,0]
+
+    self.param_bytes = list(self.default_param_bytes)
+    self.param_words = list(self.default_param_words)
+    self.eeprom = (list(self.param_bytes),list(self.param_words))
+
+    self.transfer_mode = TRANSFER_MODE_NORMAL
+    self.transfer_state = (STATUS_OK,0,0,0)
+    self.stats = [0] * self.stats_num
+
+    self.cmdline = ''
+
+    # command table: the first matching prefix wins (see cmdtable.c)
+    self.commands = [
+      ("m","b",self.exec_transfer_mode),
+      ("rp","btb",self.exec_peek_memory),
+      ("r","btt",self.exec_read_memory),
+      ("wv","btt",self.exec_write_verify_memory),
+      ("wp","bt*",self.exec_poke_memory),
+      ("w","btt",self.exec_write_memory),
+      ("k","btt",self.exec_crc_memory),
+      ("lr","b",self.exec_read_memory_list),
+      ("lw","b",self.exec_write_memory_list),
+      ("t",None,self.exec_transfer_result),
+      ("b","ww",self.exec_boot_memory),
+      ("a","w",self.exec_is_alive),
+      ("cs","bbbbbbbbw",self.exec_sys_call),
+      ("c","bb*",self.exec_command),
+      ("x","b",self.exec_reset_dtv),
+      ("v",None,self.exec_version),
+      ("sa","b",self.exec_stats_ack),
+      ("s","b",self.exec_stats),
+      ("jb",None,self.exec_joy_buffered_stream),
+      ("j",None,self.exec_joy_stream),
+      ("pbs","bb",self.exec_set_byte_param),
+      ("pbg","b",self.exec_get_byte_param),
+      ("pws","bw",self.exec_set_word_param),
+      ("pwg","b",self.exec_get_word_param),
+      ("pc","b",self.exec_param_cmd),
+      ("pq",None,self.exec_param_query)
+    ]
+
+  def log(self,msg):
+    if self.verbose:
+      print "emu:",msg
+
+  # ----- uart helpers -----
+
+  def read_timeout(self):
+    return self.param_words[PARAM_WORD_SERIAL_READ_AVAIL_TIMEOUT] / 1000.0
+
+  def send_status(self,status):
+    """Send a status as raw byte"""
+    self.link.send(chr(status & 0xff))
+
+  def send_hex_byte(self,value):
+    self.link.send("%02X\r\n" % (value & 0xff))
+
+  def send_hex_word(self,value):
+    self.link.send("%04X\r\n" % (value & 0xffff))
+
+  def send_hex_dword(self,value):
+    self.link.send("%08X\r\n" % (value & 0xffffffff))
+
+  def timer_us(self):
+    return int(time.time() * 1000000)
+
+  def error_condition(self):
+    """Block the host for the error cycle and drop all its data"""
+    self.log("error cycle")
+    loops = self.param_bytes[PARAM_BYTE_ERROR_CONDITION_LOOPS]
+    delay = self.param_words[PARAM_WORD_ERROR_CONDITION_DELAY] / 1000.0
+    for i in xrange(loops):
+      time.sleep(delay)
+      self.link.drain()
+
+  # ----- dtv side -----
+
+  def dtv_pace(self,num):
+    """Delay until num bytes passed the simulated dtvlow port"""
+    if self.dtv_rate == 0:
+      return
+    now = time.time()
+    self.dtv_free = max(self.dtv_free,now) + float(num) / self.dtv_rate
+    delay = self.dtv_free - now
+    if delay > 0.001:
+      time.sleep(delay)
+
+  def dtv_mem(self,rom):
+    if rom:
+      return self.rom
+    else:
+      return self.ram
+
+  def dtv_read(self,rom,addr,length):
+    addr &= self.mem_size - 1
+    self.dtv_pace(length)
+    self.stats[3] += length
+    return str(self.dtv_mem(rom)[addr:addr+length])
+
+  def dtv_write(self,rom,addr,data):
+    addr &= self.mem_size - 1
+    self.dtv_pace(len(data))
+    self.stats[2] += len(data)
+    self.dtv_mem(rom)[addr:addr+len(data)] = data
+
+  def dtv_wait_ack(self):
+    """A dead dtvtrans server never acks: wait for the ack time out"""
+    time.sleep(self.param_words[PARAM_WORD_DTVLOW_WAIT_FOR_ACK_DELAY] / 1000.0)
+    self.stats[5] += 1
+    return TRANSFER_ERROR_DTVLOW_NOACK1
+
+  def dtv_command(self,cmd,args,out_size):
+    """Execute a dtvtrans command.
+    Returns (status,output)"""
+    if not self.alive:
+      return (self.dtv_wait_ack(),[])
+    self.dtv_pace(1 + len(args))
+    self.stats[2] += 1 + len(args)
+    output = []
+    if cmd == 0x04 and len(args) >= 8:
+      # CMD_SYS: mode,lo,hi,sr,acc,xr,yr,iocfg
+      self.sys_regs = args[3:7]
+      self.log("sys $%04x" % (args[1] | args[2] << 8))
+    elif cmd == 0x05:
+      # CMD_SYS_RESULT
+      output = list(self.sys_regs)
+    elif cmd == 0x60:
+      # CMD_PRINT
+      self.log("print '%s'" % "".join(map(chr,args[1:])))
+    elif cmd == 0x80:
+      # CMD_QUERY_REVISION
+      output = list(self.dtv_revision)
+    elif cmd == 0x81:
+      # CMD_QUERY_IMPLEMENTATION
+      output = map(ord,self.dtv_impl)
+    elif cmd == 0x82:
+      # CMD_QUERY_CONFIG: port, mode, start and end (lo first)
+      output = [self.dtv_port,self.dtv_mode]
+      for v in (self.dtv_start,self.dtv_end):
+        output += [v & 0xff,(v >> 8) & 0xff,(v >> 16) & 0xff]
+    # all other commands (exec, init, load, run, exit, color...) just ack
+    if out_size != 0xff:
+      output = (output + [0] * out_size)[:out_size]
+    self.dtv_pace(len(output))
+    self.stats[3] += len(output)
+    return (STATUS_OK,output)
+
+  # ----- command line -----
+
+  def parse_args(self,pattern,data):
+    """Parse hex arguments like parse_args() of cmdline.c.
+    Returns (status,bytes,words,dwords)"""
+    args = ([],[],[])
+    data = data.lstrip(' ')
+    if pattern == None:
+      if data == '':
+        return (STATUS_OK,) + args
+      return (CMDLINE_ERROR_NO_ARGS_ALLOWED,) + args
+    pos = 0
+    while pos < len(pattern):
+      p = pattern[pos]
+      if p != '*':
+        pos += 1
+      if data == '':
+        if p == '*':
+          break
+        return (CMDLINE_ERROR_TOO_FEW_ARGS,) + args
+      if p in 'b*':
+        (size,arg) = (2,args[0])
+        if len(arg) == self.max_arg_byte:
+          return (CMDLINE_ERROR_TOO_MANY_ARGS,) + args
+      elif p == 'w':
+        (size,arg) = (4,args[1])
+      else:
+        (size,arg) = (6,args[2])
+      if len(data) < size:
+        return (CMDLINE_ERROR_ARG_TOO_SHORT,) + args
+      try:
+        arg.append(int(data[:size],16))
+      except ValueError:
+        return (CMDLINE_ERROR_NO_HEX_ARG,) + args
+      data = data[size:].lstrip(' ')
+    if data != '':
+      return (CMDLINE_ERROR_TOO_MANY_ARGS,) + args
+    return (STATUS_OK,) + args
+
+  def handle_line(self,line):
+    """Parse and execute a command line"""
+    if len(line) == self.cmdline_size:
+      self.send_hex_byte(CMDLINE_ERROR_LINE_TOO_LONG)
+      return
+    for (name,pattern,func) in self.commands:
+      if line.startswith(name):
+        break
+    else:
+      self.send_hex_byte(CMDLINE_ERROR_UNKNOWN_COMMAND)
+      return
+    (status,b,w,d) = self.parse_args(pattern,line[len(name):])
+    self.send_hex_byte(status)
+    if status == STATUS_OK:
+      self.log(line)
+      func(b,w,d)
+
+  def handle_input(self):
+    """Collect command line chars like cmdline_handle()"""
+    data = self.link.read(1,1.0)
+    if data == '':
+      return
+    if data in '\r\n':
+      if len(self.cmdline) > 0:
+        line = self.cmdline
+        self.cmdline = ''
+        self.handle_line(line)
+    elif data in '\x08\x7f':
+      self.cmdline = self.cmdline[:-1]
+    elif data >= ' ':
+      if len(self.cmdline) < self.cmdline_size:
+        self.cmdline += data
+
+  def serve(self,link):
+    """Serve commands of a client until it hangs up"""
+    self.link = link
+    self.cmdline = ''
+    try:
+      while True:
+        self.handle_input()
+    except EmuHangup:
+      self.log("client hung up")
+    self.link = None
+
+  # ----- transfer engine (transfer.c) -----
+
+  def host_begin(self,host):
+    if host in ('tx','crc'):
+      # wait for start byte of client
+      if self.link.read_byte(self.read_timeout()) != STATUS_OK:
+        return TRANSFER_ERROR_CLIENT_TIMEOUT
+    elif host == 'rx':
+      self.send_status(STATUS_OK)
+    return STATUS_OK
+
+  def host_end(self,host,result):
+    if host in ('tx','crc'):
+      # end byte of client is the result
+      data = self.link.read_byte(self.read_timeout())
+      if data == None:
+        return TRANSFER_ERROR_CLIENT_TIMEOUT
+      if data == 0:
+        return STATUS_OK
+      return data | TRANSFER_ERROR_MASK
+    elif host == 'rx':
+      self.send_status(result)
+    return result
+
+  def host_check_tx(self,crc):
+    """Send crc16 of a block and check for an error byte of the client"""
+    self.link.send(chr(crc >> 8) + chr(crc & 0xff))
+    if self.link.available():
+      return TRANSFER_ERROR_CLIENT_ABORT
+    return STATUS_OK
+
+  def transfer_block(self,host,dtv,rom,addr,length):
+    """Transfer a single block between host and dtv.
+    Returns (result,transferred)"""
+    pattern = self.param_bytes[PARAM_BYTE_DIAGNOSE_PATTERN]
+    self.stats[4] += 1
+    if dtv in ('read','diag_read'):
+      # dtv -> host
+      if dtv == 'read':
+        data = self.dtv_read(rom,addr,length)
+      else:
+        data = chr(pattern) * length
+      if host == 'diag':
+        # dtv only: data must match the pattern
+        if data != chr(pattern) * length:
+          return (TRANSFER_ERROR_VERIFY_MISMATCH,0)
+        return (STATUS_OK,length)
+      if host == 'tx':
+        self.link.send(data)
+        self.stats[1] += length
+      crc = crc16_update(0xffff,data)
+      return (self.host_check_tx(crc),length)
+    else:
+      # host -> dtv
+      if host == 'diag':
+        data = chr(pattern) * length
+      else:
+        data = self.link.read(length,self.read_timeout())
+        self.stats[0] += len(data)
+        if len(data) < length:
+          return (TRANSFER_ERROR_CLIENT_TIMEOUT,len(data))
+      if dtv != 'diag_write':
+        self.dtv_write(rom,addr,data)
+        if dtv == 'verify' and self.dtv_read(rom,addr,length) != data:
+          return (TRANSFER_ERROR_VERIFY_MISMATCH,length)
+      if host == 'diag':
+        return (STATUS_OK,length)
+      crc = self.link.read(2,self.read_timeout())
+      self.stats[0] += len(crc)
+      if len(crc) < 2:
+        return (TRANSFER_ERROR_CLIENT_TIMEOUT,length)
+      if (ord(crc[0]) << 8 | ord(crc[1])) != crc16_update(0xffff,data):
+        self.stats[10] += 1
+        return (TRANSFER_ERROR_CRC16_MISMATCH,length)
+      return (STATUS_OK,length)
+
+  def transfer_range(self,host,dtv,rom,base,length):
+    """Transfer a range in blocks split at bank boundaries.
+    Returns (result,transferred)"""
+    block_size = self.param_words[PARAM_WORD_DTV_TRANSFER_BLOCK_SIZE]
+    total = 0
+    while length > 0:
+      offset = base & 0x3fff
+      size = min(length,block_size,0x4000 - offset)
+      (result,done) = self.transfer_block(host,dtv,rom,base,size)
+      if result != STATUS_OK:
+        return (result,total)
+      base += done
+      length -= done
+      total += done
+    return (STATUS_OK,total)
+
+  def transfer_mem_list(self,host,dtv,ranges):
+    """Transfer a list of (rom,base,length) ranges in a single transfer
+    and update the transfer state.
+    Returns result"""
+    start = self.timer_us()
+    result = self.host_begin(host)
+    data_start = self.timer_us()
+    if result != STATUS_OK:
+      self.transfer_state = (result,data_start - start,0,0)
+      return result
+
+    total = 0
+    for (rom,base,length) in ranges:
+      (result,done) = self.transfer_range(host,dtv,rom,base,length)
+      total += done
+      if result != STATUS_OK:
+        break
+
+    end_start = self.timer_us()
+    result = self.host_end(host,result)
+    end = self.timer_us()
+    self.transfer_state = (result,data_start - start,end_start - data_start,end - end_start)
+    self.log("transfer 0x%06x bytes: %s" % (total,get_result_string(result)))
+    return result
+
+  def read_pointers(self):
+    """Returns (host,dtv) for a transfer from the dtv"""
+    if self.transfer_mode == TRANSFER_MODE_DTV_ONLY:
+      return ('diag','read')
+    if self.transfer_mode == TRANSFER_MODE_SERIAL_ONLY:
+      return ('tx','diag_read')
+    return ('tx','read')
+
+  def write_pointers(self):
+    """Returns (host,dtv) for a transfer to the dtv"""
+    if self.transfer_mode == TRANSFER_MODE_DTV_ONLY:
+      return ('diag','write')
+    if self.transfer_mode == TRANSFER_MODE_SERIAL_ONLY:
+      return ('rx','diag_write')
+    return ('rx','write')
+
+  def generic_transfer(self,host,dtv,b,d):
+    result = self.transfer_mem_list(host,dtv,[(b[0],d[0],d[1])])
+    if result != STATUS_OK:
+      self.error_condition()
+
+  def recv_range_list(self,num):
+    """Receive range descriptors and acknowledge them.
+    Returns (result,ranges)"""
+    raw = self.link.read(num * 7 + 2,self.read_timeout())
+    if len(raw) < num * 7 + 2:
+      result = TRANSFER_ERROR_CLIENT_TIMEOUT
+    elif (ord(raw[-2]) << 8 | ord(raw[-1])) != crc16_update(0xffff,raw[:-2]):
+      result = TRANSFER_ERROR_CRC16_MISMATCH
+    else:
+      result = STATUS_OK
+    self.send_status(result)
+    ranges = []
+    if result == STATUS_OK:
+      for i in xrange(num):
+        v = map(ord,raw[i*7:i*7+7])
+        ranges.append((v[0],v[1] << 16 | v[2] << 8 | v[3],v[4] << 16 | v[5] << 8 | v[6]))
+    return (result,ranges)
+
+  def generic_list_transfer(self,host,dtv,num):
+    if num == 0 or num > self.max_ranges:
+      result = TRANSFER_ERROR_COMMAND
+      self.transfer_state = (result,0,0,0)
+    else:
+      (result,ranges) = self.recv_range_list(num)
+      if result == STATUS_OK:
+        result = self.transfer_mem_list(host,dtv,ranges)
+      else:
+        self.transfer_state = (result,0,0,0)
+    if result != STATUS_OK:
+      self.error_condition()
+
+  # ----- transfer commands -----
+
+  def exec_transfer_mode(self,b,w,d):
+    self.transfer_mode = b[0]
+
+  def exec_read_memory(self,b,w,d):
+    (host,dtv) = self.read_pointers()
+    self.generic_transfer(host,dtv,b,d)
+
+  def exec_write_memory(self,b,w,d):
+    (host,dtv) = self.write_pointers()
+    self.generic_transfer(host,dtv,b,d)
+
+  def exec_write_verify_memory(self,b,w,d):
+    (host,dtv) = self.write_pointers()
+    if dtv == 'write':
+      dtv = 'verify'
+    self.generic_transfer(host,dtv,b,d)
+
+  def exec_crc_memory(self,b,w,d):
+    (host,dtv) = self.read_pointers()
+    if host == 'tx':
+      host = 'crc'
+    self.generic_transfer(host,dtv,b,d)
+
+  def exec_read_memory_list(self,b,w,d):
+    (host,dtv) = self.read_pointers()
+    self.generic_list_transfer(host,dtv,b[0])
+
+  def exec_write_memory_list(self,b,w,d):
+    (host,dtv) = self.write_pointers()
+    self.generic_list_transfer(host,dtv,b[0])
+
+  def exec_peek_memory(self,b,w,d):
+    (rom,length,addr) = (b[0],b[1],d[0])
+    result = TRANSFER_ERROR_COMMAND
+    if length > 0 and length <= self.peek_max_size:
+      data = self.dtv_read(rom,addr,length)
+      self.link.send("".join(map(lambda x: "%02X" % ord(x),data)))
+      result = STATUS_OK
+    self.link.send("\r\n")
+    self.send_hex_byte(result)
+
+  def exec_poke_memory(self,b,w,d):
+    result = TRANSFER_ERROR_COMMAND
+    if len(b) > 1:
+      self.dtv_write(b[0],d[0],"".join(map(chr,b[1:])))
+      result = STATUS_OK
+    self.send_hex_byte(result)
+
+  def exec_transfer_result(self,b,w,d):
+    (result,setup_us,data_us,end_us) = self.transfer_state
+    self.send_hex_byte(result)
+    self.send_hex_dword(setup_us)
+    self.send_hex_dword(data_us)
+    self.send_hex_dword(end_us)
+
+  def exec_boot_memory(self,b,w,d):
+    (addr,length) = (w[0],w[1])
+    start = self.timer_us()
+    self.send_status(STATUS_OK)
+    status = STATUS_OK
+    chk = 0
+    if not self.alive:
+      status = self.dtv_wait_ack()
+    else:
+      data = self.link.read(length,self.read_timeout())
+      self.stats[0] += len(data)
+      self.dtv_write(0,addr,data)
+      for c in data:
+        chk += ord(c) + 1
+      if len(data) < length:
+        status = TRANSFER_ERROR_CLIENT_TIMEOUT
+    self.send_status(status)
+    if status == STATUS_OK:
+      self.send_status(chk)
+    self.transfer_state = (status,0,self.timer_us() - start,0)
+    if status != STATUS_OK:
+      self.error_condition()
+
+  # ----- dtvtrans commands -----
+
+  def exec_is_alive(self,b,w,d):
+    if self.alive:
+      self.send_hex_byte(STATUS_OK)
+    else:
+      time.sleep(w[0] / 100.0)
+      self.send_hex_byte(TRANSFER_ERROR_NOT_ALIVE)
+
+  def exec_command(self,b,w,d):
+    (cmd,out_size) = (b[0],b[1])
+    (status,output) = self.dtv_command(cmd,b[2:],out_size)
+    if status == STATUS_OK and out_size > 0:
+      if out_size == 0xff:
+        self.send_hex_byte(len(output))
+      self.link.send("".join(map(lambda x: "%02X" % x,output)) + "\r\n")
+    self.send_hex_byte(status)
+
+  def exec_sys_call(self,b,w,d):
+    start = time.time()
+    (status,output) = self.dtv_command(0x04,b,0)
+    duration = int((time.time() - start) * 1000)
+    self.send_hex_byte(status)
+    self.send_hex_word(duration)
+    if status == STATUS_OK:
+      (status,output) = self.dtv_command(0x05,[b[0]],4)
+      self.link.send("".join(map(lambda x: "%02X" % x,output)) + "\r\n")
+      self.send_hex_byte(status)
+
+  # ----- dtv2ser commands -----
+
+  def exec_reset_dtv(self,b,w,d):
+    mode = b[0]
+    self.alive = (mode & ~RESET_WAIT_READY) == RESET_ENTER_DTVTRANS
+    if mode & RESET_WAIT_READY:
+      # the knock is only held until dtvmon sampled it, then dtvtrans is
+      # probed for the rest of the reset delay.
+      # the boot time counts from the begin of the reset pulse
+      delay = self.param_words[PARAM_WORD_DTVLOW_RESET_DELAY]
+      knock = min(delay,self.reset_knock_hold)
+      if delay > self.reset_knock_hold + 10:
+        probe = delay - self.reset_knock_hold
+      else:
+        probe = 10
+      hold = (self.param_words[PARAM_WORD_DTVLOW_PREPARE_RESET_DELAY] * 2 + \
+              knock) / 1000.0
+      if self.alive:
+        boot = max(hold,self.boot_time)
+        time.sleep(boot)
+        self.send_hex_byte(STATUS_OK)
+        self.send_hex_word(int(boot * 1000))
+      else:
+        time.sleep(hold + probe / 1000.0)
+        self.send_hex_byte(TRANSFER_ERROR_NOT_ALIVE)
+        self.send_hex_word(int(hold * 1000) + probe)
+      return
+    delay = self.param_words[PARAM_WORD_DTVLOW_PREPARE_RESET_DELAY] + \
+            self.param_words[PARAM_WORD_DTVLOW_RESET_DELAY]
+    time.sleep(delay / 1000.0)
+    self.send_hex_byte(STATUS_OK)
+
+  def exec_version(self,b,w,d):
+    self.send_hex_word(self.version_major << 8 | self.version_minor)
+
+  def exec_stats(self,b,w,d):
+    self.send_hex_byte(self.stats_num)
+    for value in self.stats:
+      self.send_hex_dword(value)
+    if b[0] & 1:
+      self.stats = [0] * self.stats_num
+
+  def exec_stats_ack(self,b,w,d):
+    # acks of the emulated dtv have no latency
+    self.send_hex_byte(self.stats_ack_bins)
+    for i in xrange(self.stats_ack_bins):
+      self.send_hex_word(0)
+
+  def joy_duration(self,stream):
+    """Play a joy stream like joy_tick() of joycmd.c.
+    Returns duration in seconds or None if the stream is invalid"""
+    ticks = 0
+    pos = 0
+    last = JOY_COMMAND_OUT
+    loops = []
+    while pos < len(stream):
+      cmd = ord(stream[pos])
+      pos += 1
+      val = cmd & JOY_MASK
+      kind = cmd & JOY_COMMAND_MASK
+      if kind == JOY_COMMAND_REPEAT:
+        # replay last out or wait
+        kind = last & JOY_COMMAND_MASK
+        val = (last & JOY_MASK) * (cmd & JOY_MASK)
+      elif kind in (JOY_COMMAND_OUT,JOY_COMMAND_WAIT,JOY_COMMAND_WAIT_FINE,JOY_COMMAND_WAIT_LONG):
+        last = cmd
+      if kind == JOY_COMMAND_WAIT:
+        ticks += val * 100
+      elif kind == JOY_COMMAND_WAIT_FINE:
+        ticks += val
+      elif kind == JOY_COMMAND_WAIT_LONG:
+        ticks += val * 1000
+      elif kind == JOY_COMMAND_LOOP:
+        if len(loops) == self.joy_loop_depth:
+          return None
+        loops.append([pos,val])
+      elif kind == JOY_COMMAND_END_LOOP:
+        if len(loops) == 0:
+          return None
+        if loops[-1][1] > 0:
+          loops[-1][1] -= 1
+          pos = loops[-1][0]
+        else:
+          loops.pop()
+      elif kind == JOY_COMMAND_EXIT:
+        return ticks / 10000.0
+    return None
+
+  def exec_joy_stream(self,b,w,d):
+    start = time.time()
+    self.send_status(STATUS_OK)
+    # receive until the exit command
+    stream = ''
+    while True:
+      c = self.link.read(1,self.read_timeout())
+      if c == '':
+        break
+      stream += c
+      if ord(c) & JOY_COMMAND_MASK == JOY_COMMAND_EXIT:
+        break
+    duration = self.joy_duration(stream)
+    if duration == None:
+      self.send_status(1)
+      self.error_condition()
+      return
+    remaining = duration - (time.time() - start)
+    if remaining > 0:
+      time.sleep(remaining)
+    self.send_status(STATUS_OK)
+
+  def exec_joy_buffered_stream(self,b,w,d):
+    # playback from the device buffer has the same timing here
+    self.exec_joy_stream(b,w,d)
+
+  # ----- parameter commands -----
+
+  def exec_set_byte_param(self,b,w,d):
+    if b[0] < len(self.param_bytes):
+      self.param_bytes[b[0]] = b[1]
+    self.send_hex_byte(STATUS_OK)
+
+  def exec_get_byte_param(self,b,w,d):
+    value = 0
+    if b[0] < len(self.param_bytes):
+      value = self.param_bytes[b[0]]
+    self.send_hex_byte(value)
+
+  def exec_set_word_param(self,b,w,d):
+    if b[0] < len(self.param_words):
+      self.param_words[b[0]] = w[0]
+    self.send_hex_byte(STATUS_OK)
+
+  def exec_get_word_param(self,b,w,d):
+    value = 0
+    if b[0] < len(self.param_words):
+      value = self.param_words[b[0]]
+    self.send_hex_word(value)
+
+  def exec_param_cmd(self,b,w,d):
+    mode = b[0]
+    if mode == 0:
+      self.param_bytes = list(self.default_param_bytes)
+      self.param_words = list(self.default_param_words)
+    elif mode == 1:
+      self.param_bytes = list(self.eeprom[0])
+      self.param_words = list(self.eeprom[1])
+    else:
+      self.eeprom = (list(self.param_bytes),list(self.param_words))
+    self.send_hex_byte(STATUS_OK)
+
+  def exec_param_query(self,b,w,d):
+    self.send_hex_byte(len(self.param_bytes))
+    self.send_hex_byte(len(self.param_words))
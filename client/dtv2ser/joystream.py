@@ -28,6 +28,152 @@ from dtv2ser.status import *
 class JoyStream:
   """Create byte streams used for the joy stream command of dtv2ser"""
 
+  # max count of a loop or repeat command
+  loop_max   = 32
+  # max nesting of loop blocks on the device
+  loop_depth = 2
+  # max value of a wait command
+  wait_max   = 31
+
+  def wait_stream(self,delay):
+    """Encode a wait of delay * 10ms. Long waits use the long wait and
+       repeat commands.
+       Returns joystream"""
+    stream = ""
+    # long part in 100ms units
+    if delay > self.wait_max:
+      n = delay / 10
+      delay %= 10
+      while n > 0:
+        w = min(n,self.wait_max)
+        r = min(n / w,self.loop_max) - 1
+        stream += chr(JOY_COMMAND_WAIT_LONG | w)
+        if r > 0:
+          stream += chr(JOY_COMMAND_REPEAT | r)
+        n -= w * (r + 1)
+    if delay > 0:
+      stream += chr(JOY_COMMAND_WAIT | delay)
+    return stream
+
+  def loop_stream(self,body,count,depth=0):
+    """Encode a loop free body repeated count times with up to loop_depth
+       nested loop commands
+       Returns joystream"""
+    if count <= 1 or depth == self.loop_depth:
+      return body * count
+    stream = ""
+    # the largest block an inner nesting can encode
+    inner = self.loop_max ** (self.loop_depth - depth - 1)
+    while count > 0:
+      if count >= inner and inner > 1:
+        n = min(count / inner,self.loop_max)
+        block = self.loop_stream(body,inner,depth+1)
+        count -= n * inner
+      else:
+        n = count
+        block = body
+        count = 0
+      if n == 1:
+        stream += block
+      else:
+        stream += chr(JOY_COMMAND_LOOP | (n-1)) + block + chr(JOY_COMMAND_END_LOOP)
+    return stream
+
+  def stream_duration(self,stream):
+    """Estimate the playback time of a joy stream like the device plays it:
+       loops and repeats are expanded.
+       Returns time in s"""
+    # ticks of 100us and loop count of each open loop block
+    stack = [[0,0]]
+    # ticks of the last out or wait command (for repeat)
+    last = 0
+    for s in stream:
+      c = ord(s)
+      cmd = c & JOY_COMMAND_MASK
+      val = c & ~JOY_COMMAND_MASK
+      if cmd == JOY_COMMAND_EXIT:
+        break
+      elif cmd == JOY_COMMAND_REPEAT:
+        stack[-1][0] += last * val
+      elif cmd == JOY_COMMAND_LOOP:
+        stack.append([0,val])
+      elif cmd == JOY_COMMAND_END_LOOP:
+        if len(stack) > 1:
+          (ticks,count) = stack.pop()
+          stack[-1][0] += ticks * (count + 1)
+      else:
+        if cmd == JOY_COMMAND_WAIT:
+          last = val * 100
+        elif cmd == JOY_COMMAND_WAIT_FINE:
+          last = val
+        elif cmd == JOY_COMMAND_WAIT_LONG:
+          last = val * 1000
+        else:
+          last = 0
+        stack[-1][0] += last
+    # unterminated loops run once
+    ticks = 0
+    for level in stack:
+      ticks += level[0]
+    return ticks / 10000.0
+
+  def plain_stream(self,stream):
+    """Expand repeat, loop, fine and long wait commands into the out and
+       wait commands a firmware without the timer player understands.
+       Returns joystream"""
+    # flat list of out values and waits in ticks of 100us
+    stack = [[]]
+    counts = []
+    last = None
+    for s in stream:
+      c = ord(s)
+      cmd = c & JOY_COMMAND_MASK
+      val = c & ~JOY_COMMAND_MASK
+      if cmd == JOY_COMMAND_EXIT:
+        break
+      elif cmd == JOY_COMMAND_REPEAT:
+        if last != None:
+          stack[-1].extend([last] * val)
+      elif cmd == JOY_COMMAND_LOOP:
+        stack.append([])
+        counts.append(val)
+      elif cmd == JOY_COMMAND_END_LOOP:
+        if len(stack) > 1:
+          body = stack.pop()
+          stack[-1].extend(body * (counts.pop() + 1))
+      else:
+        if cmd == JOY_COMMAND_WAIT:
+          last = (True,val * 100)
+        elif cmd == JOY_COMMAND_WAIT_FINE:
+          last = (True,val)
+        elif cmd == JOY_COMMAND_WAIT_LONG:
+          last = (True,val * 1000)
+        else:
+          last = (False,val)
+        stack[-1].append(last)
+    # unterminated loops run once
+    items = []
+    for level in stack:
+      items.extend(level)
+
+    # merge waits and round them to 10ms. the rounding error is carried
+    # so the total play time stays the same
+    result = ""
+    ticks = 0
+    for (is_wait,val) in items + [(False,None)]:
+      if is_wait:
+        ticks += val
+        continue
+      n = (ticks + 50) / 100
+      ticks -= n * 100
+      while n > 0:
+        w = min(n,self.wait_max)
+        result += chr(JOY_COMMAND_WAIT | w)
+        n -= w
+      if val != None:
+        result += chr(JOY_COMMAND_OUT | val)
+    return result + chr(JOY_COMMAND_EXIT)
+
   def delta_move_to_stream(self,delta,delay):
     """Convert a delta move (dx,dy) of auto type to stream commands
        Returns joystream"""
@@ -37,28 +183,23 @@ class JoyStream:
     y = delta[1]
 
     # prepare some commands
-    d  = chr(delay | JOY_COMMAND_WAIT)
-    d2 = chr(delay*2 | JOY_COMMAND_WAIT)
-    dw = d + chr(JOY_FIRE) + d
+    d  = self.wait_stream(delay)
+    d2 = self.wait_stream(delay*2)
 
     # press fire
     stream = chr(JOY_FIRE) + d2
 
     # move delta y
     if y<0:
-      for step in xrange(abs(y)):
-        stream += chr(JOY_FIRE|JOY_UP) + dw
+      stream += self.loop_stream(chr(JOY_FIRE|JOY_UP) + d + chr(JOY_FIRE) + d,abs(y))
     elif y>0:
-      for step in xrange(y):
-        stream += chr(JOY_FIRE|JOY_DOWN) + dw
+      stream += self.loop_stream(chr(JOY_FIRE|JOY_DOWN) + d + chr(JOY_FIRE) + d,y)
 
     # move delta x
     if x<0:
-      for step in xrange(abs(x)):
-        stream += chr(JOY_FIRE|JOY_LEFT) + dw
+      stream += self.loop_stream(chr(JOY_FIRE|JOY_LEFT) + d + chr(JOY_FIRE) + d,abs(x))
     elif x>0:
-      for step in xrange(x):
-        stream += chr(JOY_FIRE|JOY_RIGHT) + dw
+      stream += self.loop_stream(chr(JOY_FIRE|JOY_RIGHT) + d + chr(JOY_FIRE) + d,x)
 
     # releas fire
     stream += chr(JOY_NONE) + d2
@@ -79,16 +220,11 @@ class JoyStream:
     duration *= 100
     num_wiggles = duration / delay
 
-    stream = ""
-    for i in xrange(num_wiggles):
-      m = i % 4
-      if m == 0:
-        stream += chr(JOY_LEFT)
-      elif m == 2:
-        stream += chr(JOY_RIGHT)
-      else:
-        stream += chr(JOY_NONE)
-      stream += chr(JOY_COMMAND_WAIT | delay)
+    # a full wiggle is left, none, right, none
+    d = self.wait_stream(delay)
+    steps = map(lambda x: chr(x) + d, (JOY_LEFT,JOY_NONE,JOY_RIGHT,JOY_NONE))
+    stream = self.loop_stream("".join(steps),num_wiggles / 4)
+    stream += "".join(steps[:num_wiggles % 4])
     stream += chr(JOY_COMMAND_EXIT)
     return stream
 
@@ -114,6 +250,16 @@ class JoyStream:
         result += "e"
       elif cmd == JOY_COMMAND_WAIT:
         result += "%d" % val
+      elif cmd == JOY_COMMAND_WAIT_FINE:
+        result += "%d/" % val
+      elif cmd == JOY_COMMAND_WAIT_LONG:
+        result += "%dL" % val
+      elif cmd == JOY_COMMAND_REPEAT:
+        result += "*%d" % val
+      elif cmd == JOY_COMMAND_LOOP:
+        result += "%dx(" % (val+1)
+      elif cmd == JOY_COMMAND_END_LOOP:
+        result += ")"
       elif cmd == JOY_COMMAND_OUT:
         current_fire = val & JOY_FIRE == JOY_FIRE
         val &= ~JOY_FIRE
@@ -154,14 +300,49 @@ class JoyStream:
     """Estimate the time for a stream
        Returns seconds"""
     duration = 0.0
-    for s in stream:
+    for s in self.expand_stream(stream):
       c = ord(s)
       cmd = c & JOY_COMMAND_MASK
       val = c & ~JOY_COMMAND_MASK
       if cmd == JOY_COMMAND_WAIT:
         duration += float(val) / 100
+      elif cmd == JOY_COMMAND_WAIT_FINE:
+        duration += float(val) / 10000
+      elif cmd == JOY_COMMAND_WAIT_LONG:
+        duration += float(val) / 10
     return duration
 
+  def expand_stream(self,stream):
+    """Unroll all loop and repeat commands of a stream
+       Returns joystream"""
+    result = ""
+    last = chr(JOY_COMMAND_OUT)
+    stack = []
+    pos = 0
+    while pos < len(stream):
+      c = ord(stream[pos])
+      cmd = c & JOY_COMMAND_MASK
+      val = c & ~JOY_COMMAND_MASK
+      pos += 1
+      if cmd == JOY_COMMAND_REPEAT:
+        result += last * val
+      elif cmd == JOY_COMMAND_LOOP:
+        stack.append([pos,val])
+      elif cmd == JOY_COMMAND_END_LOOP:
+        if len(stack) == 0:
+          break
+        if stack[-1][1] > 0:
+          stack[-1][1] -= 1
+          pos = stack[-1][0]
+        else:
+          stack.pop()
+      else:
+        result += stream[pos-1]
+        if cmd == JOY_COMMAND_EXIT:
+          break
+        last = stream[pos-1]
+    return result
+
   def estimate_stream_seq_duration(self,seq):
     """Estimate the time for a stream seq
        Returns seconds"""
@@ -189,7 +370,7 @@ class JoyStream:
     while pos < max_len:
 
       # delay command
-      d = chr(JOY_COMMAND_WAIT | delay)
+      d = self.wait_stream(delay)
       dn= d + chr(add_fire) + d
 
       # get next command
@@ -208,15 +389,15 @@ class JoyStream:
 
       # joystick control
       if c == 'f':
-        stream += (chr(JOY_FIRE  | add_fire) + dn) * repeat
+        stream += self.loop_stream(chr(JOY_FIRE  | add_fire) + dn,repeat)
       elif c == 'u':
-        stream += (chr(JOY_UP    | add_fire) + dn) * repeat
+        stream += self.loop_stream(chr(JOY_UP    | add_fire) + dn,repeat)
       elif c == 'd':
-        stream += (chr(JOY_DOWN  | add_fire) + dn) * repeat
+        stream += self.loop_stream(chr(JOY_DOWN  | add_fire) + dn,repeat)
       elif c == 'l':
-        stream += (chr(JOY_LEFT  | add_fire) + dn) * repeat
+        stream += self.loop_stream(chr(JOY_LEFT  | add_fire) + dn,repeat)
       elif c == 'r':
-        stream += (chr(JOY_RIGHT | add_fire) + dn) * repeat
+        stream += self.loop_stream(chr(JOY_RIGHT | add_fire) + dn,repeat)
 
       # wait a pulse delay
       elif c == '.':
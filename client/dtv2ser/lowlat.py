@@ -0,0 +1,173 @@
+#
+# lowlat.py - low latency tuning of USB serial adapters on Linux
+#
+# Written by
+#  Christian Vogelgsang <chris@vogelgsang.org>
+#
+# This file is part of dtv2ser.
+# See README for copyright notice.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+#  02111-1307  USA.
+#
+
+import os
+import sys
+import struct
+
+class LowLatency:
+  """Tune a ttyUSB/ttyACM adapter for short round trips and restore the
+     original settings afterwards.
+
+     FTDI style adapters buffer incoming bytes until their latency timer
+     expires (16 ms by default) which dominates every command round trip.
+     The timer is lowered via sysfs and the tty gets ASYNC_LOW_LATENCY."""
+
+  # linux ioctls and flags from <linux/serial.h>
+  TIOCGSERIAL       = 0x541e
+  TIOCSSERIAL       = 0x541f
+  ASYNC_LOW_LATENCY = 0x2000
+  # offset of 'flags' in struct serial_struct and a buffer large enough
+  serial_flags_offset = 16
+  serial_struct_size  = 128
+
+  # latency timer in ms
+  latency_timer = 1
+
+  def __init__(self,port,sysfs_root="/sys",verbose=False):
+    self.port       = port
+    self.sysfs_root = sysfs_root
+    self.verbose    = verbose
+    self.name       = os.path.basename(os.path.realpath(port))
+    # original values to restore or None if untouched
+    self.old_timer  = None
+    self.old_flags  = None
+
+  def is_usb_tty(self):
+    """Only ttyUSB and ttyACM devices on Linux are tuned"""
+    if not sys.platform.startswith('linux'):
+      return False
+    return self.name.startswith('ttyUSB') or self.name.startswith('ttyACM')
+
+  def timer_path(self):
+    """Return the sysfs path of the latency timer"""
+    return os.path.join(self.sysfs_root,"bus","usb-serial","devices",
+                        self.name,"latency_timer")
+
+  def log(self,msg):
+    if self.verbose:
+      print "  %s: %s" % (self.name,msg)
+
+  # ----- latency timer -----
+
+  def read_timer(self):
+    """Read latency timer. Returns value or None"""
+    try:
+      f = open(self.timer_path(),"r")
+      value = int(f.read().strip())
+      f.close()
+      return value
+    except (IOError,OSError,ValueError):
+      return None
+
+  def write_timer(self,value):
+    """Write latency timer. Returns True if ok"""
+    try:
+      f = open(self.timer_path(),"w")
+      f.write("%d\n" % value)
+      f.close()
+      return True
+    except (IOError,OSError):
+      return False
+
+  def tune_timer(self):
+    old = self.read_timer()
+    if old == None or old <= self.latency_timer:
+      return
+    if self.write_timer(self.latency_timer):
+      self.old_timer = old
+      self.log("latency timer %d ms -> %d ms" % (old,self.latency_timer))
+    else:
+      self.log("latency timer %d ms is not writable" % old)
+
+  def restore_timer(self):
+    if self.old_timer == None:
+      return
+    if self.write_timer(self.old_timer):
+      self.log("latency timer restored to %d ms" % self.old_timer)
+    self.old_timer = None
+
+  # ----- low latency flag -----
+
+  def get_flags(self,fd):
+    """Read flags of serial_struct. Returns (buf,flags) or (None,0)"""
+    try:
+      import fcntl
+      buf = fcntl.ioctl(fd,self.TIOCGSERIAL,"\0" * self.serial_struct_size)
+    except (ImportError,IOError,OSError):
+      return (None,0)
+    (flags,) = struct.unpack_from("i",buf,self.serial_flags_offset)
+    return (buf,flags)
+
+  def set_flags(self,fd,buf,flags):
+    """Write flags of serial_struct. Returns True if ok"""
+    try:
+      import fcntl
+      o = self.serial_flags_offset
+      buf = buf[:o] + struct.pack("i",flags) + buf[o+4:]
+      fcntl.ioctl(fd,self.TIOCSSERIAL,buf)
+      return True
+    except (ImportError,IOError,OSError):
+      return False
+
+  def tune_flags(self,fd):
+    (buf,flags) = self.get_flags(fd)
+    if buf == None:
+      self.log("no serial_struct support")
+      return
+    if flags & self.ASYNC_LOW_LATENCY:
+      return
+    if self.set_flags(fd,buf,flags | self.ASYNC_LOW_LATENCY):
+      self.old_flags = flags
+      self.log("ASYNC_LOW_LATENCY enabled")
+    else:
+      self.log("ASYNC_LOW_LATENCY could not be set")
+
+  def restore_flags(self,fd):
+    if self.old_flags == None:
+      return
+    (buf,flags) = self.get_flags(fd)
+    if buf != None:
+      flags = (flags & ~self.ASYNC_LOW_LATENCY) | \
+              (self.old_flags & self.ASYNC_LOW_LATENCY)
+      if self.set_flags(fd,buf,flags):
+        self.log("ASYNC_LOW_LATENCY disabled")
+    self.old_flags = None
+
+  # ----- API -----
+
+  def tune(self,fd):
+    """Apply low latency settings to the opened port fd (may be None)"""
+    if not self.is_usb_tty():
+      return
+    if fd != None:
+      self.tune_flags(fd)
+    self.tune_timer()
+
+  def restore(self,fd):
+    """Restore all settings changed by tune()"""
+    if fd != None:
+      self.restore_flags(fd)
+    self.restore_timer()
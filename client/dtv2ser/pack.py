@@ -0,0 +1,242 @@
+#
+# pack.py - packed memory transfers with the pack servlet
+#
+# Written by
+#  Christian Vogelgsang <chris@vogelgsang.org>
+#
+# This file is part of dtv2ser.
+# See README for copyright notice.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+#  02111-1307  USA.
+#
+
+from dtv2ser.status import *
+
+class Pack:
+  """Encode and decode the packed streams of pack_srv.prg"""
+
+  # pack_srv.prg:
+  servlet_start  = 0x9000
+  servlet_param  = 0x9200
+  servlet_buffer = 0x9210
+  servlet_end    = 0xa000
+
+  # jumptable
+  servlet_pack_rle  = 0x9000
+  servlet_unpack_lz = 0x9003
+
+  # pack_rle result (in acc)
+  servlet_pack_ok      = 0
+  servlet_pack_no_gain = 1
+
+  # memory range that can be packed without touching the servlet
+  pack_range_begin = 0x0200
+  pack_range_end   = 0x9000
+  # largest chunk packed in a single servlet call
+  pack_chunk_size  = 0x0d00
+  # smaller chunks are not worth the servlet call
+  pack_min_size    = 0x0100
+
+  # RLE stream format
+  rle_run_min = 3
+  rle_run_max = 130
+  rle_lit_max = 128
+
+  # LZ stream format
+  lz_match_min  = 3
+  lz_match_max  = 130
+  lz_match_gain = 4
+  lz_lit_max    = 128
+  lz_max_offset = 0xffff
+  lz_chain_depth = 32
+
+  def rle_encode(self,data):
+    """Encode data in the RLE format of the servlet
+    Returns packed"""
+    out = []
+    lit = []
+    size = len(data)
+    pos = 0
+    while pos < size:
+      c = data[pos]
+      run = 1
+      max_run = min(size - pos,self.rle_run_max)
+      while run < max_run and data[pos+run] == c:
+        run += 1
+      if run >= self.rle_run_min:
+        if len(lit) > 0:
+          out.append(chr(len(lit)-1) + "".join(lit))
+          lit = []
+        out.append(chr(0x80 + run - self.rle_run_min) + c)
+        pos += run
+      else:
+        lit.append(c)
+        if len(lit) == self.rle_lit_max:
+          out.append(chr(len(lit)-1) + "".join(lit))
+          lit = []
+        pos += 1
+    if len(lit) > 0:
+      out.append(chr(len(lit)-1) + "".join(lit))
+    return "".join(out)
+
+  def rle_decode(self,packed,length):
+    """Decode a RLE stream of the servlet
+    Returns (result,data)"""
+    out = []
+    total = 0
+    pos = 0
+    size = len(packed)
+    while pos < size and total < length:
+      c = ord(packed[pos])
+      pos += 1
+      if c & 0x80:
+        if pos >= size:
+          break
+        run = (c & 0x7f) + self.rle_run_min
+        out.append(packed[pos] * run)
+        pos += 1
+        total += run
+      else:
+        lit = c + 1
+        out.append(packed[pos:pos+lit])
+        pos += lit
+        total += lit
+    data = "".join(out)
+    if len(data) != length or pos != size:
+      return (CLIENT_ERROR_CORRUPT_SERIAL_DATA,data)
+    return (STATUS_OK,data)
+
+  def lz_encode(self,data,begin,end,window_begin=-1):
+    """Encode data[begin:end] in the LZ format of the servlet.
+    Matches may refer back to data[window_begin:] as that is already
+    written when the stream is unpacked.
+    Returns packed"""
+    if window_begin < 0:
+      window_begin = begin
+    out = []
+    lit = []
+    chains = {}
+
+    # index history
+    for i in xrange(window_begin,begin):
+      chains.setdefault(data[i:i+3],[]).append(i)
+
+    pos = begin
+    while pos < end:
+      best_len = 0
+      best_off = 0
+      if pos + self.lz_match_min <= end:
+        max_len = min(end - pos,self.lz_match_max)
+        cands = chains.get(data[pos:pos+3],[])
+        for cand in reversed(cands[-self.lz_chain_depth:]):
+          off = pos - cand
+          if off > self.lz_max_offset:
+            break
+          n = self.lz_match_min
+          while n < max_len and data[cand+n] == data[pos+n]:
+            n += 1
+          if n > best_len:
+            best_len = n
+            best_off = off
+            if n == max_len:
+              break
+
+      if best_len >= self.lz_match_gain:
+        if len(lit) > 0:
+          out.append(chr(len(lit)-1) + "".join(lit))
+          lit = []
+        out.append(chr(0x80 + best_len - self.lz_match_min) + \
+                   chr(best_off & 0xff) + chr(best_off >> 8))
+        for i in xrange(pos,pos+best_len):
+          chains.setdefault(data[i:i+3],[]).append(i)
+        pos += best_len
+      else:
+        lit.append(data[pos])
+        if len(lit) == self.lz_lit_max:
+          out.append(chr(len(lit)-1) + "".join(lit))
+          lit = []
+        chains.setdefault(data[pos:pos+3],[]).append(pos)
+        pos += 1
+
+    if len(lit) > 0:
+      out.append(chr(len(lit)-1) + "".join(lit))
+    return "".join(out)
+
+  def lz_decode(self,packed,history=""):
+    """Decode a LZ stream appended to already written history
+    Returns (result,data)"""
+    out = list(history)
+    pos = 0
+    size = len(packed)
+    while pos < size:
+      c = ord(packed[pos])
+      pos += 1
+      if c & 0x80:
+        if pos + 2 > size:
+          return (CLIENT_ERROR_CORRUPT_SERIAL_DATA,"")
+        n = (c & 0x7f) + self.lz_match_min
+        off = ord(packed[pos]) | (ord(packed[pos+1]) << 8)
+        pos += 2
+        if off == 0 or off > len(out):
+          return (CLIENT_ERROR_CORRUPT_SERIAL_DATA,"")
+        for i in xrange(n):
+          out.append(out[-off])
+      else:
+        n = c + 1
+        if pos + n > size:
+          return (CLIENT_ERROR_CORRUPT_SERIAL_DATA,"")
+        out += list(packed[pos:pos+n])
+        pos += n
+    return (STATUS_OK,"".join(out[len(history):]))
+
+  def checksum(self,data):
+    """Calc the unpack checksum of the servlet
+    Returns (sum1,sum2)"""
+    sum1 = 0
+    sum2 = 0
+    for a in data:
+      sum1 = (sum1 + ord(a)) & 0xff
+      sum2 = (sum2 + sum1) & 0xff
+    return (sum1,sum2)
+
+  def hits_servlet(self,rom,start,length):
+    """Check if a range overlaps the servlet area"""
+    return rom == 0 and start < self.servlet_end and \
+           start + length > self.servlet_start
+
+  def split_range(self,rom,start,length):
+    """Split a range into packable and raw parts
+    Returns list of (start,length,packable)"""
+    parts = []
+    end = start + length
+    pos = start
+    while pos < end:
+      if rom == 0 and self.pack_range_begin <= pos < self.pack_range_end:
+        next = min(end,self.pack_range_end,pos + self.pack_chunk_size)
+        parts.append((pos,next-pos,next-pos >= self.pack_min_size))
+      else:
+        if rom == 0 and pos < self.pack_range_begin:
+          next = min(end,self.pack_range_begin)
+        else:
+          next = end
+        parts.append((pos,next-pos,False))
+      pos = next
+    return parts
+
+  def param_data(self,start,length):
+    """Build the parameter block of the servlet"""
+    return chr(start & 0xff) + chr((start >> 8) & 0xff) + \
+           chr(length & 0xff) + chr((length >> 8) & 0xff)
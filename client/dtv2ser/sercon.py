@@ -26,10 +26,13 @@
 # requires PySerial from http://pyserial.sourceforge.net !
 
 import serial
+import select
 import time
 import sys
 
 from dtv2ser.status import *
+from dtv2ser.lowlat import LowLatency
+from dtv2ser.joystream import JoyStream
 
 class SerCon:
   """Encapsulates a low level serial connection to a dtv2ser server device."""
@@ -37,25 +40,46 @@ class SerCon:
   # time out to wait for server become ready
   ready_timeout = 5
 
-  def __init__(self, serial_port, serial_baud, serial_timeout=2):
+  # poll interval if the serial port has no file descriptor (e.g. Windows)
+  poll_interval = 0.005
+
+  # chunk size of flow controlled stream writes. a server error is
+  # detected at the latest after this many bytes
+  stream_chunk_size = 64
+
+  def __init__(self, serial_port, serial_baud, serial_timeout=2,
+               low_latency=True, sysfs_root="/sys", verbose=False):
     """Open a serial connection to the dtv2ser server."""
+    self.lowlat = None
     try:
       print "port {} baud {}".format(serial_port,serial_baud)
-      self.ser = serial.Serial(port=serial_port,
-                              baudrate=serial_baud,
-                              bytesize=serial.EIGHTBITS,
-                              parity=serial.PARITY_NONE,
-                              stopbits=serial.STOPBITS_ONE,
-                              timeout=serial_timeout,
-                              writeTimeout=serial_timeout,
-                              xonxoff=0,
-                              rtscts=1,
-                              dsrdtr=0)
+      # urls like socket://host:port reach e.g. the dtv2serem emulator
+      if "://" in serial_port:
+        open_port = serial.serial_for_url
+      else:
+        open_port = serial.Serial
+      self.ser = open_port(serial_port,
+                           baudrate=serial_baud,
+                           bytesize=serial.EIGHTBITS,
+                           parity=serial.PARITY_NONE,
+                           stopbits=serial.STOPBITS_ONE,
+                           timeout=serial_timeout,
+                           writeTimeout=serial_timeout,
+                           xonxoff=0,
+                           rtscts=1,
+                           dsrdtr=0)
       if self.ser.isOpen():
+        # file descriptor for select() waits
+        try:
+          self.fd = self.ser.fileno()
+        except:
+          self.fd = None
+        # reduce round trip time of USB adapters
+        if low_latency:
+          self.lowlat = LowLatency(serial_port,sysfs_root,verbose)
+          self.lowlat.tune(self.fd)
         self.ser.flushOutput()
-        while self.ser.in_waiting > 0:
-          self.ser.flushInput()
-          time.sleep(0.1)
+        self.drain_input(0.1)
         self.valid = True
       else:
         self.valid = False
@@ -64,8 +88,16 @@ class SerCon:
 
   def __del__(self):
     """Close connection to dtv2 server."""
+    self.close()
+
+  def close(self):
+    """Restore port settings and close connection to dtv2 server."""
     if self.valid and self.ser.isOpen():
+      if self.lowlat != None:
+        self.lowlat.restore(self.fd)
+        self.lowlat = None
       self.ser.close()
+    self.valid = False
 
   def is_connected(self):
     """Is client connected?
@@ -94,19 +126,77 @@ class SerCon:
       return CLIENT_ERROR_SERVER_TIMEOUT
     return STATUS_OK
 
-  def wait_for_data(self,timeout=0,sleep=0.1):
+  def wait_readable(self,timeout):
+    """Wait until data from the server is available or timeout seconds passed.
+    Uses select() on the serial port and polls only without a descriptor.
+    Returns True if data is available.
+    """
+    if self.ser.in_waiting > 0:
+      return True
+    deadline = time.time() + timeout
+    while True:
+      remaining = deadline - time.time()
+      if remaining <= 0:
+        return self.ser.in_waiting > 0
+      if self.fd != None:
+        try:
+          (r,w,x) = select.select([self.fd],[],[],remaining)
+        except select.error:
+          # interrupted: retry with remaining time
+          continue
+        if len(r) > 0:
+          return True
+      else:
+        time.sleep(min(remaining,self.poll_interval))
+        if self.ser.in_waiting > 0:
+          return True
+
+  def wait_for_data(self,timeout=0):
     """Wait for server to send us some data
     Returns result code.
     """
     if timeout == 0:
       timeout = self.ready_timeout
-    steps = int(timeout / sleep)
-    for t in xrange(steps):
-      if self.ser.in_waiting > 0:
-        return STATUS_OK
-      time.sleep(sleep)
+    if self.wait_readable(timeout):
+      return STATUS_OK
     return CLIENT_ERROR_SERVER_TIMEOUT
 
+  def drain_input(self,quiet):
+    """Discard all input until the server was quiet for the given time"""
+    while self.ser.in_waiting > 0:
+      self.ser.flushInput()
+      self.wait_readable(quiet)
+
+  def send_stream(self,data,callback=lambda x:True,blocking=False):
+    """Write a stream in chunks and let RTS/CTS (or USB NAKs) throttle
+    the writes to the speed the server consumes the data. Stops early
+    if the server already replied with a status.
+    Returns (result,bytes_sent)
+    """
+    result = STATUS_OK
+    pos = 0
+    length = len(data)
+    if blocking:
+      old_timeout = self.ser.write_timeout
+      self.ser.write_timeout = None
+    try:
+      while pos < length:
+        callback(pos)
+
+        # already replied? (with error status)
+        if self.ser.in_waiting > 0:
+          break
+
+        chunk = data[pos:pos+self.stream_chunk_size]
+        result = self.send_data(chunk)
+        if result != STATUS_OK:
+          break
+        pos += len(chunk)
+    finally:
+      if blocking:
+        self.ser.write_timeout = old_timeout
+    return (result,pos)
+
   # ----- block transfers -----
 
   def dump_cts(self,num):
@@ -150,6 +240,14 @@ class SerCon:
     Use optional callback to get feedback while transfer.
     Returns (result,duration,data).
     """
+    return self.receive_block_list([(start,length)],block_size,callback)
+
+  def receive_block_list(self,ranges,block_size,callback=lambda x:True):
+    """Receive the data of a list of (start,length) ranges in a single
+    transfer. Each range is split in blocks given by block_size.
+    Use optional callback to get feedback while transfer.
+    Returns (result,duration,data) with the data of all ranges joined.
+    """
     status = STATUS_OK
     pos = 0
     data = ''
@@ -160,9 +258,81 @@ class SerCon:
     # write start byte
     status = self.send_data(chr(0))
     if status != STATUS_OK:
-      return status
+      return (status,0,data)
 
     # transfer blocks
+    for (start,length) in ranges:
+      while length > 0:
+        callback(pos)
+
+        offset = start & 0x3fff
+        spare  = 0x4000 - offset
+        get_len = min(length,block_size,spare)
+
+        # receive block
+        status,raw = self.receive_data(get_len)
+        if status!=STATUS_OK:
+          break
+
+        # receive crc16
+        status,crc16raw = self.receive_data(2)
+        if status!=STATUS_OK:
+          break
+
+        # convert block length
+        try:
+          crc16  = ord(crc16raw[0]) * 256 + ord(crc16raw[1])
+        except:
+          status = CLIENT_ERROR_INVALID_HEX_NUMBER
+          break
+
+        # block end
+        status = self.check_block(raw,crc16)
+        if status!=STATUS_OK:
+          break
+
+        data += raw
+        pos += get_len
+        length -= get_len
+        start += get_len
+
+      if status!=STATUS_OK:
+        break
+
+    # write end byte
+    if status != STATUS_OK:
+      end_byte = 0x01
+    else:
+      end_byte = 0x00
+    self.send_data(chr(end_byte))
+
+    if end_byte == 0x01:
+      self.drain_input(0.5)
+
+    # end upload
+    end_time = time.time()
+
+    # all ok
+    return (status,end_time - start_time,data)
+
+  def receive_crc_list(self,start,length,block_size,callback=lambda x:True):
+    """Receive the CRC16 of each block of a range in blocks given by block_size.
+    Use optional callback to get feedback while transfer.
+    Returns (result,duration,crc_list) with crc_list of (start,length,crc16).
+    """
+    status = STATUS_OK
+    pos = 0
+    crc_list = []
+
+    # begin transfer
+    start_time = time.time()
+
+    # write start byte
+    status = self.send_data(chr(0))
+    if status != STATUS_OK:
+      return (status,0,crc_list)
+
+    # receive a crc16 for each block
     while length > 0:
       callback(pos)
 
@@ -170,29 +340,13 @@ class SerCon:
       spare  = 0x4000 - offset
       get_len = min(length,block_size,spare)
 
-      # receive block
-      status,raw = self.receive_data(get_len)
-      if status!=STATUS_OK:
-        break
-
-      # receive crc16
       status,crc16raw = self.receive_data(2)
       if status!=STATUS_OK:
         break
 
-      # convert block length
-      try:
-        crc16  = ord(crc16raw[0]) * 256 + ord(crc16raw[1])
-      except:
-        status = CLIENT_ERROR_INVALID_HEX_NUMBER
-        break
-
-      # block end
-      status = self.check_block(raw,crc16)
-      if status!=STATUS_OK:
-        break
+      crc16 = ord(crc16raw[0]) * 256 + ord(crc16raw[1])
+      crc_list.append((start,get_len,crc16))
 
-      data += raw
       pos += get_len
       length -= get_len
       start += get_len
@@ -205,23 +359,28 @@ class SerCon:
     self.send_data(chr(end_byte))
 
     if end_byte == 0x01:
-      while self.ser.in_waiting>0:
-          self.ser.flushInput()
-          time.sleep(0.5)
+      self.drain_input(0.5)
 
-    # end upload
+    # end transfer
     end_time = time.time()
 
-    # all ok
-    return (status,end_time - start_time,data)
+    return (status,end_time - start_time,crc_list)
 
   def send_block(self,start,data,block_size,callback=lambda x:True):
     """Send a large block of data in blocks given by block_size.
     Use optional callback to get feedback while transfer.
     Returns (result,duration).
     """
+    return self.send_block_list([(start,len(data))],data,block_size,callback)
+
+  def send_block_list(self,ranges,data,block_size,callback=lambda x:True):
+    """Send the data of a list of (start,length) ranges in a single
+    transfer. data contains the data of all ranges joined. Each range is
+    split in blocks given by block_size.
+    Use optional callback to get feedback while transfer.
+    Returns (result,duration).
+    """
     status = STATUS_OK
-    length = len(data)
     pos = 0
 
     # begin upload
@@ -235,34 +394,40 @@ class SerCon:
       return CLIENT_ERROR_CORRUPT_SERIAL_DATA,0
 
     # transfer blocks
-    while length > 0:
-      callback(pos)
-
-      offset = start & 0x3fff
-      spare  = 0x4000 - offset
-      put_len = min(length,block_size,spare)
-
-      # now send block
-      raw = data[pos:pos+put_len]
-      status = self.send_data(raw)
-      if status != STATUS_OK:
-        break
-
-      # calc crc16
-      crc = self.calc_crc16(raw)
-      crc_raw = chr((crc >> 8)&0xff) + chr(crc & 0xff)
-      status = self.send_data(crc_raw)
-      if status != STATUS_OK:
-        break;
-
-      # got an error byte?
-      if self.ser.in_waiting > 0:
+    aborted = False
+    for (start,length) in ranges:
+      while length > 0:
+        callback(pos)
+
+        offset = start & 0x3fff
+        spare  = 0x4000 - offset
+        put_len = min(length,block_size,spare)
+
+        # now send block
+        raw = data[pos:pos+put_len]
+        status = self.send_data(raw)
+        if status != STATUS_OK:
+          break
+
+        # calc crc16
+        crc = self.calc_crc16(raw)
+        crc_raw = chr((crc >> 8)&0xff) + chr(crc & 0xff)
+        status = self.send_data(crc_raw)
+        if status != STATUS_OK:
+          break;
+
+        # got an error byte?
+        if self.ser.in_waiting > 0:
+          aborted = True
+          break
+
+        pos += put_len
+        length -= put_len
+        start += put_len
+
+      if status != STATUS_OK or aborted:
         break
 
-      pos += put_len
-      length -= put_len
-      start += put_len
-
     # an error occured - abort
     if status != STATUS_OK:
       return status,0
@@ -272,15 +437,39 @@ class SerCon:
     if status != STATUS_OK:
       return status,0
 
-    # end byte ok?
+    # end byte ok? otherwise it contains the transfer status of dtv2ser
     if ord(end_byte[0]) != 0:
-      return TRANSFER_ERROR_VERIFY_MISMATCH,0
+      return ord(end_byte[0]) | TRANSFER_ERROR_MASK,0
 
     end_time = time.time()
 
     # all ok
     return (status,end_time - start_time)
 
+  def send_range_list(self,ranges):
+    """Send the descriptors of a list of (rom,start,length) ranges and
+    wait for the acknowledge of dtv2ser.
+    Returns result.
+    """
+    raw = ''
+    for (rom,start,length) in ranges:
+      raw += chr(rom)
+      raw += chr((start >> 16) & 0xff) + chr((start >> 8) & 0xff) + chr(start & 0xff)
+      raw += chr((length >> 16) & 0xff) + chr((length >> 8) & 0xff) + chr(length & 0xff)
+    crc = self.calc_crc16(raw)
+    raw += chr((crc >> 8) & 0xff) + chr(crc & 0xff)
+    status = self.send_data(raw)
+    if status != STATUS_OK:
+      return status
+
+    # get acknowledge
+    status,ack_byte = self.receive_data(1)
+    if status != STATUS_OK:
+      return status
+    if ord(ack_byte[0]) != 0:
+      return ord(ack_byte[0]) | TRANSFER_ERROR_MASK
+    return STATUS_OK
+
   # ---------- boot command -------------------------------------------------
 
   def send_boot(self,start,data,callback=lambda x:True):
@@ -299,23 +488,13 @@ class SerCon:
     if start_code != 0:
       return CLIENT_ERROR_CORRUPT_SERIAL_DATA,0
 
-    # write data
-    length = len(data)
-    chk = 0
-    for pos in xrange(length):
-      callback(pos)
+    # write data - the server throttles us with CTS
+    status,sent = self.send_stream(data,callback)
 
-      # already replied? (with error status)
-      if self.ser.in_waiting > 0:
-        break
-
-      # now send data
-      status = self.send_data(data[pos])
-      if status != STATUS_OK:
-        break
-
-      # calc check sum
-      chk += 1 + ord(data[pos])
+    # calc check sum
+    chk = sent
+    for c in data[:sent]:
+      chk += ord(c)
 
     # get status byte
     status,status_byte = self.receive_data(1)
@@ -352,8 +531,6 @@ class SerCon:
     # begin upload
     start_time = time.time()
 
-    expected_duration = 0.0
-
     # get start byte
     status,start_byte = self.receive_data(1)
     if status != STATUS_OK:
@@ -362,33 +539,26 @@ class SerCon:
     if start_code != 0:
       return CLIENT_ERROR_CORRUPT_SERIAL_DATA,0
 
+    # the stream ends with the first END command
     for pos in xrange(len(data)):
-      # call function to get next command
-      c = data[pos]
-      callback(pos)
-
-      # send a joy stream command
-      # ignore timeouts entirely
-      while True:
-        result = self.send_data(c)
-        if result == STATUS_OK:
-            break
-
-      # END command?
-      if ord(c) & JOY_COMMAND_MASK == JOY_COMMAND_EXIT:
+      c = ord(data[pos])
+      if c & JOY_COMMAND_MASK == JOY_COMMAND_EXIT:
+        data = data[:pos+1]
         break
 
-      if ord(c) & JOY_COMMAND_MASK == JOY_COMMAND_WAIT:
-          expected_duration += float(ord(c) & ~JOY_COMMAND_MASK)/100
+    # play time with all waits, loops and repeats expanded
+    expected_duration = JoyStream().stream_duration(data)
 
-      # has the server already sent a status byte?
-      if self.ser.in_waiting > 0:
-        break
+    # send the joy stream commands. waits in the stream may hold off
+    # the server longer than any write timeout so block until consumed
+    status,sent = self.send_stream(data,callback,blocking=True)
+    if status != STATUS_OK:
+      return status,0
 
     # give other end time to execute joystream
-    while ((time.time() - start_time) < expected_duration):
-        if (self.ser.in_waiting > 0):
-            break
+    remaining = expected_duration - (time.time() - start_time)
+    if remaining > 0:
+      self.wait_readable(remaining)
 
     # get status byte from server
     result,data = self.receive_data(1)
@@ -38,6 +38,7 @@ class State:
     self.uptodate = False
     self.state = 0
     self.verbose = verbose
+    self.alive_known = False
 
   def determine(self):
     """Determine state of dtvtrans if its not up to date
@@ -48,13 +49,14 @@ class State:
     self.state = 0
 
     # check presence first
-    if self.verbose:
-      print "\tstate: checking is alive"
-    result = self.dtvcmd.is_alive()
-    if result == TRANSFER_ERROR_NOT_ALIVE:
-      return STATUS_OK
-    if result != STATUS_OK:
-      return result
+    if not self.alive_known:
+      if self.verbose:
+        print "\tstate: checking is alive"
+      result = self.dtvcmd.is_alive()
+      if result == TRANSFER_ERROR_NOT_ALIVE:
+        return STATUS_OK
+      if result != STATUS_OK:
+        return result
     # ok, server is alive
     self.state |= self.SERVER_IS_ALIVE
 
@@ -84,6 +86,11 @@ class State:
   def invalidate(self):
     """Some external event changed the state and thus invalidate it"""
     self.uptodate = False
+    self.alive_known = False
+
+  def set_alive(self):
+    """The server was just seen alive: skip the is alive check"""
+    self.alive_known = True
 
   def get(self):
     """Check if the requested state is available.
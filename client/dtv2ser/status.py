@@ -164,6 +164,8 @@ def get_result_string(result):
 RESET_NORMAL          = 0x00
 RESET_ENTER_DTVTRANS  = 0x01
 RESET_BYPASS_DTVMON   = 0x02
+# flag: wait until dtvtrans is ready and return boot time
+RESET_WAIT_READY      = 0x80
 
 # ----- joystick -----
 
@@ -176,7 +178,12 @@ JOY_RIGHT             = 0x08
 JOY_NONE              = 0x00
 
 JOY_COMMAND_MASK      = 0xe0
+JOY_COMMAND_REPEAT    = 0xe0
+JOY_COMMAND_END_LOOP  = 0xc0
+JOY_COMMAND_LOOP      = 0xa0
 JOY_COMMAND_EXIT      = 0x80
+JOY_COMMAND_WAIT_LONG = 0x60
+JOY_COMMAND_WAIT_FINE = 0x40
 JOY_COMMAND_WAIT      = 0x20
 JOY_COMMAND_OUT       = 0x00
 
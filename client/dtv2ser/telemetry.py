@@ -0,0 +1,113 @@
+#
+# telemetry.py - decode the live telemetry stream of the second cdc port
+#
+# Written by
+#  Christian Vogelgsang <chris@vogelgsang.org>
+#
+# This file is part of dtv2ser.
+# See README for copyright notice.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+#  02111-1307  USA.
+#
+
+
+from dtv2ser.status import get_result_string
+from dtv2ser.command import Command
+
+class Telemetry:
+  """Decode the telemetry lines of the firmware (see server/telemetry.h)
+     and format them for a live tail. Time stamps are made relative to
+     the first line and counters of the periodic S lines are shown as
+     differences to the previous S line."""
+
+  def __init__(self):
+    self.first_us = None
+    self.last_us  = None
+    self.base_us  = 0
+    self.last_counters = None
+
+  def parse_line(self,line):
+    """Decode a telemetry line
+    Returns (type,time_us,values) or None for garbage"""
+    words = line.strip().split()
+    if len(words) < 2 or len(words[0]) != 1:
+      return None
+    try:
+      values = map(lambda x:int(x,16),words[1:])
+    except ValueError:
+      return None
+    return (words[0],self.time_stamp(values[0]),values[1:])
+
+  def time_stamp(self,us):
+    """Remove the 32 bit wrap around and return us since the first line"""
+    if self.last_us != None and us < self.last_us:
+      self.base_us += 1 << 32
+    self.last_us = us
+    t = self.base_us + us
+    if self.first_us == None:
+      self.first_us = t
+    return t - self.first_us
+
+  def rate(self,length,us):
+    """Return throughput in KiB/s"""
+    if us == 0:
+      return 0.0
+    return length * 1000000.0 / (us * 1024.0)
+
+  def format_block(self,v):
+    (bank,length,us,result) = v
+    return "block     bank %02x  %5d bytes  %8d us  %7.2f KiB/s  %s" % \
+      (bank,length,us,self.rate(length,us),get_result_string(result))
+
+  def format_transfer(self,v):
+    (result,length,setup_us,data_us,end_us) = v
+    return "transfer  %8d bytes  setup %d us  data %d us  end %d us  %7.2f KiB/s  %s" % \
+      (length,setup_us,data_us,end_us,self.rate(length,data_us),get_result_string(result))
+
+  def format_stats(self,v):
+    dropped = v[0]
+    counters = v[1:]
+    out = "stats     dropped %d" % dropped
+    # show only counters that changed since the last S line
+    if self.last_counters != None and len(counters) == len(self.last_counters):
+      names = Command.stats_names
+      for i in xrange(len(counters)):
+        delta = (counters[i] - self.last_counters[i]) & 0xffffffff
+        if delta != 0 and i < len(names):
+          out += "  %s +%d" % (names[i],delta)
+    self.last_counters = counters
+    return out
+
+  def format(self,line):
+    """Return a readable version of a telemetry line or None to skip it"""
+    entry = self.parse_line(line)
+    if entry == None:
+      return None
+    (kind,t,v) = entry
+    try:
+      if kind == 'B':
+        text = self.format_block(v)
+      elif kind == 'T':
+        text = self.format_transfer(v)
+      elif kind == 'E':
+        text = "ERROR condition"
+      elif kind == 'S':
+        text = self.format_stats(v)
+      else:
+        text = line.strip()
+    except ValueError:
+      return None
+    return "%12.6f  %s" % (t / 1000000.0,text)
@@ -0,0 +1,154 @@
+#
+# trace.py - decode the firmware event trace
+#
+# Written by
+#  Christian Vogelgsang <chris@vogelgsang.org>
+#
+# This file is part of dtv2ser.
+# See README for copyright notice.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+#  02111-1307  USA.
+#
+
+
+import json
+
+class Trace:
+  """Decode the event trace of the 'tr' command and convert it to the
+     Chrome trace event format (chrome://tracing or ui.perfetto.dev)."""
+
+  # events of trace.h
+  CMD_BEGIN   = 0x01
+  CMD_END     = 0x02
+  BLOCK_BEGIN = 0x03
+  BLOCK_END   = 0x04
+  NOACK       = 0x05
+  CRC         = 0x06
+  CTS         = 0x07
+  ERROR_BEGIN = 0x08
+  ERROR_END   = 0x09
+
+  event_names = {
+    CMD_BEGIN   : "cmd_begin",
+    CMD_END     : "cmd_end",
+    BLOCK_BEGIN : "block_begin",
+    BLOCK_END   : "block_end",
+    NOACK       : "noack",
+    CRC         : "crc",
+    CTS         : "cts",
+    ERROR_BEGIN : "error_begin",
+    ERROR_END   : "error_end"
+  }
+
+  # timeline rows
+  tid_cmd   = 1
+  tid_block = 2
+  tid_error = 3
+
+  def __init__(self,entries,lost=0):
+    """entries is a list of (us,event,arg) tuples, oldest first"""
+    self.entries = entries
+    self.lost    = lost
+
+  def parse_line(line):
+    """Decode a trace line 'uuuuuuuueeaa'
+    Returns (us,event,arg)"""
+    return (int(line[0:8],16),int(line[8:10],16),int(line[10:12],16))
+  parse_line = staticmethod(parse_line)
+
+  def timestamps(self):
+    """Return the time stamps relative to the first entry with the
+    32 bit us wrap around removed"""
+    result = []
+    base = 0
+    last = None
+    for (us,event,arg) in self.entries:
+      if last != None and us < last:
+        base += 1 << 32
+      last = us
+      result.append(base + us)
+    if len(result) > 0:
+      first = result[0]
+      result = map(lambda x:x - first,result)
+    return result
+
+  def event_name(self,event):
+    return self.event_names.get(event,"event_%02x" % event)
+
+  def dump(self):
+    """Return a text dump of the trace"""
+    lines = []
+    if self.lost > 0:
+      lines.append("%d older entries were lost" % self.lost)
+    for ((us,event,arg),t) in zip(self.entries,self.timestamps()):
+      if event == self.CMD_BEGIN or event == self.CMD_END:
+        a = "'%s'" % chr(arg)
+      else:
+        a = "%02x" % arg
+      lines.append("%12.3f ms  %-12s %s" % (t / 1000.0,self.event_name(event),a))
+    return "\n".join(lines)
+
+  def chrome_events(self):
+    """Convert to a list of Chrome trace events"""
+    events = []
+    def add(ph,name,tid,ts,args=None):
+      e = { "name" : name, "ph" : ph, "ts" : ts, "pid" : 1, "tid" : tid }
+      if ph == "i":
+        e["s"] = "t"
+      if args != None:
+        e["args"] = args
+      events.append(e)
+
+    for ((us,event,arg),ts) in zip(self.entries,self.timestamps()):
+      if event == self.CMD_BEGIN:
+        add("B","cmd '%s'" % chr(arg),self.tid_cmd,ts)
+      elif event == self.CMD_END:
+        add("E","cmd '%s'" % chr(arg),self.tid_cmd,ts)
+      elif event == self.BLOCK_BEGIN:
+        add("B","block",self.tid_block,ts,{"bank":arg})
+      elif event == self.BLOCK_END:
+        add("E","block",self.tid_block,ts,{"result":arg})
+      elif event == self.NOACK:
+        add("i","noack %d" % arg,self.tid_block,ts)
+      elif event == self.CRC:
+        if arg == 0:
+          name = "crc ok"
+        else:
+          name = "crc error"
+        add("i",name,self.tid_block,ts,{"result":arg})
+      elif event == self.CTS:
+        add("C","cts",self.tid_cmd,ts,{"cts":arg})
+      elif event == self.ERROR_BEGIN:
+        add("B","error cycle",self.tid_error,ts)
+      elif event == self.ERROR_END:
+        add("E","error cycle",self.tid_error,ts)
+      else:
+        add("i",self.event_name(event),self.tid_cmd,ts,{"arg":arg})
+
+    # name the rows
+    for (tid,name) in ((self.tid_cmd,"commands"),(self.tid_block,"dtv blocks"),
+                       (self.tid_error,"errors")):
+      events.append({ "name" : "thread_name", "ph" : "M", "pid" : 1, "tid" : tid,
+                      "args" : { "name" : name } })
+    events.append({ "name" : "process_name", "ph" : "M", "pid" : 1,
+                    "args" : { "name" : "dtv2ser" } })
+    return events
+
+  def to_chrome_json(self):
+    """Return the trace in Chrome trace JSON format"""
+    return json.dumps({ "traceEvents" : self.chrome_events(),
+                        "displayTimeUnit" : "ms",
+                        "otherData" : { "lost_entries" : self.lost } },indent=1)
@@ -29,6 +29,30 @@ from dtv2ser.status  import *
 from dtv2ser.cmdline import CmdLine
 from dtv2ser.sercon  import SerCon
 from dtv2ser.param   import Param
+from dtv2ser.joystream import JoyStream
+
+class ServerTime:
+  """Durations of the setup, data and teardown phase of server transfers
+     as reported by the 't' command in us."""
+
+  def __init__(self,setup_us=0,data_us=0,end_us=0):
+    self.setup_us = setup_us
+    self.data_us  = data_us
+    self.end_us   = end_us
+
+  def add(self,other):
+    """Accumulate the phases of another transfer"""
+    self.setup_us += other.setup_us
+    self.data_us  += other.data_us
+    self.end_us   += other.end_us
+
+  def total(self):
+    """Return total duration in seconds"""
+    return (self.setup_us + self.data_us + self.end_us) / 1000000.0
+
+  def __str__(self):
+    return "setup=%.3f data=%.3f end=%.3f (ms)" % \
+      (self.setup_us / 1000.0,self.data_us / 1000.0,self.end_us / 1000.0)
 
 class Transfer:
   """Transfer command handling tools."""
@@ -39,6 +63,9 @@ class Transfer:
   # how many retries to get the transfer result after a transfer operation
   get_result_retries = 20
 
+  # how long the server must be quiet before retrying to get the result
+  get_result_quiet_time = 0.1
+
   def __init__(self,con):
     """Create a new transfer object."""
     # get cmdline
@@ -49,6 +76,10 @@ class Transfer:
     self.server_rx_rate = 0
     self.client_tx_rate = 0
     self.client_rx_rate = 0
+    # server phase durations summed up since begin_*_rates()
+    self.server_time = ServerTime()
+    # has the firmware the buffered joy stream player? (None=not probed)
+    self.joy_player = None
 
   # ---------- block size ---------------------------------------------------
 
@@ -92,29 +123,50 @@ class Transfer:
 
   def get_transfer_result(self):
     """Issue a 't' command to get the result
-    Returns result code and transfer time
+    Returns result code and ServerTime
     """
     result = self.cmdline.do_command("t")
     if result != STATUS_OK:
-      return (result,0)
+      return (result,None)
 
     # get transfer result
     (result,transfer_result) = self.cmdline.get_byte()
     if result != STATUS_OK:
-      return (result,0)
-    elif transfer_result != STATUS_OK:
-      return (transfer_result | TRANSFER_ERROR_MASK,0)
+      return (result,None)
 
-    # get transfer time
-    (result,transfer_time) = self.cmdline.get_word()
+    # get durations of setup, data and teardown phase in us. a firmware
+    # without USE_HIRES_TIMER only sends the data phase as a word in 10ms
+    (result,data) = self.con.receive_data(6)
     if result != STATUS_OK:
-      return (result,transfer_time)
+      return (result,None)
+    if data[4:6] == "\r\n":
+      try:
+        server_time = ServerTime(data_us=int(data[0:4],16) * 10000)
+      except ValueError:
+        return (CLIENT_ERROR_INVALID_HEX_NUMBER,None)
     else:
-      return (STATUS_OK,transfer_time)
+      (result,rest) = self.con.receive_data(4)
+      if result != STATUS_OK:
+        return (result,None)
+      try:
+        phases = [int(data[0:6] + rest[0:2],16)]
+      except ValueError:
+        return (CLIENT_ERROR_INVALID_HEX_NUMBER,None)
+      for i in xrange(2):
+        (result,us) = self.cmdline.get_dword()
+        if result != STATUS_OK:
+          return (result,None)
+        phases.append(us)
+      server_time = ServerTime(*phases)
+
+    if transfer_result != STATUS_OK:
+      return (transfer_result | TRANSFER_ERROR_MASK,server_time)
+    self.server_time.add(server_time)
+    return (STATUS_OK,server_time)
 
   def wait_for_transfer_result(self):
     """Wait until the transfer result is available or a time out occurs
-    Returns result code and transfer time
+    Returns result code and ServerTime
     """
 
     # wait a bit for the result
@@ -125,12 +177,12 @@ class Transfer:
         return (STATUS_OK,transfer_time)
       # a transfer error occured -> report it!
       if result & TRANSFER_ERROR_MASK == TRANSFER_ERROR_MASK:
-        return (result,time)
-      # any other error: retry
-      time.sleep(0.1)
+        return (result,transfer_time)
+      # any other error: drop garbage until the server is quiet and retry
+      self.con.drain_input(self.get_result_quiet_time)
 
     # client timed out
-    return (CLIENT_ERROR_SERVER_TIMEOUT,0)
+    return (CLIENT_ERROR_SERVER_TIMEOUT,None)
 
   # ---------- transfer tools -----------------------------------------------
 
@@ -150,20 +202,22 @@ class Transfer:
     return crc & 0xffff
 
   def update_server_tx_rate(self,length,server_time):
-    """Get transfer time from server and calculate the tx rate.
+    """Calculate the tx rate from the ServerTime of a transfer.
     Return result.
     """
-    if server_time > 0:
-      self.server_tx_rate = length * 100.0 / (server_time * 1024.0)
+    total = server_time.total()
+    if total > 0:
+      self.server_tx_rate = length / (total * 1024.0)
     else:
       self.server_tx_rate = 0
 
   def update_server_rx_rate(self,length,server_time):
-    """Get transfer time from server and calc transfer rate
+    """Calculate the rx rate from the ServerTime of a transfer.
     Return result.
     """
-    if server_time > 0:
-      self.server_rx_rate = length * 100.0 / (server_time * 1024.0)
+    total = server_time.total()
+    if total > 0:
+      self.server_rx_rate = length / (total * 1024.0)
     else:
       self.server_rx_rate = 0
 
@@ -280,6 +334,121 @@ class Transfer:
 
     return (STATUS_OK,data)
 
+  def do_receive_list_command(self,ranges,callback=lambda x:True,block_size=0x400):
+    """Transmit a 'lr' command for a list of (rom,start,length) ranges and
+    download the data of all ranges in a single transfer.
+    Return (result,data)
+    """
+    result = self.set_transfer_mode(TRANSFER_MODE_NORMAL)
+    if result != STATUS_OK:
+      return (result,'')
+
+    # ensure block size
+    result = self.ensure_block_size(block_size)
+    if result != STATUS_OK:
+      return (result,'')
+
+    # send command and range descriptors
+    result = self.cmdline.do_command("lr%02x" % len(ranges))
+    if result != STATUS_OK:
+      return (result,'')
+    result = self.con.send_range_list(ranges)
+    if result != STATUS_OK:
+      return (result,'')
+
+    # download data
+    block_ranges = map(lambda r: (r[1],r[2]),ranges)
+    (result,duration,data) = self.con.receive_block_list(block_ranges,block_size,callback=callback)
+    if result != STATUS_OK:
+      return (result,data)
+
+    # check transfer result
+    result,server_time = self.wait_for_transfer_result()
+    if result != STATUS_OK:
+      return (result,data)
+
+    # update rx rate
+    length = len(data)
+    self.update_client_rx_rate(length,duration)
+    self.update_server_rx_rate(length,server_time)
+
+    return (STATUS_OK,data)
+
+  def do_send_list_command(self,ranges,data,callback=lambda x:True,block_size=0x400):
+    """Transmit a 'lw' command for a list of (rom,start,length) ranges and
+    upload the joined data of all ranges in a single transfer.
+    Return result.
+    """
+    result = self.set_transfer_mode(TRANSFER_MODE_NORMAL)
+    if result != STATUS_OK:
+      return result
+
+    # ensure block size
+    result = self.ensure_block_size(block_size)
+    if result != STATUS_OK:
+      return result
+
+    # send command and range descriptors
+    result = self.cmdline.do_command("lw%02x" % len(ranges))
+    if result != STATUS_OK:
+      return result
+    result = self.con.send_range_list(ranges)
+    if result != STATUS_OK:
+      return result
+
+    # upload data
+    block_ranges = map(lambda r: (r[1],r[2]),ranges)
+    (result,duration) = self.con.send_block_list(block_ranges,data,block_size,callback=callback)
+    if result != STATUS_OK:
+      return result
+
+    # check transfer result
+    result,server_time = self.wait_for_transfer_result()
+    if result != STATUS_OK:
+      return result
+
+    # update tx rate
+    length = len(data)
+    self.update_client_tx_rate(length,duration)
+    self.update_server_tx_rate(length,server_time)
+
+    return STATUS_OK
+
+  def do_crc_command(self,cmd,start,length,callback=lambda x:True,block_size=0x400):
+    """Transmit a crc list command and download the block crcs.
+    Return (result,crc_list)
+    """
+    # crc lists are always read in normal mode
+    result = self.set_transfer_mode(TRANSFER_MODE_NORMAL)
+    if result != STATUS_OK:
+      return (result,[])
+
+    # ensure block size
+    result = self.ensure_block_size(block_size)
+    if result != STATUS_OK:
+      return (result,[])
+
+    # send command
+    result = self.cmdline.do_command(cmd)
+    if result != STATUS_OK:
+      return (result,[])
+
+    # download crcs
+    (result,duration,crc_list) = self.con.receive_crc_list(start,length,block_size,callback=callback)
+    if result != STATUS_OK:
+      return (result,crc_list)
+
+    # check transfer result
+    result,server_time = self.wait_for_transfer_result()
+    if result != STATUS_OK:
+      return (result,crc_list)
+
+    # update rx rate: effective rate of the covered range
+    self.update_client_rx_rate(length,duration)
+    self.update_server_rx_rate(length,server_time)
+
+    return (STATUS_OK,crc_list)
+
   # ---------- diagnose commands --------------------------------------------
 
   def set_diagnose_pattern(self,pattern):
@@ -375,33 +544,68 @@ class Transfer:
   def begin_rx_rates(self):
     """Begin a rx operation"""
     self.rx_begin_time = time.time()
+    self.server_time = ServerTime()
 
   def begin_tx_rates(self):
     """Begin a tx operation"""
     self.tx_begin_time = time.time()
+    self.server_time = ServerTime()
 
   def get_rx_rates(self,length):
-    """End rx operation and return client and server rx rates."""
+    """End rx operation and return client and server rx rates
+    and the summed up server phase durations."""
     t = time.time() - self.rx_begin_time
-    return (self.client_rx_rate,self.server_rx_rate,t,length)
+    return (self.client_rx_rate,self.server_rx_rate,t,length,self.server_time)
 
   def get_tx_rates(self,length):
-    """End tx operation and return client and server tx rates."""
+    """End tx operation and return client and server tx rates
+    and the summed up server phase durations."""
     t = time.time() - self.tx_begin_time
-    return (self.client_tx_rate,self.server_tx_rate,t,length)
+    return (self.client_tx_rate,self.server_tx_rate,t,length,self.server_time)
 
   # ---------- joy stream ---------------------------------------------------
 
-  def do_joy_stream(self,stream,callback=lambda x:True):
-    """Send a joy stream given in string stream
+  def has_joy_player(self):
+    """Probe once with an empty buffered stream if the firmware has the
+       timer driven joy stream player (built with USE_JOYBUF).
+       Returns status,has_player"""
+    if self.joy_player == None:
+      result = self.cmdline.do_command("jb")
+      if result & CMDLINE_ERROR_MASK:
+        # 'jb' is unknown or parsed as 'j' with an argument
+        self.joy_player = False
+      elif result != STATUS_OK:
+        return (result,False)
+      else:
+        result,duration = self.con.send_joy_stream(chr(JOY_COMMAND_EXIT))
+        if result != STATUS_OK:
+          return (result,False)
+        self.joy_player = True
+    return (STATUS_OK,self.joy_player)
+
+  def do_joy_stream(self,stream,callback=lambda x:True,buffered=False):
+    """Send a joy stream given in string stream. A buffered stream is
+       stored on the device and played back by its timer. Without the timer
+       player the stream is expanded to out and wait commands and played
+       unbuffered.
        Returns status,duration"""
-    result = self.cmdline.do_command("j")
+    result,has_player = self.has_joy_player()
+    if result != STATUS_OK:
+      return (result,0)
+    if not has_player:
+      stream = JoyStream().plain_stream(stream)
+      buffered = False
+
+    if buffered:
+      result = self.cmdline.do_command("jb")
+    else:
+      result = self.cmdline.do_command("j")
     if result != STATUS_OK:
       return (result,0)
 
     return self.con.send_joy_stream(stream,callback)
 
-  def do_joy_stream_seq(self,stream_seq,callback=lambda x:True):
+  def do_joy_stream_seq(self,stream_seq,callback=lambda x:True,buffered=False):
     """Send a sequence of joy streams
        Returns status."""
     total_duration = 0
@@ -410,10 +614,7 @@ class Transfer:
 
       # send a joy stream
       if cmd == JoyStream_Commands:
-        result = self.cmdline.do_command("j")
-        if result != STATUS_OK:
-          return result,0
-        result,duration = self.con.send_joy_stream(js[1],callback)
+        result,duration = self.do_joy_stream(js[1],callback,buffered)
         if result != STATUS_OK:
           return result,0
         total_duration += duration
@@ -33,6 +33,7 @@ from dtv2ser.state import State
 from dtv2ser.status import *
 from dtv2sertool.iotools import IOTools
 from dtv2sertool.helper import Helper
+from dtv2sertool.servlet import ServletManager
 
 class AppError:
   pass
@@ -43,8 +44,12 @@ class App:
   serial_port = ''
   serial_speed = 230400
   serial_timeout = 5
+  low_latency = True
+  sysfs_root = '/sys'
   verbose = False
   block_size = 0x400
+  packed = False
+  joy_buffered = False
   # state handling
   ignore_state = False
   force_old = False
@@ -57,6 +62,8 @@ class App:
       self.serial_speed = int(os.environ['DTV2SER_SPEED'])
     if os.environ.has_key('DTV2SER_TIMEOUT'):
       self.serial_timeout = int(os.environ['DTV2SER_TIMEOUT'])
+    if os.environ.has_key('DTV2SER_SYSFS'):
+      self.sysfs_root = os.environ['DTV2SER_SYSFS']
 
     # init runtime objects
     self.sercon = None
@@ -64,6 +71,7 @@ class App:
     self.state  = None
     self.iotools = IOTools()
     self.helper  = None
+    self.servlets = None
 
   def detect_serial_port(self):
     '''detect serial port if none is set'''
@@ -123,7 +131,9 @@ class App:
       print "  serial port=%s speed=%d timeout=%d" % (self.serial_port,self.serial_speed,self.serial_timeout)
 
     # setup serial
-    self.sercon = dtv2ser.sercon.SerCon(self.serial_port,self.serial_speed,serial_timeout=self.serial_timeout)
+    self.sercon = dtv2ser.sercon.SerCon(self.serial_port,self.serial_speed,serial_timeout=self.serial_timeout,
+                                        low_latency=self.low_latency,sysfs_root=self.sysfs_root,
+                                        verbose=self.verbose)
     if not self.sercon.is_connected():
       print "ERROR: opening serial port '%s'!" % self.serial_port
       return False
@@ -137,16 +147,35 @@ class App:
     # setup helpder
     self.helper = Helper(self.dtvcmd,self.iotools,self.verbose,self.block_size)
 
+    # setup servlet manager
+    self.servlets = ServletManager(self.dtvcmd,self.helper,self.verbose)
+
     # propagate verboseness to iotools
     self.iotools.verbose = self.verbose
     self.state.verbose = self.verbose
 
+    # joy stream playback mode
+    self.dtvcmd.joy_buffered = self.joy_buffered
+
+    # enable packed transfers
+    if self.packed:
+      data = self.helper.read_servlet("pack_srv.prg",self.dtvcmd.pack.servlet_start,self.verbose)
+      if data == None:
+        print "WARNING: no pack servlet found. using raw transfers!"
+      else:
+        self.dtvcmd.set_pack_servlet(data)
+
     # check device
     if not self.check_device():
       return False
 
     return True
 
+  def close(self):
+    '''release serial port and restore its settings'''
+    if self.sercon != None:
+      self.sercon.close()
+
   # ---------- state checks -------------------------------------------------
 
   def is_server_alive(self):
@@ -221,7 +250,10 @@ global_options = [
   ("v",None,"be more verbose"),
   ("b","<block_size>","set block size for transfers (default: 0x400)"),
   ("i",None,"ignore state of dtvtrans server before executing commands"),
-  ("f",None,"force old pre 1.0 dtvtrans protocol")
+  ("f",None,"force old pre 1.0 dtvtrans protocol"),
+  ("z",None,"pack RAM transfers with servlet pack_srv.prg"),
+  ("n",None,"do not tune USB serial adapters for low latency"),
+  ("j",None,"buffer joy streams on the device and play them\nback with its timer")
 ]
 
 def set_global_option(key,value):
@@ -244,5 +276,11 @@ def set_global_option(key,value):
     app.ignore_state = True
   elif key == '-f':
     app.force_old = True
+  elif key == '-z':
+    app.packed = True
+  elif key == '-n':
+    app.low_latency = False
+  elif key == '-j':
+    app.joy_buffered = True
 
 
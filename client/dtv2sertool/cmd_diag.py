@@ -23,9 +23,11 @@
 #  02111-1307  USA.
 #
 
+import sys
 import random
 
 from dtv2ser.status  import *
+from dtv2ser.bench   import Bench
 from dtv2sertool.cmd import Cmd
 from dtv2sertool.app import app
 
@@ -58,6 +60,23 @@ def diag_parse_range_pattern(args):
     return None,None
   return r,pattern
 
+def diag_parse_list(text):
+  values = []
+  for t in text.split(","):
+    v,valid = app.iotools.parse_number(t)
+    if not valid:
+      return None
+    values.append(v)
+  return values
+
+def diag_parse_names(text,valid_names):
+  names = text.split(",")
+  for n in names:
+    if n not in valid_names:
+      print "ERROR: invalid name '%s'. use %s" % (n,",".join(valid_names))
+      return None
+  return names
+
 # ----- Commands -----
 
 def diag_read_only_client(cmd,args,opts):
@@ -182,12 +201,126 @@ def diag_testsuite(cmd,args,opts):
   print "  * ALL TESTS PASSED OK! *"
   return True
 
+def diag_bench(cmd,args,opts):
+  if not app.require_server_alive():
+    return False
+
+  block_sizes = [0x100,0x200,0x400,0x800]
+  modes       = list(Bench.modes)
+  directions  = list(Bench.directions)
+  reps        = 3
+  out_file    = None
+  base_file   = None
+  tolerance   = 10.0
+  for o,a in opts:
+    if o == '-b':
+      block_sizes = diag_parse_list(a)
+      if block_sizes == None:
+        return False
+    elif o == '-m':
+      modes = diag_parse_names(a,Bench.modes)
+      if modes == None:
+        return False
+    elif o == '-d':
+      directions = diag_parse_names(a,Bench.directions)
+      if directions == None:
+        return False
+    elif o == '-n':
+      reps,valid = app.iotools.parse_number(a)
+      if not valid or reps < 1:
+        return False
+    elif o == '-o':
+      out_file = a
+    elif o == '-c':
+      base_file = a
+    elif o == '-t':
+      try:
+        tolerance = float(a)
+      except ValueError:
+        print "ERROR: invalid tolerance '%s'" % a
+        return False
+
+  if len(args) == 1:
+    (rom,start,length,valid) = app.iotools.parse_range(args[0])
+    if not valid:
+      return False
+  else:
+    (rom,start,length) = (0,0x20000,0x10000)
+
+  # read baseline first to fail early
+  baseline = None
+  if base_file != None:
+    try:
+      f = open(base_file,"r")
+      baseline = Bench.load_baseline(f.read())
+      f.close()
+    except (IOError,ValueError,KeyError),e:
+      print "ERROR reading baseline '%s': %s" % (base_file,e)
+      return False
+
+  num = len(modes) * len(directions) * len(block_sizes)
+  print "  * benchmark: %d cells x %d reps of 0x%06x bytes" % (num,reps,length)
+  bench = Bench(app.dtvcmd,rom,start,length)
+  def progress(cell,rep,result):
+    print "  %-22s %d/%d\r" % (cell.key(),rep+1,reps),
+    sys.stdout.flush()
+    if result != STATUS_OK:
+      print
+      print "  %-22s %s" % (cell.key(),get_result_string(result))
+    return True
+  result = bench.run(modes,directions,block_sizes,reps,progress)
+  print
+
+  # table
+  print "  %-22s %10s %10s %9s %9s %9s %9s %9s" % \
+    ("mode/dir/block","client/s","server/s","p50 ms","p90 ms","setup us","data us","end us")
+  for s in bench.summaries():
+    key = "%s/%s/0x%04x" % (s["mode"],s["direction"],s["block_size"])
+    print "  %-22s %8.2fKi %8.2fKi %9.2f %9.2f %9d %9d %9d" % \
+      (key,s["client_bps"] / 1024.0,s["server_bps"] / 1024.0,
+       s["lat_p50_ms"],s["lat_p90_ms"],s["setup_us"],s["data_us"],s["end_us"])
+
+  # write results
+  if out_file != None:
+    if out_file.endswith(".json"):
+      text = bench.to_json()
+    else:
+      text = bench.to_csv()
+    try:
+      f = open(out_file,"w")
+      f.write(text)
+      f.close()
+    except IOError,e:
+      print "ERROR writing '%s': %s" % (out_file,e)
+      return False
+    print "  wrote results to '%s'" % out_file
+
+  # compare with baseline
+  ok = result == STATUS_OK
+  if baseline != None:
+    regressions = 0
+    for (key,field,b,n,change,bad) in bench.compare(baseline,tolerance):
+      if bad:
+        regressions += 1
+        mark = "REGRESSION"
+      else:
+        mark = ""
+      print "  %-22s %-11s %12s -> %12s %+7.1f%% %s" % (key,field,b,n,change,mark)
+    if regressions > 0:
+      print "  * %d regressions beyond %.1f%% against '%s'" % (regressions,tolerance,base_file)
+      ok = False
+    else:
+      print "  * no regressions against '%s'" % base_file
+  return ok
+
 def diag_sys(cmd,args,opts):
   if not app.require_server_alive():
     return False
 
   # loading diagnose servlet
-  if not app.helper.load_servlet("diag_srv.prg",0x1000,True):
+  result = app.servlets.ensure_resident("diag")
+  app.iotools.print_result(result)
+  if result != STATUS_OK:
     return False
 
   retries = 25
@@ -262,6 +395,18 @@ def init(cmdSet):
   opts=(1,2,'<range> [<pattern>]'),
   func=diag_write_only_dtv))
 
+  diagCmd.add_sub_command(Cmd(["bench"],
+  help="throughput benchmark of all transfer modes\nnormal, serial (dtv2ser only) and dtv (no client)",
+  opts=(0,1,"[<range>]"),
+  args=[('b','<sizes>','block sizes (default: 0x100,0x200,0x400,0x800)'),
+        ('m','<modes>','modes (default: normal,serial,dtv)'),
+        ('d','<dirs>','directions (default: read,write)'),
+        ('n','<reps>','repetitions per cell (default: 3)'),
+        ('o','<file>','write results as CSV or JSON (*.json)\nJSON files can be used as baseline'),
+        ('c','<file>','compare with a JSON baseline'),
+        ('t','<percent>','regression tolerance (default: 10)')],
+  func=diag_bench))
+
   # sys diagnode
   diagCmd.add_sub_command(Cmd(["sys"],
   help="test the sys command",
@@ -92,10 +92,13 @@ def reset(cmd,args,opts):
       mode = INIT_MINIMAL_KERNAL
 
   print "  resetting dtv...",("normal","enter dtvtrans","bypass dtvmon")[reset_mode]
-  result = app.dtvcmd.dtv_reset(reset_mode)
+  wait_ready = reset_mode == RESET_ENTER_DTVTRANS
+  result = app.dtvcmd.dtv_reset(reset_mode,wait_ready=wait_ready)
   app.iotools.print_result(result)
   if result != STATUS_OK:
     return False
+  if wait_ready:
+    print "    boot:   %s" % app.iotools.time_string(app.dtvcmd.boot_time)
 
   if init and app.has_dtvtrans_10():
     print "  initializing",init_mode_text[init_mode]
@@ -109,6 +109,7 @@ def joy_type(cmd,args,opts):
   start_key   = ''
   verbose     = False
   test_mode   = False
+  greedy      = False
   for o,a in opts:
     if o == '-i':
       is_string = True
@@ -124,6 +125,8 @@ def joy_type(cmd,args,opts):
       verbose = True
     elif o == '-n':
       test_mode = True
+    elif o == '-g':
+      greedy = True
 
   if is_string:
     data = args[0]
@@ -150,7 +153,8 @@ def joy_type(cmd,args,opts):
   result,duration = app.dtvcmd.joy_type(data,screen_code=screen_code,
                         type_delay=type_delay,joy_delay=joy_delay,
                         start_key=start_key,verbose=verbose,
-                        test_mode=test_mode,callback=app.iotools.print_size_dec)
+                        test_mode=test_mode,greedy=greedy,
+                        callback=app.iotools.print_size_dec)
   app.iotools.print_result(result)
   if result == STATUS_OK:
     app.iotools.print_duration(duration)
@@ -176,7 +180,8 @@ def init(cmdSet):
     ('j','<delay>','set the joystick move delay\n(default: 6)'),
     ('k','<key>','assume virtual keyboard has current key\n(default: J)'),
     ('v',None,'verbose the generated joy stream'),
-    ('n',None,'test mode: do not execute command')
+    ('n',None,'test mode: do not execute command'),
+    ('g',None,'use greedy nearest key moves instead of\nplanned minimal time moves')
   ],
   func=joy_type))
 
@@ -75,6 +75,132 @@ def server_ram(cmd,args,opts):
   return app.helper.load_and_run_dtvtrans_ram()
 
 
+def ack_bin_label(n,last):
+  if n == 0:
+    return "0 us"
+  lo = 1 << (n-1)
+  if n == last:
+    return ">= %d us" % lo
+  return "%d-%d us" % (lo,(1 << n)-1)
+
+def show_ack_histogram():
+  (result,hists) = app.dtvcmd.query_ack_histogram()
+  app.iotools.print_result(result)
+  if result != STATUS_OK:
+    return False
+  print "  ack latency      %10s %10s %10s %10s" % ("phase 1","phase 2","phase 3","phase 4")
+  num = len(hists[0])
+  for n in xrange(num):
+    counts = map(lambda h:h[n],hists)
+    # skip empty bins
+    if sum(counts) == 0:
+      continue
+    print "  %-16s %10d %10d %10d %10d" % tuple([ack_bin_label(n,num-1)] + counts)
+  return True
+
+def server_stats(cmd,args,opts):
+  reset = False
+  ack_hist = False
+  for o,a in opts:
+    if o == '-r':
+      reset = True
+    elif o == '-a':
+      ack_hist = True
+
+  # read histogram first as the stats command may reset it
+  if ack_hist:
+    if not show_ack_histogram():
+      return False
+
+  (result,c) = app.dtvcmd.query_stats(reset)
+  app.iotools.print_result(result)
+  if result != STATUS_OK:
+    return False
+
+  def ratio(part,total):
+    if total == 0:
+      return 0.0
+    return part * 100.0 / total
+
+  print "  serial host:     rx %10d bytes  tx %10d bytes" % (c['host_rx_bytes'],c['host_tx_bytes'])
+  print "  dtvlow:          tx %10d bytes  rx %10d bytes" % (c['dtv_tx_bytes'],c['dtv_rx_bytes'])
+  print "  blocks:          %10d" % c['blocks']
+  print "  noack phase 1-4: %10d %10d %10d %10d" % \
+    (c['noack1'],c['noack2'],c['noack3'],c['noack4'])
+  print "  checksum errors: %10d  crc errors: %d" % (c['checksum_errors'],c['crc_errors'])
+  # wait times are sums of 1ms timer deltas, the ack times are in us
+  waits = (("wait for ack",c['ack_wait_us'] / 1000),
+           ("wait for rx",c['rx_wait_ms']),
+           ("wait for rts",c['rts_wait_ms']),
+           ("wait for udre",c['udre_wait_ms']))
+  total = sum(map(lambda x:x[1],waits))
+  for name,ms in waits:
+    print "  %-16s %10d ms  %5.1f%%" % (name+":",ms,ratio(ms,total))
+  print "  max ack latency: %10d us" % c['ack_max_us']
+  if reset:
+    print "  counters reset"
+  return True
+
+
+def server_prof(cmd,args,opts):
+  reset = False
+  for o,a in opts:
+    if o == '-r':
+      reset = True
+
+  (result,ticks_per_us,entries) = app.dtvcmd.query_profile(reset)
+  app.iotools.print_result(result)
+  if result != STATUS_OK:
+    return False
+  if ticks_per_us == 0:
+    ticks_per_us = 1
+
+  print "  %-18s %10s %12s %10s %10s" % ("function","calls","total ms","avg us","max us")
+  for (name,calls,cycles,max_cycles) in entries:
+    us = cycles / float(ticks_per_us)
+    if calls > 0:
+      avg = us / calls
+    else:
+      avg = 0.0
+    print "  %-18s %10d %12.3f %10.2f %10.2f" % \
+      (name,calls,us / 1000.0,avg,max_cycles / float(ticks_per_us))
+  print "  (times include nested calls, %d cycles per us)" % ticks_per_us
+  if reset:
+    print "  profile reset"
+  return True
+
+
+def server_trace(cmd,args,opts):
+  clear = False
+  for o,a in opts:
+    if o == '-c':
+      clear = True
+
+  (result,trace) = app.dtvcmd.read_trace(clear)
+  app.iotools.print_result(result)
+  if result != STATUS_OK:
+    return False
+
+  # no file: show a text dump
+  if len(args) == 0:
+    print trace.dump()
+    return True
+
+  # write Chrome trace JSON
+  name = args[0]
+  try:
+    f = open(name,"w")
+    f.write(trace.to_chrome_json())
+    f.close()
+  except IOError,e:
+    print "ERROR writing trace file:",e
+    return False
+  print "  wrote %d events to '%s'" % (len(trace.entries),name)
+  if trace.lost > 0:
+    print "  %d older events were lost" % trace.lost
+  return True
+
+
 def init(cmdSet):
   # server
   serverCmd = Cmd(["server","srv"],
@@ -95,3 +221,22 @@ def init(cmdSet):
   help='''query information about the dtvtrans server''',
   func=server_info))
 
+  # stats command
+  serverCmd.add_sub_command(Cmd(["stats"],
+  help='''show the performance counters of the dtv2ser firmware\nto see where the transfer time is spent''',
+  args=[('r',None,'reset the counters after reading them'),
+        ('a',None,'show the ack latency histogram of each phase')],
+  func=server_stats))
+
+  # prof command
+  serverCmd.add_sub_command(Cmd(["prof"],
+  help='''show the cycle profile of the firmware hot paths\n(ARM firmware built with USE_PROF)''',
+  args=[('r',None,'reset the profile after reading it')],
+  func=server_prof))
+
+  # trace command
+  serverCmd.add_sub_command(Cmd(["trace"],
+  help='''dump the event trace of the dtv2ser firmware\nor convert it to Chrome trace JSON (chrome://tracing, ui.perfetto.dev)''',
+  opts=(0,1,"[<file.json>]"),
+  args=[('c',None,'clear the trace after reading it')],
+  func=server_trace))
@@ -27,10 +27,43 @@ from dtv2ser.status import *
 from dtv2sertool.cmd import Cmd
 from dtv2sertool.app import app
 
+def read_list(args):
+  # parse all ranges
+  ranges = []
+  for a in args[:-1]:
+    (rom,start,length,valid) = app.iotools.parse_range(a)
+    if not valid:
+      print "ERROR: invalid range '%s'" % a
+      return False
+    ranges.append((rom,start,length))
+
+  # read data of all ranges
+  for (rom,start,length) in ranges:
+    app.iotools.print_range(start,length)
+  print "  receiving %d memory ranges from DTV" % len(ranges)
+  result,data_list,stat = app.dtvcmd.read_memory_list(ranges,
+                                                      callback=app.iotools.print_size,
+                                                      block_size=app.block_size)
+  app.iotools.print_transfer_result(result,stat)
+  if result != STATUS_OK:
+    return False
+
+  # write all ranges one after another to the file
+  result,is_prg = app.iotools.write_file(args[-1],"".join(data_list),ranges[0][1])
+  app.iotools.print_result(result)
+  if result != STATUS_OK:
+    return False
+  return True
+
+
 def read(cmd,args,opts):
   if not app.require_server_alive():
     return False
 
+  # multiple ranges
+  if len(args) > 2:
+    return read_list(args)
+
   # get range
   if len(args) == 2:
     (rom,start,length,valid) = app.iotools.parse_range(args[0])
@@ -68,6 +101,14 @@ def write(cmd,args,opts):
   if not app.require_server_alive():
     return False
 
+  sync = False
+  verify = False
+  for o,a in opts:
+    if o == '-s':
+      sync = True
+    elif o == '-v':
+      verify = True
+
   # read file
   (result,data,start,is_prg) = app.iotools.read_file(args[-1])
   app.iotools.print_result(result)
@@ -81,20 +122,43 @@ def write(cmd,args,opts):
 
   # write data
   app.iotools.print_range(start,len(data))
-  print "  sending %s memory to DTV" % (('RAM','ROM')[rom])
-  result,stat = app.dtvcmd.write_memory(rom,start,data,
-                                        callback=app.iotools.print_size,
-                                        block_size=app.block_size)
+  if sync:
+    print "  syncing %s memory to DTV" % (('RAM','ROM')[rom])
+    result,stat,num_blocks = app.dtvcmd.sync_memory(rom,start,data,
+                                                    callback=app.iotools.print_size,
+                                                    block_size=app.block_size,
+                                                    verify=verify)
+    if result == STATUS_OK:
+      print "  blocks:   %d changed" % num_blocks
+  else:
+    print "  sending %s memory to DTV" % (('RAM','ROM')[rom])
+    result,stat = app.dtvcmd.write_memory(rom,start,data,
+                                          callback=app.iotools.print_size,
+                                          block_size=app.block_size,
+                                          verify=verify)
   app.iotools.print_transfer_result(result,stat)
   if result != STATUS_OK:
     return False
   return True
 
 
+def print_mismatch(start,data,verify_data):
+  for i in xrange(len(data)):
+    if data[i] != verify_data[i]:
+      break
+  print "  data:     verify MISMATCH! (@%06x: dtv=%02x file=%02x)" \
+    % (start+i,ord(data[i]),ord(verify_data[i]))
+
+
 def verify(cmd,args,opts):
   if not app.require_server_alive():
     return False
 
+  full_read = False
+  for o,a in opts:
+    if o == '-r':
+      full_read = True
+
   # read file
   rom = 0
   (result,verify_data,start,is_prg) = app.iotools.read_file(args[-1])
@@ -106,30 +170,57 @@ def verify(cmd,args,opts):
   if len(args) == 2:
     rom,start = app.iotools.parse_write_start(args[0])
 
-  # read data
   length = len(verify_data)
   app.iotools.print_range(start,length)
-  print "  receiving %s memory from DTV" % (('RAM','ROM')[rom])
-  result,data,stat = app.dtvcmd.read_memory(rom,start,length,
-                                            callback=app.iotools.print_size,
-                                            block_size=app.block_size)
-  app.iotools.print_transfer_result(result,stat)
 
-  # verify data
-  if result == STATUS_OK:
+  # the block checksums need the 'k' command of USE_MEMCMD
+  if not full_read:
+    result,full_read = app.dtvcmd.has_mem_commands()
+    app.iotools.print_result(result)
+    if result != STATUS_OK:
+      return False
+    full_read = not full_read
+
+  # read whole range and compare
+  if full_read:
+    print "  receiving %s memory from DTV" % (('RAM','ROM')[rom])
+    result,data,stat = app.dtvcmd.read_memory(rom,start,length,
+                                              callback=app.iotools.print_size,
+                                              block_size=app.block_size)
+    app.iotools.print_transfer_result(result,stat)
+    if result != STATUS_OK:
+      return False
     if verify_data == data:
       print "  data:     verified ok"
       return True
-    else:
-      for i in xrange(len(data)):
-        if data[i] != verify_data[i]:
-          break
-      print "  data:     verify MISMATCH! (@%06x: dtv=%02x file=%02x)" \
-        % (i,ord(data[i]),ord(verify_data[i]))
-      return False
-  else:
+    print_mismatch(start,data,verify_data)
     return False
 
+  # compare block crcs and only fetch the first differing block
+  print "  receiving %s block checksums from DTV" % (('RAM','ROM')[rom])
+  result,crc_list,stat = app.dtvcmd.crc_memory(rom,start,length,
+                                               callback=app.iotools.print_size,
+                                               block_size=app.block_size)
+  app.iotools.print_transfer_result(result,stat)
+  if result != STATUS_OK:
+    return False
+  for (pos,size,crc16) in crc_list:
+    offset = pos - start
+    block = verify_data[offset:offset+size]
+    if app.dtvcmd.transfer.calc_crc16(block) != crc16:
+      result,data,stat = app.dtvcmd.read_memory(rom,pos,size,
+                                                block_size=app.block_size)
+      app.iotools.print_result(result)
+      if result == STATUS_OK:
+        if data == block:
+          # crc16 mismatch but same data: report as corrupt transfer
+          app.iotools.print_result(CLIENT_ERROR_CRC16_MISMATCH)
+        else:
+          print_mismatch(pos,data,block)
+      return False
+  print "  data:     verified ok"
+  return True
+
 
 def boot(cmd,args,opts):
   # read file
@@ -159,8 +250,9 @@ def init(cmdSet):
   help='''read memory from DTV
 range: [[r]<start>,<length>]
        [[r]<start>-<end>]
-prepend r for ROM, default: RAM''',
-  opts=(1,2,'[<range>] <file>'),
+prepend r for ROM, default: RAM
+multiple ranges are stored one after another''',
+  opts=(1,64,'[<range> ...] <file>'),
   func=read))
 
   # verify command
@@ -170,13 +262,22 @@ range: [[r]<start>,<length>]
        [[r]<start>-<end>]
 prepend r for ROM, default: RAM''',
   opts=(2,2,'<range> <file>'),
-  func=verify))
+  func=verify,
+  args=[
+    ('r',None,'read back all data instead of block checksums')
+  ]
+  ))
 
   # write command
   cmdSet.add_command(Cmd(["write","wr","w"],
   help='''write memory to DTV''',
   opts=(1,2,'[<address>] <file>'),
-  func=write))
+  func=write,
+  args=[
+    ('s',None,'sync: only write blocks that differ in DTV memory'),
+    ('v',None,'verify: read back each block in dtv2ser and compare')
+  ]
+  ))
 
   # boot command
   cmdSet.add_command(Cmd(["boot","bt","b"],
@@ -63,17 +63,17 @@ class Flash:
     "Auto Prog"
   )
 
-  def __init__(self):
-    self.loaded_servlet = False
-
   # ----- Tools -----
 
   def load_servlet(self):
-    """Load the flash_srv.prg servlet"""
-    if self.loaded_servlet:
-      return True
-    self.loaded_servlet = app.helper.load_servlet("flash_srv.prg",self.servlet_start,app.verbose)
-    return self.loaded_servlet
+    """Make sure the flash_srv.prg servlet is resident"""
+    result = app.servlets.ensure_resident("flash")
+    app.iotools.print_result(result)
+    return result == STATUS_OK
+
+  def call_servlet(self,addr,acc=0,timeout=10):
+    """Call a function of the flash servlet via the dispatcher"""
+    return app.servlets.call("flash",addr,acc=acc,timeout=timeout)
 
   def download_range_pointers(self,start,length):
     """Download pointers to servlet_iobuf in DTV memory"""
@@ -135,8 +135,8 @@ class Flash:
       mode = self.servlet_mode_check_empty
     else:
       mode = self.servlet_mode_erase
-    (result,sr,acc,xr,yr,duration) = app.dtvcmd.sys_call(self.servlet_program_flash,
-                                                         acc=mode,timeout=60)
+    (result,sr,acc,xr,yr,duration) = self.call_servlet(self.servlet_program_flash,
+                                                       acc=mode,timeout=60)
     app.iotools.print_result(result)
     app.iotools.print_duration(duration)
     if result != STATUS_OK:
@@ -155,8 +155,8 @@ class Flash:
       mode = self.servlet_mode_check_empty
     else:
       mode = self.servlet_mode_program
-    (result,sr,acc,xr,yr,duration) = app.dtvcmd.sys_call(self.servlet_program_flash,
-                                                         acc=mode,timeout=60)
+    (result,sr,acc,xr,yr,duration) = self.call_servlet(self.servlet_program_flash,
+                                                       acc=mode,timeout=60)
     app.iotools.print_result(result)
     if verbose:
       app.iotools.print_duration(duration)
@@ -175,8 +175,8 @@ class Flash:
 
   def call_verify(self,verbose=True):
     mode = self.servlet_mode_verify
-    (result,sr,acc,xr,yr,duration) = app.dtvcmd.sys_call(self.servlet_program_flash,
-                                                         acc=mode,timeout=30)
+    (result,sr,acc,xr,yr,duration) = self.call_servlet(self.servlet_program_flash,
+                                                       acc=mode,timeout=30)
     app.iotools.print_result(result)
     if verbose:
       app.iotools.print_duration(duration)
@@ -199,8 +199,8 @@ class Flash:
     """
 
     mode = self.servlet_mode_check_empty
-    (result,sr,acc,xr,yr,duration) = app.dtvcmd.sys_call(self.servlet_program_flash,
-                                                         acc=mode,timeout=10)
+    (result,sr,acc,xr,yr,duration) = self.call_servlet(self.servlet_program_flash,
+                                                       acc=mode,timeout=10)
     app.iotools.print_result(result)
     app.iotools.print_duration(duration)
     if result != STATUS_OK:
@@ -270,7 +270,7 @@ class Flash:
       return False,""
 
     # run servlet
-    (result,sr,acc,xr,yr,duration) = app.dtvcmd.sys_call(self.servlet_ident_flash)
+    (result,sr,acc,xr,yr,duration) = self.call_servlet(self.servlet_ident_flash)
     app.iotools.print_result(result)
     if result != STATUS_OK:
       return False,""
@@ -295,7 +295,7 @@ class Flash:
 
     # run servlet
     print "  generating flash map on DTV"
-    (result,sr,acc,xr,yr,duration) = app.dtvcmd.sys_call(self.servlet_gen_map,timeout=30)
+    (result,sr,acc,xr,yr,duration) = self.call_servlet(self.servlet_gen_map,timeout=30)
     app.iotools.print_result(result)
     app.iotools.print_duration(duration)
     if result != STATUS_OK:
@@ -36,12 +36,13 @@ class Helper:
     self.verbose = verbose
     self.block_size = block_size
 
-  def load_servlet(self,prg_name,prg_addr,verbose):
-    """load a servlet program into dtv memory"""
+  def read_servlet(self,prg_name,prg_addr,verbose):
+    """read a servlet program from the distribution
+       Returns data or None"""
     # get servlet file name
     file_name = self.iotools.find_dist_file(prg_name,"servlet")
     if file_name == "":
-      return False
+      return None
 
     # load servlet
     if verbose:
@@ -49,10 +50,18 @@ class Helper:
     (result,data,start,is_prg) = self.iotools.read_file(file_name,verbose=False)
     self.iotools.print_result(result)
     if result != STATUS_OK:
-      return False
+      return None
     if start != prg_addr:
       print "Servlet '%s' has invalid start address (expected 0x%04x)!" % (start,prg_addr)
+      return None
+    return data
+
+  def load_servlet(self,prg_name,prg_addr,verbose):
+    """load a servlet program into dtv memory"""
+    data = self.read_servlet(prg_name,prg_addr,verbose)
+    if data == None:
       return False
+    start = prg_addr
 
     # upload servlet
     (result,stat) = self.dtvcmd.write_memory(0,start,data,
@@ -69,13 +78,7 @@ class Helper:
        Returns True if all ok
     """
     print "  resetting..."
-    result = self.dtvcmd.dtv_reset(RESET_ENTER_DTVTRANS)
-    self.iotools.print_result(result)
-    if result != STATUS_OK:
-      return False
-
-    print "  is alive?"
-    result = self.dtvcmd.is_alive()
+    result = self.dtvcmd.dtv_reset(RESET_ENTER_DTVTRANS,wait_ready=True)
     self.iotools.print_result(result)
     if result != STATUS_OK:
       return False
@@ -116,6 +116,8 @@ class IOTools:
     if result == STATUS_OK:
       print "    speed:  client=%02.2f server=%02.2f (kbyte/s)" % (cr,sr)
       print "    time:   %s for %d/0x%06x bytes" % (self.time_string(t),l,l)
+      if self.verbose and len(stat) > 4:
+        print "    server: %s" % stat[4]
 
   def print_size(self,size):
     """Print size callback for transfer operaitons
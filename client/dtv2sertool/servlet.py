@@ -0,0 +1,232 @@
+#
+# servlet.py - manage resident servlets on the DTV
+#
+# Written by
+#  Christian Vogelgsang <chris@vogelgsang.org>
+#
+# This file is part of dtv2ser.
+# See README for copyright notice.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+#  02111-1307  USA.
+#
+
+from dtv2ser.status import *
+
+class ServletManager:
+  """Keep track of the servlets resident in DTV memory and call their
+     functions through the dispatcher servlet disp_srv.prg"""
+
+  # disp_srv.prg:
+  disp_prg       = "disp_srv.prg"
+  disp_start     = 0x0e00
+  disp_dispatch  = 0x0e00
+  disp_checksum  = 0x0e03
+  disp_mailbox   = 0x0f00
+
+  # mailbox layout
+  mailbox_vectors = 0x20
+  mailbox_args    = 0x40
+  max_funcs       = 16
+  max_args        = 0xc0
+
+  # known servlet modules: name -> (prg_name,start)
+  modules = {
+    "flash" : ("flash_srv.prg",0x1000),
+    "diag"  : ("diag_srv.prg",0x1000)
+  }
+
+  def __init__(self,dtvcmd,helper,verbose=False):
+    self.dtvcmd  = dtvcmd
+    self.helper  = helper
+    self.verbose = verbose
+    # module data: name -> (start,data,checksum)
+    self.module_data = {}
+    # modules believed to be resident: name -> (start,end)
+    self.resident = {}
+    # function vectors by id. id 0 is the builtin checksum
+    self.vectors = [self.disp_checksum]
+    self.has_dispatcher = False
+    # without disp_srv.prg all functions are called directly
+    self.no_dispatcher  = False
+    dtvcmd.mem_listeners.append(self.mem_changed)
+
+  # ----- Tools -----
+
+  def mem_changed(self,rom,start,length):
+    """Forget all servlets in the changed memory range"""
+    if rom != 0:
+      return
+    end = start + length
+    if start < self.disp_mailbox and end > self.disp_start:
+      self.has_dispatcher = False
+    for name in self.resident.keys():
+      (mod_start,mod_end) = self.resident[name]
+      if start < mod_end and end > mod_start:
+        del self.resident[name]
+
+  def get_module(self,name):
+    """Read a servlet module from the distribution
+    Returns (start,data,checksum) or None"""
+    if self.module_data.has_key(name):
+      return self.module_data[name]
+    if name == "disp":
+      prg_name,start = self.disp_prg,self.disp_start
+    else:
+      prg_name,start = self.modules[name]
+    data = self.helper.read_servlet(prg_name,start,self.verbose)
+    if data == None:
+      return None
+    entry = (start,data,self.dtvcmd.pack.checksum(data))
+    self.module_data[name] = entry
+    return entry
+
+  def upload(self,name):
+    """Upload a servlet module
+    Returns result"""
+    entry = self.get_module(name)
+    if entry == None:
+      return CLIENT_ERROR_FILE_ERROR
+    (start,data,checksum) = entry
+    if self.verbose:
+      print "  uploading servlet '%s' @0x%04x" % (name,start)
+    (result,stat) = self.dtvcmd.write_memory(0,start,data,
+                                             block_size=self.helper.block_size)
+    if result == STATUS_OK:
+      self.resident[name] = (start,start+len(data))
+    return result
+
+  def func_id(self,addr):
+    """Return the dispatcher id of a function address"""
+    if addr in self.vectors:
+      return self.vectors.index(addr)
+    # recycle ids when table is full
+    if len(self.vectors) == self.max_funcs:
+      self.vectors = self.vectors[:1]
+    self.vectors.append(addr)
+    return len(self.vectors) - 1
+
+  def mailbox_data(self,fid,args):
+    """Build the mailbox contents for a call"""
+    data = chr(fid) + chr(0) + chr(0) * (self.mailbox_vectors - 2)
+    for v in self.vectors:
+      data += chr(v & 0xff) + chr(v >> 8)
+    data += chr(0) * (self.mailbox_args - len(data))
+    return data + args
+
+  def check_dispatcher(self):
+    """Verify the dispatcher code on the DTV against disp_srv.prg.
+    Uses the block CRCs of the firmware or of a full read back without 'k'.
+    Returns (result,ok)"""
+    (start,data,checksum) = self.get_module("disp")
+    (result,blocks) = self.dtvcmd.diff_memory(0,start,data,
+                                              block_size=self.helper.block_size)
+    if result != STATUS_OK:
+      return (result,False)
+    return (STATUS_OK,len(blocks) == 0)
+
+  # ----- API -----
+
+  def ensure_dispatcher(self):
+    """Make sure the dispatcher is resident
+    Returns result"""
+    if self.has_dispatcher or self.no_dispatcher:
+      return STATUS_OK
+    if self.get_module("disp") == None:
+      print "WARNING: no dispatcher servlet found. using direct calls!"
+      self.no_dispatcher = True
+      return STATUS_OK
+    result = self.upload("disp")
+    if result == STATUS_OK:
+      self.has_dispatcher = True
+    return result
+
+  def verify_dispatcher(self):
+    """Make sure the dispatcher is resident and unchanged. Never jump into
+    a damaged dispatcher: reload it if its check fails.
+    Returns result"""
+    result = self.ensure_dispatcher()
+    if result != STATUS_OK or self.no_dispatcher:
+      return result
+    (result,ok) = self.check_dispatcher()
+    if result != STATUS_OK or ok:
+      return result
+    if self.verbose:
+      print "  dispatcher damaged. reloading"
+    self.has_dispatcher = False
+    return self.ensure_dispatcher()
+
+  def is_resident(self,name):
+    """Check with the dispatcher checksum if a module is resident
+    Returns (result,is_resident)"""
+    entry = self.get_module(name)
+    if entry == None:
+      return (CLIENT_ERROR_FILE_ERROR,False)
+    (start,data,checksum) = entry
+    result = self.ensure_dispatcher()
+    if result != STATUS_OK or self.no_dispatcher:
+      return (result,False)
+    args = chr(start & 0xff) + chr(start >> 8) + \
+           chr(len(data) & 0xff) + chr(len(data) >> 8)
+    (result,sr,acc,xr,yr,duration) = self.call_func(self.disp_checksum,args=args)
+    if result != STATUS_OK:
+      return (result,False)
+    return (STATUS_OK,(xr,yr) == checksum)
+
+  def ensure_resident(self,name):
+    """Make sure a servlet module is resident. Only uploads it if its
+    checksum on the DTV does not match.
+    Returns result"""
+    if self.resident.has_key(name):
+      return STATUS_OK
+    result,ok = self.is_resident(name)
+    if result != STATUS_OK:
+      return result
+    if ok:
+      if self.verbose:
+        print "  servlet '%s' is already resident" % name
+      (start,data,checksum) = self.get_module(name)
+      self.resident[name] = (start,start+len(data))
+      return STATUS_OK
+    return self.upload(name)
+
+  def call_func(self,addr,acc=0,xr=0,yr=0,args="",timeout=10.0):
+    """Call a function via the dispatcher. Mailbox and arguments are
+    written in a single transfer.
+    Returns (result,sr,acc,xr,yr,duration)"""
+    if len(args) > self.max_args:
+      return (CLIENT_ERROR_INVALID_ARGUMENT,0,0,0,0,0)
+    result = self.verify_dispatcher()
+    if result != STATUS_OK:
+      return (result,0,0,0,0,0)
+    if self.no_dispatcher:
+      if args != "":
+        return (CLIENT_ERROR_INVALID_ARGUMENT,0,0,0,0,0)
+      return self.dtvcmd.sys_call(addr,acc=acc,xr=xr,yr=yr,timeout=timeout)
+    fid = self.func_id(addr)
+    mailbox = self.mailbox_data(fid,args)
+    (result,stat) = self.dtvcmd.write_memory(0,self.disp_mailbox,mailbox,
+                                             block_size=self.helper.block_size)
+    if result != STATUS_OK:
+      return (result,0,0,0,0,0)
+    return self.dtvcmd.sys_call(self.disp_dispatch,acc=acc,xr=xr,yr=yr,timeout=timeout)
+
+  def call(self,name,addr,acc=0,xr=0,yr=0,args="",timeout=10.0):
+    """Call a function of a servlet module and load it only if required
+    Returns (result,sr,acc,xr,yr,duration)"""
+    result = self.ensure_resident(name)
+    if result != STATUS_OK:
+      return (result,0,0,0,0,0)
+    return self.call_func(addr,acc,xr,yr,args,timeout)
@@ -0,0 +1,317 @@
+#!/usr/bin/env python
+#
+# packtest.py - check the client codecs against the pack servlet code
+#
+# Written by
+#  Christian Vogelgsang <chris@vogelgsang.org>
+#
+# This file is part of dtv2ser.
+# See README for copyright notice.
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+#  02111-1307  USA.
+#
+# Runs ../servlet/pack_srv.prg in a small 6502 model and checks that the
+# streams of the servlet and of dtv2ser/pack.py round-trip in both ways.
+#
+
+import sys
+import os
+import random
+
+from dtv2ser.status import *
+from dtv2ser.pack import Pack
+
+class Cpu:
+  """A 6502 model with just the instructions the servlets use"""
+
+  # return address of call()
+  exit_addr = 0xfff0
+
+  def __init__(self):
+    self.mem = [0] * 0x10000
+    self.a = 0
+    self.x = 0
+    self.y = 0
+    self.sp = 0xff
+    self.pc = 0
+    self.c = 0
+    self.z = 0
+    self.n = 0
+    # opcode -> (operation,addressing mode)
+    self.ops = {
+      0x4c:('jmp','abs'), 0x20:('jsr','abs'), 0x60:('rts','imp'),
+      0xa9:('lda','imm'), 0xa5:('lda','zp'),  0xad:('lda','abs'), 0xb1:('lda','izy'),
+      0xa2:('ldx','imm'), 0xa6:('ldx','zp'),  0xae:('ldx','abs'),
+      0xa0:('ldy','imm'), 0xa4:('ldy','zp'),  0xac:('ldy','abs'),
+      0x85:('sta','zp'),  0x8d:('sta','abs'), 0x91:('sta','izy'),
+      0x86:('stx','zp'),  0x8e:('stx','abs'),
+      0x84:('sty','zp'),  0x8c:('sty','abs'),
+      0x69:('adc','imm'), 0x65:('adc','zp'),  0x6d:('adc','abs'),
+      0xe9:('sbc','imm'), 0xe5:('sbc','zp'),  0xed:('sbc','abs'),
+      0x29:('and','imm'), 0x09:('ora','imm'), 0x0d:('ora','abs'),
+      0xc9:('cmp','imm'), 0xc5:('cmp','zp'),  0xcd:('cmp','abs'),
+      0xe0:('cpx','imm'), 0xec:('cpx','abs'),
+      0xc0:('cpy','imm'), 0xcc:('cpy','abs'),
+      0xe6:('inc','zp'),  0xee:('inc','abs'),
+      0xc6:('dec','zp'),  0xce:('dec','abs'),
+      0xe8:('inx','imp'), 0xca:('dex','imp'), 0xc8:('iny','imp'), 0x88:('dey','imp'),
+      0xaa:('tax','imp'), 0x8a:('txa','imp'), 0xa8:('tay','imp'), 0x98:('tya','imp'),
+      0xba:('tsx','imp'), 0x9a:('txs','imp'),
+      0x18:('clc','imp'), 0x38:('sec','imp'),
+      0x90:('bcc','rel'), 0xb0:('bcs','rel'), 0xf0:('beq','rel'), 0xd0:('bne','rel'),
+      0x10:('bpl','rel'), 0x30:('bmi','rel')
+    }
+
+  def load(self,prg):
+    """Load a prg file with load address"""
+    start = ord(prg[0]) | (ord(prg[1]) << 8)
+    self.poke(start,prg[2:])
+
+  def poke(self,addr,data):
+    for i in xrange(len(data)):
+      self.mem[addr+i] = ord(data[i])
+
+  def peek(self,addr,length):
+    return "".join(map(chr,self.mem[addr:addr+length]))
+
+  def push(self,v):
+    self.mem[0x100 + self.sp] = v
+    self.sp = (self.sp - 1) & 0xff
+
+  def pull(self):
+    self.sp = (self.sp + 1) & 0xff
+    return self.mem[0x100 + self.sp]
+
+  def flags(self,v):
+    self.z = int(v == 0)
+    self.n = v >> 7
+    return v
+
+  def word(self,addr):
+    return self.mem[addr] | (self.mem[(addr+1) & 0xffff] << 8)
+
+  def call(self,addr,a=0,x=0,y=0,max_steps=10000000):
+    """Call a subroutine like the sys_call command
+    Returns (a,x,y)"""
+    self.a,self.x,self.y = a,x,y
+    ret = self.exit_addr - 1
+    self.push(ret >> 8)
+    self.push(ret & 0xff)
+    self.pc = addr
+    steps = 0
+    while self.pc != self.exit_addr:
+      self.step()
+      steps += 1
+      if steps == max_steps:
+        raise RuntimeError("servlet does not return")
+    return (self.a,self.x,self.y)
+
+  def step(self):
+    opcode = self.mem[self.pc]
+    if not self.ops.has_key(opcode):
+      raise RuntimeError("unknown opcode %02x @%04x" % (opcode,self.pc))
+    (op,mode) = self.ops[opcode]
+    pc = self.pc + 1
+    # resolve operand address
+    if mode == 'imp':
+      addr = None
+      self.pc = pc
+    elif mode in ('imm','rel'):
+      addr = pc
+      self.pc = pc + 1
+    elif mode == 'zp':
+      addr = self.mem[pc]
+      self.pc = pc + 1
+    elif mode == 'izy':
+      addr = (self.word(self.mem[pc]) + self.y) & 0xffff
+      self.pc = pc + 1
+    else:
+      addr = self.word(pc)
+      self.pc = pc + 2
+    getattr(self,'op_' + op)(addr)
+
+  def compare(self,r,addr):
+    v = self.mem[addr]
+    self.c = int(r >= v)
+    self.flags((r - v) & 0xff)
+
+  def branch(self,cond,addr):
+    if cond:
+      off = self.mem[addr]
+      if off >= 0x80:
+        off -= 0x100
+      self.pc = (self.pc + off) & 0xffff
+
+  def op_jmp(self,addr): self.pc = addr
+  def op_jsr(self,addr):
+    ret = self.pc - 1
+    self.push(ret >> 8)
+    self.push(ret & 0xff)
+    self.pc = addr
+  def op_rts(self,addr):
+    lo = self.pull()
+    self.pc = ((self.pull() << 8) | lo) + 1
+  def op_lda(self,addr): self.a = self.flags(self.mem[addr])
+  def op_ldx(self,addr): self.x = self.flags(self.mem[addr])
+  def op_ldy(self,addr): self.y = self.flags(self.mem[addr])
+  def op_sta(self,addr): self.mem[addr] = self.a
+  def op_stx(self,addr): self.mem[addr] = self.x
+  def op_sty(self,addr): self.mem[addr] = self.y
+  def op_adc(self,addr):
+    v = self.a + self.mem[addr] + self.c
+    self.c = v >> 8
+    self.a = self.flags(v & 0xff)
+  def op_sbc(self,addr):
+    v = self.a - self.mem[addr] - (1 - self.c)
+    self.c = int(v >= 0)
+    self.a = self.flags(v & 0xff)
+  def op_and(self,addr): self.a = self.flags(self.a & self.mem[addr])
+  def op_ora(self,addr): self.a = self.flags(self.a | self.mem[addr])
+  def op_cmp(self,addr): self.compare(self.a,addr)
+  def op_cpx(self,addr): self.compare(self.x,addr)
+  def op_cpy(self,addr): self.compare(self.y,addr)
+  def op_inc(self,addr): self.mem[addr] = self.flags((self.mem[addr] + 1) & 0xff)
+  def op_dec(self,addr): self.mem[addr] = self.flags((self.mem[addr] - 1) & 0xff)
+  def op_inx(self,addr): self.x = self.flags((self.x + 1) & 0xff)
+  def op_dex(self,addr): self.x = self.flags((self.x - 1) & 0xff)
+  def op_iny(self,addr): self.y = self.flags((self.y + 1) & 0xff)
+  def op_dey(self,addr): self.y = self.flags((self.y - 1) & 0xff)
+  def op_tax(self,addr): self.x = self.flags(self.a)
+  def op_txa(self,addr): self.a = self.flags(self.x)
+  def op_tay(self,addr): self.y = self.flags(self.a)
+  def op_tya(self,addr): self.a = self.flags(self.y)
+  def op_tsx(self,addr): self.x = self.flags(self.sp)
+  def op_txs(self,addr): self.sp = self.x
+  def op_clc(self,addr): self.c = 0
+  def op_sec(self,addr): self.c = 1
+  def op_bcc(self,addr): self.branch(not self.c,addr)
+  def op_bcs(self,addr): self.branch(self.c,addr)
+  def op_beq(self,addr): self.branch(self.z,addr)
+  def op_bne(self,addr): self.branch(not self.z,addr)
+  def op_bpl(self,addr): self.branch(not self.n,addr)
+  def op_bmi(self,addr): self.branch(self.n,addr)
+
+# ----- test data -----
+
+def samples(rnd):
+  """Return a list of (name,data) covering the corner cases of the codecs"""
+  s = []
+  s.append(("one byte","\x42"))
+  s.append(("zeros","\x00" * 0x0d00))
+  s.append(("run max","\x11" * 130))
+  s.append(("run max+1","\x11" * 131))
+  s.append(("run max+3","\x11" * 133))
+  s.append(("short runs","aabbbccccddddd" * 40))
+  s.append(("lit max",''.join(chr(i) for i in xrange(128))))
+  s.append(("lit max+1",''.join(chr(i) for i in xrange(129)) + "\x00" * 64))
+  s.append(("random","".join(chr(rnd.randint(0,255)) for i in xrange(0x0300))))
+  s.append(("text","READY.\r" * 200 + "10 PRINT\"HELLO\":GOTO 10\r" * 40))
+  fill = []
+  while len(fill) < 0x0d00:
+    if rnd.randint(0,2) == 0:
+      fill.append(chr(rnd.randint(0,3)) * rnd.randint(1,200))
+    else:
+      fill.append("".join(chr(rnd.randint(0,255)) for i in xrange(rnd.randint(1,40))))
+  s.append(("mixed","".join(fill)[:0x0d00]))
+  return s
+
+# ----- tests -----
+
+class Test:
+  def __init__(self,prg):
+    self.prg = prg
+    self.pack = Pack()
+    self.checks = 0
+    self.failed = 0
+
+  def check(self,ok,what):
+    self.checks += 1
+    if not ok:
+      self.failed += 1
+      print "FAILED:",what
+
+  def cpu(self):
+    cpu = Cpu()
+    cpu.load(self.prg)
+    return cpu
+
+  def test_rle(self,name,data,src=0x1000):
+    """Pack on the DTV model and unpack on the host"""
+    p = self.pack
+    cpu = self.cpu()
+    cpu.poke(src,data)
+    cpu.poke(p.servlet_param,p.param_data(src,len(data)))
+    (a,x,y) = cpu.call(p.servlet_pack_rle)
+    host = p.rle_encode(data)
+    if len(host) >= len(data):
+      self.check(a == p.servlet_pack_no_gain,"rle %s: no gain not reported" % name)
+      return
+    self.check(a == p.servlet_pack_ok,"rle %s: result %d" % (name,a))
+    packed = cpu.peek(p.servlet_buffer,x | (y << 8))
+    self.check(packed == host,"rle %s: stream differs from rle_encode" % name)
+    (result,unpacked) = p.rle_decode(packed,len(data))
+    self.check(result == STATUS_OK and unpacked == data,"rle %s: round trip" % name)
+    self.check(cpu.peek(src,len(data)) == data,"rle %s: source changed" % name)
+
+  def test_lz(self,name,data,dst=0x1000):
+    """Pack on the host in chunks like write_packed_memory and unpack each
+    chunk on the DTV model. Matches may reach back into earlier chunks."""
+    p = self.pack
+    cpu = self.cpu()
+    begin = 0
+    while begin < len(data):
+      end = min(len(data),begin + p.pack_chunk_size)
+      packed = p.lz_encode(data,begin,end,0)
+      self.check(len(packed) <= p.servlet_end - p.servlet_buffer,
+                 "lz %s: stream does not fit in buffer" % name)
+      (result,unpacked) = p.lz_decode(packed,data[:begin])
+      self.check(result == STATUS_OK and unpacked == data[begin:end],
+                 "lz %s: host round trip @%04x" % (name,begin))
+      cpu.poke(p.servlet_buffer,packed)
+      cpu.poke(p.servlet_param,p.param_data(dst+begin,len(packed)))
+      (a,x,y) = cpu.call(p.servlet_unpack_lz)
+      self.check(a == 0,"lz %s: result %d" % (name,a))
+      self.check((x,y) == p.checksum(data[begin:end]),
+                 "lz %s: checksum @%04x" % (name,begin))
+      begin = end
+    self.check(cpu.peek(dst,len(data)) == data,"lz %s: round trip" % name)
+
+  def run(self):
+    rnd = random.Random(0x2008)
+    for (name,data) in samples(rnd):
+      self.test_rle(name,data)
+      self.test_lz(name,data)
+    # repeated data across chunks
+    block = "".join(chr(rnd.randint(0,255)) for i in xrange(0x0400))
+    self.test_lz("chunks",block * 8)
+    print "%d checks, %d failed" % (self.checks,self.failed)
+    return self.failed == 0
+
+def main():
+  prg_name = os.path.join(os.path.dirname(sys.argv[0]),"..","servlet","pack_srv.prg")
+  if len(sys.argv) > 1:
+    prg_name = sys.argv[1]
+  try:
+    prg = open(prg_name,"rb").read()
+  except IOError,e:
+    print "can't read",prg_name,":",e
+    return 1
+  if Test(prg).run():
+    return 0
+  return 1
+
+if __name__ == '__main__':
+  sys.exit(main())
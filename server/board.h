@@ -59,5 +59,13 @@
 
 #endif // HAVE_bluepill
 
+// ========== host ==========================================================
+
+#ifdef HAVE_host
+
+#include "host.h"
+
+#endif // HAVE_host
+
 #endif
 
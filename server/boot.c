@@ -120,13 +120,24 @@ void exec_boot_memory(void)
   uint16_t addr = CMDLINE_ARG_WORD(0);
   uint16_t len  = CMDLINE_ARG_WORD(1);
 
-  uint32_t start = timer_now();
+#ifdef USE_HIRES_TIMER
+  uint32_t start = timer_us();
+#else
+  uint16_t start = timer_now();
+#endif
 
   uint8_t status = dtvtrans_send_boot(addr,len);
 
   // setup transfer state
-  transfer_state.ms_time = timer_now() - start;
-  transfer_state.result  = status;
+#ifdef USE_HIRES_TIMER
+  transfer_state.length   = len;
+  transfer_state.setup_us = 0;
+  transfer_state.data_us  = timer_us() - start;
+  transfer_state.end_us   = 0;
+#else
+  transfer_state.ms_time  = (uint16_t)(timer_now() - start) / 10;
+#endif
+  transfer_state.result   = status;
 
   if(status!=TRANSFER_OK)
     error_condition();
@@ -37,6 +37,8 @@
 #include "util.h"
 #include "timer.h"
 #include "param.h"
+#include "trace.h"
+#include "prof.h"
 
 // buffer for user input
 static uint8_t cmdline_buf[CMDLINE_SIZE];
@@ -78,6 +80,8 @@ static void cmdline_set_error(void)
 // call regurlarly to see if user input is available
 void cmdline_handle(void)
 {
+  PROF_ENTER(PROF_CMDLINE_HANDLE);
+
   // read chars
   while(uart_read_data_available()) {
     uint8_t data;
@@ -136,6 +140,8 @@ void cmdline_handle(void)
   else
     led_transmit_off();
 #endif
+
+  PROF_EXIT(PROF_CMDLINE_HANDLE);
 }
 
 // ----- handle return -----
@@ -178,7 +184,9 @@ static void handle_return(void)
   // execute command if all went well
   if((cmd!=0)&&(status==CMDLINE_STATUS_OK)) {
     led_error_off();
+    TRACE(TRACE_CMD_BEGIN,cmd->name[0]);
     cmd->execute_cmd();
+    TRACE(TRACE_CMD_END,cmd->name[0]);
   }
   // set error led
   else {
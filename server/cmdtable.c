@@ -40,8 +40,24 @@
 command_t command_table[] = {
   // transfer commands
   COMMAND("m","b",exec_transfer_mode),
+#ifdef USE_MEMCMD
+  COMMAND("rp","btb",exec_peek_memory),
+#endif
   COMMAND("r","btt",exec_read_memory),
+#ifdef USE_MEMCMD
+  COMMAND("wv","btt",exec_write_verify_memory),
+  COMMAND("wp","bt*",exec_poke_memory),
+#endif
   COMMAND("w","btt",exec_write_memory),
+#ifdef USE_MEMCMD
+  COMMAND("k","btt",exec_crc_memory),
+  COMMAND("lr","b",exec_read_memory_list),
+  COMMAND("lw","b",exec_write_memory_list),
+#endif
+#ifdef USE_TRACE
+  // before 't' as commands match by prefix
+  COMMAND("tr","b",exec_trace),
+#endif
   COMMAND("t",0,exec_transfer_result),
 #ifdef USE_BOOT
   COMMAND("b","ww",exec_boot_memory),
@@ -49,6 +65,9 @@ command_t command_table[] = {
 
   // dtvtrans commands
   COMMAND("a","w",exec_is_alive),
+#ifdef USE_SYSCMD
+  COMMAND("cs","bbbbbbbbw",exec_sys_call),
+#endif
   COMMAND("c","bb*",exec_command),
 #ifdef USE_OLDCMD
   COMMAND("g","w",exec_go_memory),
@@ -57,7 +76,20 @@ command_t command_table[] = {
   // dtv2ser commands
   COMMAND("x","b",exec_reset_dtv),
   COMMAND("v",0,exec_version),
+#ifdef USE_PROF
+  // before 's' as commands match by prefix
+  COMMAND("sp","b",exec_prof),
+#endif
+#ifdef USE_STATS
+#ifdef USE_ACK_HIST
+  COMMAND("sa","b",exec_stats_ack),
+#endif
+  COMMAND("s","b",exec_stats),
+#endif
 #ifdef USE_JOYSTICK
+#ifdef USE_JOYBUF
+  COMMAND("jb",0,exec_joy_buffered_stream),
+#endif
   COMMAND("j",0,exec_joy_stream),
 #endif
 
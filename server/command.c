@@ -33,11 +33,16 @@
 #include "display.h"
 #include "uart.h"
 #include "uartutil.h"
+#include "util.h"
 #include "timer.h"
 #include "dtvtrans.h"
 #include "dtvlow.h"
 #include "param.h"
 #include "cmdline.h"
+#include "stats.h"
+#include "trace.h"
+#include "telemetry.h"
+#include "prof.h"
 
 // ----- Helpers -----
 
@@ -45,6 +50,8 @@
 void error_condition(void)
 {
   uint8_t toggle = 1;
+  TRACE(TRACE_ERROR_BEGIN,0);
+  TELEMETRY_ERROR();
   led_error_on();
 
   uart_start_reception();
@@ -70,6 +77,7 @@ void error_condition(void)
   uart_stop_reception();
 
   led_error_off();
+  TRACE(TRACE_ERROR_END,0);
 }
 
 // ---------- Commands ------------------------------------------------------
@@ -111,7 +119,27 @@ void exec_reset_dtv(void)
 
   // perform reset
   led_transmit_on();
+  uint16_t start = timer_now();
   dtvlow_reset_dtv(reset_mode);
+
+  // the knock was only held until dtvmon sampled it, now probe until
+  // dtvtrans answers or the reset delay is over
+  if(reset_mode & DTVLOW_RESET_WAIT_READY) {
+    uint16_t probe = PARAM_WORD(PARAM_WORD_DTVLOW_RESET_DELAY);
+    if(probe > DTVLOW_RESET_KNOCK_HOLD + 10)
+      probe -= DTVLOW_RESET_KNOCK_HOLD;
+    else
+      probe = 10;
+    uint8_t status = dtvlow_is_alive(probe / 10);
+    dtvlow_state_clear();
+    uint16_t boot_time = timer_now() - start;
+    led_transmit_off();
+
+    // send result and boot time
+    uart_send_hex_byte_crlf(status);
+    uart_send_hex_word_crlf(boot_time);
+    return;
+  }
   led_transmit_off();
 
   // send result
@@ -156,3 +184,130 @@ void exec_is_alive(void)
   led_transmit_off();
   uart_send_hex_byte_crlf(status);
 }
+
+// ----- Sys Call -----
+
+#ifdef USE_SYSCMD
+
+void exec_sys_call(void)
+{
+  // args: mode,lo,hi,sr,acc,xr,yr,iocfg as in CMD_SYS
+  uint8_t *in_buf  = &CMDLINE_ARG_BYTE(0);
+  uint8_t mode     = CMDLINE_ARG_BYTE(0);
+  uint16_t timeout = CMDLINE_ARG_WORD(0);
+
+  // CMD_SYS
+  led_transmit_on();
+  uint8_t status = dtvtrans_command(0x04,8,in_buf,0);
+
+  // wait until dtvtrans server is alive again
+  uint16_t start = timer_now();
+  if(status==TRANSFER_OK) {
+    dtvlow_state_clear();
+    status = dtvlow_is_alive(timeout);
+    dtvlow_state_clear();
+  }
+  uint16_t duration = timer_now() - start;
+  led_transmit_off();
+
+  uart_send_hex_byte_crlf(status);
+  uart_send_hex_word_crlf(duration);
+
+  // CMD_SYS_RESULT: returns sr,acc,xr,yr
+  if(status==TRANSFER_OK) {
+    status = dtvtrans_command(0x05,1,&mode,4);
+    uart_send_hex_byte_crlf(status);
+  }
+}
+
+#endif
+
+// ----- Stats -----
+
+#ifdef USE_STATS
+
+void exec_stats(void)
+{
+  uint8_t flags = CMDLINE_ARG_BYTE(0);
+
+  // send number of counters and all counters
+  uart_send_hex_byte_crlf(STATS_NUM);
+  for(uint8_t i=0;i<STATS_NUM;i++)
+    uart_send_hex_dword_crlf(stats[i]);
+
+  if(flags & STATS_FLAG_RESET)
+    stats_reset();
+}
+
+#ifdef USE_ACK_HIST
+void exec_stats_ack(void)
+{
+  uint8_t phase = CMDLINE_ARG_BYTE(0) & (STATS_ACK_PHASES - 1);
+
+  // send number of bins and the histogram of the phase
+  uart_send_hex_byte_crlf(STATS_ACK_BINS);
+  for(uint8_t i=0;i<STATS_ACK_BINS;i++)
+    uart_send_hex_word_crlf(stats_ack_hist[phase][i]);
+}
+#endif
+
+#endif
+
+// ----- Profile -----
+
+#ifdef USE_PROF
+
+void exec_prof(void)
+{
+  uint8_t flags = CMDLINE_ARG_BYTE(0);
+
+  // send number of entries, timer ticks per us and all entries
+  uart_send_hex_byte_crlf(PROF_NUM);
+  uart_send_hex_byte_crlf(prof_ticks_per_us());
+  for(uint8_t i=0;i<PROF_NUM;i++) {
+    prof_entry_t *p = &prof[i];
+    uart_send_hex_dword_crlf(p->calls);
+    uart_send_hex_dword_crlf((uint32_t)(p->cycles >> 32));
+    uart_send_hex_dword_crlf((uint32_t)p->cycles);
+    uart_send_hex_dword_crlf(p->max);
+  }
+
+  if(flags & PROF_FLAG_RESET)
+    prof_reset();
+}
+
+#endif
+
+// ----- Trace -----
+
+#ifdef USE_TRACE
+
+void exec_trace(void)
+{
+  uint8_t flags = CMDLINE_ARG_BYTE(0);
+
+  // freeze the ring so events of the dump itself do not move it
+  trace_enable(0);
+  uint16_t num = trace_num();
+
+  // send number of entries, lost entries and the entries
+  uart_send_hex_word_crlf(num);
+  uart_send_hex_word_crlf(trace_lost());
+  for(uint16_t i=0;i<num;i++) {
+    trace_entry_t e;
+    uint8_t buf[12];
+    if(!trace_get(i,&e))
+      e.event = 0;
+    dword_to_hex(e.us,buf);
+    byte_to_hex(e.event,buf+8);
+    byte_to_hex(e.arg,buf+10);
+    uart_send_data(buf,12);
+    uart_send_crlf();
+  }
+
+  if(flags & TRACE_FLAG_CLEAR)
+    trace_clear();
+  trace_enable(1);
+}
+
+#endif
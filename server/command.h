@@ -45,6 +45,30 @@ void exec_command(void);
 //! exec is alive
 void exec_is_alive(void);
 
+#ifdef USE_SYSCMD
+//! exec sys call and wait for its result
+void exec_sys_call(void);
+#endif
+
+#ifdef USE_STATS
+//! query and reset performance counters
+void exec_stats(void);
+#ifdef USE_ACK_HIST
+//! query ack latency histogram of a phase
+void exec_stats_ack(void);
+#endif
+#endif
+
+#ifdef USE_PROF
+//! query and reset the cycle profile
+void exec_prof(void);
+#endif
+
+#ifdef USE_TRACE
+//! dump and clear the event trace
+void exec_trace(void);
+#endif
+
 // signal error condition
 void error_condition(void);
 
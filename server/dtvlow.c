@@ -31,6 +31,9 @@
 #include "dtvlow.h"
 #include "transfer.h"
 #include "param.h"
+#include "stats.h"
+#include "trace.h"
+#include "prof.h"
 
 void dtvlow_state_clear(void)
 {
@@ -45,6 +48,11 @@ void dtvlow_reset_dtv(uint8_t mode)
 {
   uint16_t pre_delay = PARAM_WORD(PARAM_WORD_DTVLOW_PREPARE_RESET_DELAY);
   uint16_t delay = PARAM_WORD(PARAM_WORD_DTVLOW_RESET_DELAY);
+  if(mode & DTVLOW_RESET_WAIT_READY) {
+    mode &= ~DTVLOW_RESET_WAIT_READY;
+    if(delay > DTVLOW_RESET_KNOCK_HOLD)
+      delay = DTVLOW_RESET_KNOCK_HOLD;
+  }
 
   // 1.) RST=0
   dtvlow_rst(0);
@@ -73,10 +81,13 @@ void dtvlow_reset_dtv(uint8_t mode)
   dtvlow_ack(1);
 }
 
-static uint8_t wait_ack(uint8_t wait_value)
+static uint8_t wait_ack(uint8_t wait_value,uint8_t phase)
 {
   uint8_t status = 0;
 
+#if defined(USE_STATS) && defined(USE_HIRES_TIMER)
+  uint32_t stamp = timer_hires();
+#endif
   timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_DTVLOW_WAIT_FOR_ACK_DELAY));
   while(!timer_expired(&t)) {
     uint8_t value = dtvlow_ack_get();
@@ -85,6 +96,24 @@ static uint8_t wait_ack(uint8_t wait_value)
       break;
     }
   }
+
+#if defined(USE_STATS) && defined(USE_HIRES_TIMER)
+  uint16_t us = timer_hires_us(stamp);
+  STATS_ADD(STATS_ACK_WAIT_US,us);
+  STATS_MAX(STATS_ACK_MAX_US,us);
+#ifdef USE_ACK_HIST
+  if(status)
+    stats_ack_sample(phase,us);
+#endif
+#endif
+  return status;
+}
+
+// count a missing ack of the given phase
+static uint8_t noack(uint8_t status)
+{
+  STATS_INC(STATS_NOACK1 + status - TRANSFER_ERROR_DTVLOW_NOACK1);
+  TRACE(TRACE_NOACK,status);
   return status;
 }
 
@@ -137,12 +166,12 @@ uint8_t dtvlow_is_alive(uint16_t timeout)
   return TRANSFER_ERROR_NOT_ALIVE;
 }
 
-uint8_t dtvlow_send_byte(uint8_t byte)
+static uint8_t send_byte(uint8_t byte)
 {
 
 #if 0
   // make sure ack is high
-  if(!wait_ack(1))
+  if(!wait_ack(1,0))
     return TRANSFER_ERROR_DTVLOW_BEGIN;
 #endif
 
@@ -150,38 +179,47 @@ uint8_t dtvlow_send_byte(uint8_t byte)
   dtvlow_data(byte>>5);
   dtvlow_clk(0);
 
-  if(!wait_ack(0))
-    return TRANSFER_ERROR_DTVLOW_NOACK1;
+  if(!wait_ack(0,0))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK1);
 
   // bit 4-2
   // set dx and clk=1
   dtvlow_data(byte>>2);
   dtvlow_clk(1);
 
-  if(!wait_ack(1))
-    return TRANSFER_ERROR_DTVLOW_NOACK2;
+  if(!wait_ack(1,1))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK2);
 
   // bit 1-0
   // set dx and clk=0
   dtvlow_data(byte & 0x03);
   dtvlow_clk(0);
 
-  if(!wait_ack(0))
-    return TRANSFER_ERROR_DTVLOW_NOACK3;
+  if(!wait_ack(0,2))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK3);
 
   // finally dx=1, clk=1
   dtvlow_data(0b111);
   dtvlow_clk(1);
 
-  if(!wait_ack(1))
-    return TRANSFER_ERROR_DTVLOW_NOACK4;
+  if(!wait_ack(1,3))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK4);
 
+  STATS_INC(STATS_DTV_TX_BYTES);
   return TRANSFER_OK;
 }
 
+uint8_t dtvlow_send_byte(uint8_t byte)
+{
+  PROF_ENTER(PROF_DTV_SEND_BYTE);
+  uint8_t result = send_byte(byte);
+  PROF_EXIT(PROF_DTV_SEND_BYTE);
+  return result;
+}
+
 #define DELAY_FOR_RECV dtvlow_recv_delay(delay);
 
-uint8_t dtvlow_recv_byte(uint8_t *byte)
+static uint8_t recv_byte(uint8_t *byte)
 {
   uint8_t value;
   uint8_t delay = PARAM_BYTE(PARAM_BYTE_DTVLOW_RECV_DELAY);
@@ -191,8 +229,8 @@ uint8_t dtvlow_recv_byte(uint8_t *byte)
   // bit 7-5
   // clk=0
   dtvlow_clk(0);
-  if(!wait_ack(0))
-    return TRANSFER_ERROR_DTVLOW_NOACK1;
+  if(!wait_ack(0,0))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK1);
   DELAY_FOR_RECV;
   value = dtvlow_data_get();
   *byte |= (value << 5);
@@ -200,8 +238,8 @@ uint8_t dtvlow_recv_byte(uint8_t *byte)
   // bit 4-2
   // clk=1
   dtvlow_clk(1);
-  if(!wait_ack(1))
-    return TRANSFER_ERROR_DTVLOW_NOACK2;
+  if(!wait_ack(1,1))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK2);
   DELAY_FOR_RECV;
   value = dtvlow_data_get();
   *byte |= (value << 2);
@@ -209,20 +247,29 @@ uint8_t dtvlow_recv_byte(uint8_t *byte)
   // bit 1-0
   // clk=0
   dtvlow_clk(0);
-  if(!wait_ack(0))
-    return TRANSFER_ERROR_DTVLOW_NOACK3;
+  if(!wait_ack(0,2))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK3);
   DELAY_FOR_RECV;
   value = dtvlow_data_get();
   *byte |= (value & 0x3);
 
   // finally, clk=1
   dtvlow_clk(1);
-  if(!wait_ack(1))
-    return TRANSFER_ERROR_DTVLOW_NOACK4;
+  if(!wait_ack(1,3))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK4);
 
+  STATS_INC(STATS_DTV_RX_BYTES);
   return TRANSFER_OK;
 }
 
+uint8_t dtvlow_recv_byte(uint8_t *byte)
+{
+  PROF_ENTER(PROF_DTV_RECV_BYTE);
+  uint8_t result = recv_byte(byte);
+  PROF_EXIT(PROF_DTV_RECV_BYTE);
+  return result;
+}
+
 #ifdef USE_BOOT
 
 uint8_t dtvlow_send_byte_boot(uint8_t byte)
@@ -231,30 +278,31 @@ uint8_t dtvlow_send_byte_boot(uint8_t byte)
   dtvlow_data(byte>>6);
   dtvlow_clk(0);
 
-  if(!wait_ack(0))
-    return TRANSFER_ERROR_DTVLOW_NOACK1;
+  if(!wait_ack(0,0))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK1);
 
   // bit 5-4 clk=1
   dtvlow_data((byte>>4) & 0x03);
   dtvlow_clk(1);
 
-  if(!wait_ack(1))
-    return TRANSFER_ERROR_DTVLOW_NOACK2;
+  if(!wait_ack(1,1))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK2);
 
   // bit 3-2 clk=0
   dtvlow_data((byte>>2) & 0x03);
   dtvlow_clk(0);
 
-  if(!wait_ack(0))
-    return TRANSFER_ERROR_DTVLOW_NOACK3;
+  if(!wait_ack(0,2))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK3);
 
   // bit 1-0 clk=1
   dtvlow_data(byte & 0x03);
   dtvlow_clk(1);
 
-  if(!wait_ack(1))
-    return TRANSFER_ERROR_DTVLOW_NOACK4;
+  if(!wait_ack(1,3))
+    return noack(TRANSFER_ERROR_DTVLOW_NOACK4);
 
+  STATS_INC(STATS_DTV_TX_BYTES);
   return TRANSFER_OK;
 }
 
@@ -57,13 +57,19 @@
 #define DTVLOW_RESET_NORMAL            0x00
 #define DTVLOW_RESET_ENTER_DTVTRANS    0x01
 #define DTVLOW_RESET_BYPASS_DTVMON     0x02
+// flag: wait until dtvtrans is ready instead of a fixed delay
+#define DTVLOW_RESET_WAIT_READY        0x80
+// time in ms the knock is held after reset with wait ready. dtvmon samples
+// it right after boot, the rest of the reset delay is spent probing
+#define DTVLOW_RESET_KNOCK_HOLD        100
 
 // ----- low level dtvtrans -----
 
 // startup state
 void dtvlow_state_clear(void);
 
-// perform a reset of the dtv. if knock=1 then enter dtvtrans
+// perform a reset of the dtv. if knock=1 then enter dtvtrans. with wait
+// ready the knock is only held for DTVLOW_RESET_KNOCK_HOLD
 void dtvlow_reset_dtv(uint8_t mode);
 
 // send a byte. returns true if got ack
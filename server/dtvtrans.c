@@ -204,6 +204,52 @@ uint8_t dtvtrans_recv_mem_block(void)
     return TRANSFER_ERROR_DTVTRANS_CHECKSUM;
 }
 
+// ----- send and verify mem block -----
+
+#ifdef USE_MEMCMD
+
+static uint8_t skip_byte(uint8_t *data)
+{
+  return TRANSFER_OK;
+}
+
+static host_transfer_funcs_t skip_host_funcs =
+{
+  .transfer_byte  = skip_byte
+};
+
+uint8_t dtvtrans_send_verify_mem_block(void)
+{
+  // send block and keep its crc16
+  uint16_t crc16 = dtv_transfer_state.crc16;
+  uint8_t status = dtvtrans_send_mem_block();
+  if(status!=TRANSFER_OK)
+    return status;
+  uint16_t sent_crc16 = dtv_transfer_state.crc16;
+  uint16_t sent_length = dtv_transfer_state.transfer_length;
+
+  // read it back without passing the data to the host
+  host_transfer_funcs_t *host_funcs = current_host_transfer_funcs;
+  current_host_transfer_funcs = &skip_host_funcs;
+  dtv_transfer_state.crc16 = crc16;
+  status = dtvtrans_recv_mem_block();
+  current_host_transfer_funcs = host_funcs;
+
+  // report the sent block to the host check
+  uint16_t read_crc16 = dtv_transfer_state.crc16;
+  dtv_transfer_state.crc16 = sent_crc16;
+  dtv_transfer_state.transfer_length = sent_length;
+
+  if(status!=TRANSFER_OK)
+    return status;
+  else if(read_crc16==sent_crc16)
+    return TRANSFER_OK;
+  else
+    return TRANSFER_ERROR_VERIFY_MISMATCH;
+}
+
+#endif
+
 // ----- execute mem -----
 
 #ifdef USE_OLDCMD
@@ -35,6 +35,11 @@ uint8_t dtvtrans_recv_mem_block(void);
 // send a mem block to dtv. returns status
 uint8_t dtvtrans_send_mem_block(void);
 
+#ifdef USE_MEMCMD
+// send a mem block to dtv and read it back to compare the crc16. returns status
+uint8_t dtvtrans_send_verify_mem_block(void);
+#endif
+
 #ifdef USE_OLDCMD
 // execute mem. returns status
 uint8_t dtvtrans_exec_mem(uint16_t addr);
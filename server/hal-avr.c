@@ -1,6 +1,7 @@
 
 #include <stdint.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 
 #include "board.h"
@@ -83,6 +84,18 @@ void dtvlow_recv_delay(uint8_t delay)
   _delay_loop_1(delay);
 }
 
+uint8_t hal_irq_disable(void)
+{
+  uint8_t sreg = SREG;
+  cli();
+  return sreg;
+}
+
+void hal_irq_restore(uint8_t state)
+{
+  SREG = state;
+}
+
 #ifdef USE_JOYSTICK
 
 void joy_begin(void)
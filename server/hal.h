@@ -14,6 +14,10 @@ uint8_t dtvlow_data_get(void);
 
 void dtvlow_recv_delay(uint8_t delay);
 
+// disable interrupts and return the previous state for restore
+uint8_t hal_irq_disable(void);
+void hal_irq_restore(uint8_t state);
+
 #define JOY_MASK        0x1f
 
 #define JOY_MASK_UP     0x01
@@ -0,0 +1,42 @@
+/*
+ * eeprom.h - avr-libc eeprom api for the host build
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+// EEMEM variables are plain memory on the host
+
+#ifndef _AVR_EEPROM_H_
+#define _AVR_EEPROM_H_
+
+#include <string.h>
+
+#define EEMEM
+
+#define eeprom_is_ready()                 1
+#define eeprom_read_block(dst,src,n)      memcpy((dst),(src),(n))
+#define eeprom_write_block(src,dst,n)     memcpy((dst),(src),(n))
+#define eeprom_read_word(addr)            (*(addr))
+#define eeprom_write_word(addr,val)       (*(addr) = (val))
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * hal-host.c - uart and timer of the host build
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "board.h"
+
+#include "uart.h"
+#include "timer.h"
+
+// ----- uart -----
+// reads come from a fed buffer and never wait. sends are collected
+
+#define HOST_UART_SIZE 1024
+
+static uint8_t rx_buf[HOST_UART_SIZE];
+static uint16_t rx_pos;
+static uint16_t rx_len;
+static uint8_t tx_buf[HOST_UART_SIZE];
+static uint16_t tx_len;
+
+void host_uart_feed(const uint8_t *data,uint16_t len)
+{
+  if(len > HOST_UART_SIZE - rx_len)
+    len = HOST_UART_SIZE - rx_len;
+  memcpy(rx_buf + rx_len,data,len);
+  rx_len += len;
+}
+
+uint16_t host_uart_output(uint8_t **data)
+{
+  *data = tx_buf;
+  return tx_len;
+}
+
+void host_uart_clear_output(void)
+{
+  tx_len = 0;
+}
+
+void uart_init(void)
+{
+  rx_pos = rx_len = tx_len = 0;
+}
+
+uint8_t uart_read_data_available(void)
+{
+  return rx_pos < rx_len;
+}
+
+void uart_stop_reception(void)
+{
+}
+
+void uart_start_reception(void)
+{
+  // clear buffer
+  rx_pos = rx_len = 0;
+}
+
+uint8_t uart_read(uint8_t *data)
+{
+  if(rx_pos == rx_len)
+    return 0;
+  *data = rx_buf[rx_pos++];
+  return 1;
+}
+
+uint8_t uart_send(uint8_t data)
+{
+  if(tx_len == HOST_UART_SIZE)
+    return 0;
+  tx_buf[tx_len++] = data;
+  return 1;
+}
+
+// ----- timer -----
+// monotonic host clock
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void timer_init(void)
+{
+}
+
+uint16_t timer_now(void)
+{
+  return (uint16_t)(now_ns() / 1000000);
+}
+
+void timer_delay_1ms(uint16_t timeout)
+{
+  uint16_t start = timer_now();
+  while((uint16_t)(timer_now()-start)<timeout);
+}
+
+uint8_t timer_expired(timeout_t *t)
+{
+  return (uint16_t)(timer_now() - t->start) > t->timeout;
+}
+
+uint32_t timer_us(void)
+{
+  return (uint32_t)(now_ns() / 1000);
+}
+
+uint32_t timer_hires(void)
+{
+  return (uint32_t)now_ns();
+}
+
+uint16_t timer_hires_us(uint32_t start)
+{
+  uint32_t us = ((uint32_t)now_ns() - start) / 1000;
+  if(us > 0xffff)
+    return 0xffff;
+  return (uint16_t)us;
+}
@@ -0,0 +1,55 @@
+/*
+ * host.h - host build of the portable firmware modules
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+// Board header for compiling cmdline.c, util.c, param.c, transfer.c and
+// uartutil.c on the host (see 'make hosttest'). LEDs and flow control do
+// nothing, the uart and timer of hal-host.c work on memory buffers and
+// the host clock.
+
+#ifndef HOSTBOARD_H
+#define HOSTBOARD_H
+
+// ----- LEDs -----
+#define led_ready_on()
+#define led_ready_off()
+#define led_error_on()
+#define led_error_off()
+#define led_transmit_on()
+#define led_transmit_off()
+
+// ----- RTS & CTS -----
+#define uart_set_cts(on)
+#define uart_get_rts()      1
+#define uart_init_extra()
+
+// ----- host uart -----
+// queue bytes for uart_read()
+void host_uart_feed(const uint8_t *data,uint16_t len);
+// bytes sent with uart_send() since the last clear
+uint16_t host_uart_output(uint8_t **data);
+void host_uart_clear_output(void);
+
+#endif
@@ -0,0 +1,542 @@
+/*
+ * hosttest.c - unit tests and benchmarks of the host build
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+// Unit tests of the command line parser, hex conversion, parameters and
+// the transfer loop followed by microbenchmarks of the parse cost per
+// command and the transfer loop overhead per byte. Benchmarks take the
+// best of several runs. Limits given with -p and -t make them fail.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <util/crc16.h>
+
+#include "board.h"
+
+#include "cmdline.h"
+#include "cmdtable.h"
+#include "param.h"
+#include "transfer.h"
+#include "uart.h"
+#include "util.h"
+
+// ----- checks -----
+
+static int num_checks;
+static int num_failed;
+
+#define CHECK(cond)  check((cond),#cond,__LINE__)
+
+static int check(int ok,const char *what,int line)
+{
+  num_checks++;
+  if(!ok) {
+    num_failed++;
+    printf("  FAILED line %d: %s\n",line,what);
+  }
+  return ok;
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// ----- command table -----
+// same patterns as cmdtable.c. executed commands keep their arguments
+
+static cmdline_args_t exec_args;
+static int exec_count;
+
+static void exec_test(void)
+{
+  exec_args = cmdline_args;
+  exec_count++;
+}
+
+command_t command_table[] = {
+  COMMAND("rp","btb",exec_test),
+  COMMAND("r","btt",exec_test),
+  COMMAND("wp","bt*",exec_test),
+  COMMAND("w","btt",exec_test),
+  COMMAND("t",0,exec_test),
+  COMMAND("cs","bbbbbbbbw",exec_test),
+  COMMAND("v",0,exec_test),
+  COMMAND("pws","bw",exec_test),
+  COMMAND("pwg","b",exec_test),
+  END_OF_COMMAND
+};
+
+// feed a line and return the status replied by the parser
+static int run_line(const char *line)
+{
+  uint8_t *out;
+  host_uart_clear_output();
+  host_uart_feed((const uint8_t *)line,strlen(line));
+  host_uart_feed((const uint8_t *)"\r",1);
+  cmdline_handle();
+  uint16_t len = host_uart_output(&out);
+  if((len!=4)||(out[2]!='\r')||(out[3]!='\n'))
+    return -1;
+  uint8_t status;
+  if(!parse_byte(out,&status))
+    return -1;
+  return status;
+}
+
+// ----- tests -----
+
+static void test_hex(void)
+{
+  uint8_t buf[8];
+  uint8_t b;
+  uint16_t w;
+  uint32_t d;
+
+  for(int i=0;i<256;i++) {
+    byte_to_hex(i,buf);
+    if(!CHECK(parse_byte(buf,&b) && (b==i)))
+      break;
+  }
+  byte_to_hex(0xa5,buf);
+  CHECK(memcmp(buf,"A5",2)==0);
+  word_to_hex(0x12ab,buf);
+  CHECK(memcmp(buf,"12AB",4)==0);
+  dword_to_hex6(0x0fedcb,buf);
+  CHECK(memcmp(buf,"0FEDCB",6)==0);
+  dword_to_hex(0xdeadbeef,buf);
+  CHECK(memcmp(buf,"DEADBEEF",8)==0);
+
+  CHECK(parse_byte((uint8_t *)"fF",&b) && (b==0xff));
+  CHECK(parse_word((uint8_t *)"c0De",&w) && (w==0xc0de));
+  CHECK(parse_dword6((uint8_t *)"1fffff",&d) && (d==0x1fffff));
+  CHECK(!parse_byte((uint8_t *)"0g",&b));
+  CHECK(!parse_byte((uint8_t *)" 1",&b));
+  CHECK(!parse_word((uint8_t *)"123",&w));
+  CHECK(!parse_dword6((uint8_t *)"12345:",&d));
+}
+
+typedef struct {
+  const char *line;
+  int status;
+  uint8_t num_byte;
+  uint8_t num_word;
+  uint8_t num_dword;
+} parse_case_t;
+
+static const parse_case_t parse_cases[] = {
+  { "v",                    CMDLINE_STATUS_OK,              0,0,0 },
+  { "v 00",                 CMDLINE_ERROR_NO_ARGS_ALLOWED,  0,0,0 },
+  { "r00000000000010",      CMDLINE_STATUS_OK,              1,0,2 },
+  { "r 01 004000 000100 ",  CMDLINE_STATUS_OK,              1,0,2 },
+  { "rp01000010 10",        CMDLINE_STATUS_OK,              2,0,1 },
+  { "r00",                  CMDLINE_ERROR_TOO_FEW_ARGS,     0,0,0 },
+  { "r0",                   CMDLINE_ERROR_ARG_TOO_SHORT,    0,0,0 },
+  { "r00 00000",            CMDLINE_ERROR_ARG_TOO_SHORT,    0,0,0 },
+  { "r00 00x000 000000",    CMDLINE_ERROR_NO_HEX_ARG,       0,0,0 },
+  { "r00000000000010 00",   CMDLINE_ERROR_TOO_MANY_ARGS,    0,0,0 },
+  { "wp00001000",           CMDLINE_STATUS_OK,              1,0,1 },
+  { "wp00001000 01 02 03",  CMDLINE_STATUS_OK,              4,0,1 },
+  { "wp000010000102030405060708090a0b0c0d0e",
+                            CMDLINE_STATUS_OK,             15,0,1 },
+  { "cs0000000000000000 1234", CMDLINE_STATUS_OK,           8,1,0 },
+  { "pws070400",            CMDLINE_STATUS_OK,              1,1,0 },
+  { "pw",                   CMDLINE_ERROR_UNKNOWN_COMMAND,  0,0,0 },
+  { "zz",                   CMDLINE_ERROR_UNKNOWN_COMMAND,  0,0,0 },
+  { "0123456789012345678901234567890123456789",
+                            CMDLINE_ERROR_LINE_TOO_LONG,    0,0,0 },
+  { 0 }
+};
+
+static void test_cmdline(void)
+{
+  for(const parse_case_t *c=parse_cases;c->line;c++) {
+    int count = exec_count;
+    int status = run_line(c->line);
+    if(!CHECK(status==c->status)) {
+      printf("    '%s' -> %d\n",c->line,status);
+      continue;
+    }
+    if(c->status!=CMDLINE_STATUS_OK) {
+      CHECK(exec_count==count);
+      continue;
+    }
+    CHECK(exec_count==count+1);
+    CHECK(exec_args.num_byte==c->num_byte);
+    CHECK(exec_args.num_word==c->num_word);
+    CHECK(exec_args.num_dword==c->num_dword);
+  }
+
+  // argument values
+  run_line("r 01 004000 000100");
+  CHECK(exec_args.arg_byte[0]==0x01);
+  CHECK(exec_args.arg_dword[0]==0x004000);
+  CHECK(exec_args.arg_dword[1]==0x000100);
+  run_line("cs0102030405060708 abcd");
+  CHECK(exec_args.arg_byte[7]==0x08);
+  CHECK(exec_args.arg_word[0]==0xabcd);
+
+  // commands match by prefix in table order
+  run_line("rp01000010 10");
+  CHECK(exec_args.arg_byte[1]==0x10);
+
+  // erase and empty lines
+  host_uart_clear_output();
+  host_uart_feed((const uint8_t *)"\r\nvx\x08\r",6);
+  cmdline_handle();
+  uint8_t *out;
+  CHECK(host_uart_output(&out)==4);
+  CHECK(memcmp(out,"00\r\n",4)==0);
+}
+
+extern parameters_t eeprom_parameters;
+
+static void test_param(void)
+{
+  // empty eeprom has no valid crc
+  memset(&eeprom_parameters,0,sizeof(eeprom_parameters));
+  param_init();
+  CHECK(PARAM_WORD(PARAM_WORD_DTV_TRANSFER_BLOCK_SIZE)==0x400);
+  CHECK(PARAM_BYTE(PARAM_BYTE_ERROR_CONDITION_LOOPS)==5);
+
+  // save, reset and load
+  PARAM_WORD(PARAM_WORD_DTV_TRANSFER_BLOCK_SIZE) = 0x100;
+  PARAM_BYTE(PARAM_BYTE_DIAGNOSE_PATTERN) = 0x5a;
+  CHECK(param_save()==PARAM_OK);
+  param_reset();
+  CHECK(PARAM_WORD(PARAM_WORD_DTV_TRANSFER_BLOCK_SIZE)==0x400);
+  CHECK(param_load()==PARAM_OK);
+  CHECK(PARAM_WORD(PARAM_WORD_DTV_TRANSFER_BLOCK_SIZE)==0x100);
+  CHECK(PARAM_BYTE(PARAM_BYTE_DIAGNOSE_PATTERN)==0x5a);
+
+  // a corrupted eeprom is rejected
+  eeprom_parameters.param_8[0] ^= 1;
+  CHECK(param_load()==PARAM_EEPROM_CRC_MISMATCH);
+  CHECK(PARAM_BYTE(PARAM_BYTE_DIAGNOSE_PATTERN)==0x5a);
+
+  param_reset();
+}
+
+// ----- transfer -----
+// dtv memory read into a host buffer with block recording
+
+#define MEM_SIZE    0x10000
+#define MAX_BLOCKS  16
+
+static uint8_t mem[MEM_SIZE];
+static uint8_t host_buf[MEM_SIZE];
+static uint32_t host_pos;
+static uint16_t host_crc16;
+static uint32_t begin_length;
+static uint8_t end_status;
+static int fail_block;
+static int fail_check;
+
+static dtv_transfer_state_t blocks[MAX_BLOCKS];
+static int num_blocks;
+
+static uint8_t mem_recv_block(void)
+{
+  dtv_transfer_state_t *s = &dtv_transfer_state;
+  if(num_blocks<MAX_BLOCKS)
+    blocks[num_blocks] = *s;
+  if(++num_blocks==fail_block)
+    return TRANSFER_ERROR_DTVTRANS_CHECKSUM;
+
+  uint32_t addr = ((uint32_t)s->bank << 14 | s->offset) & (MEM_SIZE-1);
+  uint16_t crc16 = s->crc16;
+  uint16_t i;
+  for(i=0;i<s->length;i++) {
+    uint8_t data = mem[(addr + i) & (MEM_SIZE-1)];
+    uint8_t result = current_host_transfer_funcs->transfer_byte(&data);
+    if(result!=TRANSFER_OK)
+      break;
+    crc16 = _crc16_update(crc16,data);
+  }
+  s->transfer_length = i;
+  s->crc16 = crc16;
+  return TRANSFER_OK;
+}
+
+static uint8_t buf_begin_transfer(uint32_t length)
+{
+  begin_length = length;
+  host_pos = 0;
+  host_crc16 = 0xffff;
+  return TRANSFER_OK;
+}
+
+static uint8_t buf_end_transfer(uint8_t status)
+{
+  end_status = status;
+  return status;
+}
+
+static uint8_t buf_check_block(uint16_t crc16)
+{
+  uint8_t ok = (crc16==host_crc16) && (!fail_check || (num_blocks!=fail_check));
+  host_crc16 = 0xffff;
+  return ok ? TRANSFER_OK : TRANSFER_ERROR_CRC16_MISMATCH;
+}
+
+static uint8_t buf_write_byte(uint8_t *data)
+{
+  host_buf[host_pos++ & (MEM_SIZE-1)] = *data;
+  host_crc16 = _crc16_update(host_crc16,*data);
+  return TRANSFER_OK;
+}
+
+static host_transfer_funcs_t buf_funcs = {
+  .begin_transfer = buf_begin_transfer,
+  .end_transfer   = buf_end_transfer,
+  .check_block    = buf_check_block,
+  .transfer_byte  = buf_write_byte
+};
+
+static void transfer_setup(void)
+{
+  current_host_transfer_funcs = &buf_funcs;
+  current_dtv_transfer_block_func = mem_recv_block;
+  num_blocks = 0;
+  fail_block = 0;
+  fail_check = 0;
+}
+
+static int check_block(int n,uint8_t bank,uint16_t offset,uint16_t length)
+{
+  dtv_transfer_state_t *b = &blocks[n];
+  return (b->bank==bank) && (b->offset==offset) && (b->length==length);
+}
+
+static void test_transfer(void)
+{
+  for(uint32_t i=0;i<MEM_SIZE;i++)
+    mem[i] = (uint8_t)(i ^ (i >> 8));
+
+  // blocks are split at bank boundaries
+  transfer_setup();
+  CHECK(transfer_mem(0,0x3f00,0x300,0x400)==TRANSFER_OK);
+  CHECK(num_blocks==2);
+  CHECK(check_block(0,0,0x3f00,0x100));
+  CHECK(check_block(1,1,0x0000,0x200));
+  CHECK(begin_length==0x300);
+  CHECK(end_status==TRANSFER_OK);
+  CHECK(transfer_state.length==0x300);
+  CHECK(transfer_state.result==TRANSFER_OK);
+  CHECK(memcmp(host_buf,mem+0x3f00,0x300)==0);
+
+  // and at the block size
+  transfer_setup();
+  CHECK(transfer_mem(0,0x0000,0x250,0x100)==TRANSFER_OK);
+  CHECK(num_blocks==3);
+  CHECK(check_block(2,0,0x0200,0x050));
+
+  // dtv error stops after the first block
+  transfer_setup();
+  fail_block = 2;
+  CHECK(transfer_mem(0,0x0000,0x300,0x100)==TRANSFER_ERROR_DTVTRANS_CHECKSUM);
+  CHECK(num_blocks==2);
+  CHECK(end_status==TRANSFER_ERROR_DTVTRANS_CHECKSUM);
+  CHECK(transfer_state.length==0x100);
+
+  // host check fails
+  transfer_setup();
+  fail_check = 1;
+  CHECK(transfer_mem(0,0x0000,0x300,0x100)==TRANSFER_ERROR_CRC16_MISMATCH);
+  CHECK(num_blocks==1);
+  CHECK(transfer_state.length==0);
+
+  // list of ranges in one transfer
+  transfer_range_t ranges[2] = {
+    { 0, 0x0100, 0x80 },
+    { 1, 0x7ff0, 0x20 }
+  };
+  transfer_setup();
+  CHECK(transfer_mem_list(ranges,2,0x400)==TRANSFER_OK);
+  CHECK(begin_length==0xa0);
+  CHECK(num_blocks==3);
+  CHECK(check_block(0,0,0x0100,0x80) && (blocks[0].mode==0));
+  CHECK(check_block(1,1,0x3ff0,0x10) && (blocks[1].mode==1));
+  CHECK(check_block(2,2,0x0000,0x10) && (blocks[2].mode==1));
+  CHECK(transfer_state.length==0xa0);
+  CHECK(memcmp(host_buf+0x80,mem+0x7ff0,0x20)==0);
+
+  // diagnose: pattern from dtv-only host funcs
+  current_host_transfer_funcs = &diagnose_host_transfer_funcs;
+  current_dtv_transfer_block_func = diagnose_dtv_send_block;
+  diagnose_host_mode = DIAGNOSE_HOST_MODE_READ;
+  CHECK(transfer_mem(0,0,0x1000,0x400)==TRANSFER_OK);
+  CHECK(transfer_state.length==0x1000);
+
+  // diagnose: pattern of the dtv checked by the host
+  transfer_setup();
+  current_dtv_transfer_block_func = diagnose_dtv_recv_block;
+  CHECK(transfer_mem(0,0,0x500,0x400)==TRANSFER_OK);
+  CHECK(transfer_state.length==0x500);
+  uint8_t pattern = PARAM_BYTE(PARAM_BYTE_DIAGNOSE_PATTERN);
+  CHECK((host_buf[0]==pattern)&&(host_buf[0x4ff]==pattern));
+}
+
+// ----- benchmarks -----
+
+#define BENCH_RUNS 5
+
+static uint32_t max_parse_ns;
+static uint32_t max_byte_ns;
+
+// best time in ns of func(n) over several runs
+static double bench(void (*func)(uint32_t),uint32_t n)
+{
+  uint64_t best = 0;
+  for(int i=0;i<BENCH_RUNS;i++) {
+    uint64_t start = now_ns();
+    func(n);
+    uint64_t t = now_ns() - start;
+    if((i==0)||(t<best))
+      best = t;
+  }
+  return (double)best / n;
+}
+
+static void report(const char *what,double ns,const char *unit,uint32_t limit)
+{
+  int over = (limit!=0) && (ns>limit);
+  printf("  %-36s %10.1f %s%s\n",what,ns,unit,over ? "  TOO SLOW" : "");
+  if(over)
+    num_failed++;
+}
+
+static const char *bench_line;
+
+static void bench_parse_line(uint32_t n)
+{
+  uint16_t len = strlen(bench_line);
+  for(uint32_t i=0;i<n;i++) {
+    host_uart_clear_output();
+    host_uart_feed((const uint8_t *)bench_line,len);
+    cmdline_handle();
+  }
+}
+
+static const char *bench_lines[] = {
+  "v\r",
+  "t\r",
+  "pws070400\r",
+  "r00000000001000\r",
+  "r 00 000000 001000\r",
+  "wp000000 01 02 03 04 05 06 07 08\r",
+  "cs0000000000000000 1234\r",
+  "zz\r",
+  0
+};
+
+static volatile uint8_t sink;
+
+static void bench_hex(uint32_t n)
+{
+  uint8_t buf[8];
+  uint8_t b;
+  uint32_t d;
+  for(uint32_t i=0;i<n;i++) {
+    dword_to_hex6(i,buf);
+    parse_dword6(buf,&d);
+    byte_to_hex((uint8_t)d,buf);
+    parse_byte(buf,&b);
+    sink = b;
+  }
+}
+
+static void bench_transfer_diagnose(uint32_t n)
+{
+  current_host_transfer_funcs = &diagnose_host_transfer_funcs;
+  current_dtv_transfer_block_func = diagnose_dtv_send_block;
+  diagnose_host_mode = DIAGNOSE_HOST_MODE_READ;
+  transfer_mem(0,0,n,0x400);
+}
+
+static void bench_transfer_mem(uint32_t n)
+{
+  transfer_setup();
+  transfer_mem(0,0,n,0x400);
+}
+
+static void run_benchmarks(void)
+{
+  char what[64];
+
+  printf("--- parse cost per command ---\n");
+  for(int i=0;bench_lines[i];i++) {
+    bench_line = bench_lines[i];
+    snprintf(what,sizeof(what),"%.*s",(int)strlen(bench_line)-1,bench_line);
+    report(what,bench(bench_parse_line,200000),"ns/cmd",max_parse_ns);
+  }
+
+  printf("--- hex conversion ---\n");
+  report("dword6+byte to hex and back",bench(bench_hex,1000000),"ns/op",0);
+
+  printf("--- transfer loop overhead ---\n");
+  report("diagnose host and dtv",bench(bench_transfer_diagnose,0x100000),"ns/byte",max_byte_ns);
+  report("memory dtv, buffer host",bench(bench_transfer_mem,0x100000),"ns/byte",max_byte_ns);
+}
+
+// ----- main -----
+
+int main(int argc,char **argv)
+{
+  int benchmarks = 1;
+  int c;
+  while((c=getopt(argc,argv,"np:t:"))!=-1) {
+    switch(c) {
+    case 'n': benchmarks = 0; break;
+    case 'p': max_parse_ns = atoi(optarg); break;
+    case 't': max_byte_ns = atoi(optarg); break;
+    default:
+      fprintf(stderr,"Usage: hosttest [-n] [-p <max ns/cmd>] [-t <max ns/byte>]\n");
+      return 2;
+    }
+  }
+
+  uart_init();
+  param_init();
+  cmdline_init();
+
+  printf("--- unit tests ---\n");
+  test_hex();
+  test_cmdline();
+  test_param();
+  test_transfer();
+  printf("  %d checks, %d failed\n",num_checks,num_failed);
+
+  if(benchmarks)
+    run_benchmarks();
+
+  return num_failed ? 1 : 0;
+}
@@ -39,7 +39,201 @@
 
 #ifdef USE_JOYSTICK
 
+#ifdef USE_JOYBUF
+
 // ----- joy stream -----
+// the stream is filled into a ring buffer and played back from the 100us
+// timer interrupt. a full buffer throttles the host via CTS. a plain
+// stream starts playing immediately, a buffered stream only when the
+// buffer is full or the exit command was received. then host jitter does
+// not change the timing as long as the buffer does not run empty.
+
+#define JOY_BUFFER_MASK     (JOY_BUFFER_SIZE - 1)
+
+#if JOY_BUFFER_SIZE > 256
+typedef uint16_t joy_index_t;
+#else
+typedef uint8_t joy_index_t;
+#endif
+
+#define JOY_STATE_PLAY      0
+#define JOY_STATE_DONE      1
+#define JOY_STATE_ERROR     2
+
+static volatile uint8_t joy_buffer[JOY_BUFFER_SIZE];
+static volatile joy_index_t joy_head; // written by main loop
+static volatile joy_index_t joy_tail; // first byte still needed by player
+static volatile joy_index_t joy_pos;  // next command to play
+static volatile uint8_t joy_state;
+static uint16_t joy_wait;
+
+// repeat of last command
+static uint8_t joy_last;
+static uint8_t joy_repeat;
+
+// loop stack
+static uint8_t joy_depth;
+static joy_index_t joy_loop_pos[JOY_LOOP_DEPTH];
+static uint8_t joy_loop_count[JOY_LOOP_DEPTH];
+
+// called every 100us
+static void joy_tick(void)
+{
+  if(joy_state != JOY_STATE_PLAY)
+    return;
+
+  // still waiting?
+  if(joy_wait > 0) {
+    joy_wait--;
+    if(joy_wait > 0)
+      return;
+  }
+
+  // execute commands until the next wait
+  while(1) {
+    uint8_t cmd;
+    if(joy_repeat > 0) {
+      joy_repeat--;
+      cmd = joy_last;
+    } else {
+      if(joy_pos == joy_head)
+        return;
+      cmd = joy_buffer[joy_pos];
+      joy_pos = (joy_pos + 1) & JOY_BUFFER_MASK;
+      // outside of loops consumed bytes can be refilled
+      if(joy_depth == 0)
+        joy_tail = joy_pos;
+    }
+    uint8_t val = cmd & JOY_MASK;
+
+    switch(cmd & JOY_COMMAND_MASK) {
+    case JOY_COMMAND_OUT:
+      joy_out(val);
+      break;
+    case JOY_COMMAND_WAIT:
+      joy_wait = val * 100;
+      break;
+    case JOY_COMMAND_WAIT_FINE:
+      joy_wait = val;
+      break;
+    case JOY_COMMAND_WAIT_LONG:
+      joy_wait = val * 1000;
+      break;
+    case JOY_COMMAND_REPEAT:
+      joy_repeat = val;
+      continue;
+    case JOY_COMMAND_LOOP:
+      if(joy_depth == JOY_LOOP_DEPTH) {
+        joy_state = JOY_STATE_ERROR;
+        return;
+      }
+      joy_loop_pos[joy_depth] = joy_pos;
+      joy_loop_count[joy_depth] = val;
+      joy_depth++;
+      continue;
+    case JOY_COMMAND_END_LOOP:
+      if(joy_depth == 0) {
+        joy_state = JOY_STATE_ERROR;
+        return;
+      }
+      if(joy_loop_count[joy_depth-1] > 0) {
+        joy_loop_count[joy_depth-1]--;
+        joy_pos = joy_loop_pos[joy_depth-1];
+      } else {
+        joy_depth--;
+        if(joy_depth == 0)
+          joy_tail = joy_pos;
+      }
+      continue;
+    case JOY_COMMAND_EXIT:
+      joy_state = JOY_STATE_DONE;
+      return;
+    }
+
+    // only out and wait commands can be repeated
+    joy_last = cmd;
+    if(joy_wait > 0)
+      return;
+  }
+}
+
+static void joy_stream(uint8_t buffered)
+{
+  uart_start_reception();
+  uart_send(0);
+
+  joy_begin();
+
+  joy_head = 0;
+  joy_tail = 0;
+  joy_pos = 0;
+  joy_wait = 0;
+  joy_last = JOY_COMMAND_OUT;
+  joy_repeat = 0;
+  joy_depth = 0;
+  joy_state = JOY_STATE_PLAY;
+
+  uint8_t command;
+  uint8_t got_exit = 0;
+  uint8_t playing = 0;
+  led_transmit_on();
+  while(joy_state == JOY_STATE_PLAY) {
+    joy_index_t next = (joy_head + 1) & JOY_BUFFER_MASK;
+    uint8_t full = (next == joy_tail);
+
+    // fill buffer
+    if(!got_exit && !full && uart_read(&command)) {
+      joy_buffer[joy_head] = command;
+      joy_head = next;
+      if((command & JOY_COMMAND_MASK) == JOY_COMMAND_EXIT)
+        got_exit = 1;
+      // a plain stream plays as soon as its first command is queued
+      if(!playing && !buffered) {
+        timer_fast_start(joy_tick);
+        playing = 1;
+      }
+    }
+    // start playback of a buffered stream
+    else if(!playing && (full || got_exit)) {
+      timer_fast_start(joy_tick);
+      playing = 1;
+    }
+    // a loop body that does not fit into the buffer never completes
+    else if(playing && full && (joy_pos == joy_head)) {
+      joy_state = JOY_STATE_ERROR;
+    }
+  }
+  timer_fast_stop();
+
+  uint8_t result = (joy_state == JOY_STATE_DONE) ? JOY_COMMAND_OK : JOY_COMMAND_ERROR;
+
+  joy_out(0);
+  joy_end();
+
+  uart_send(result);
+  uart_stop_reception();
+
+  led_transmit_off();
+
+  if(result!=JOY_COMMAND_OK)
+    error_condition();
+}
+
+void exec_joy_stream(void)
+{
+  joy_stream(0);
+}
+
+void exec_joy_buffered_stream(void)
+{
+  joy_stream(1);
+}
+
+#else
+
+// ----- joy stream -----
+// without the timer player the stream is played while it is received and
+// only the out, wait and exit commands are supported
 
 static uint8_t command;
 static uint8_t value;
@@ -101,3 +295,5 @@ void exec_joy_stream(void)
 }
 
 #endif
+
+#endif
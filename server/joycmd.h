@@ -31,14 +31,30 @@
 #include "command.h"
 
 void exec_joy_stream(void);
+#ifdef USE_JOYBUF
+void exec_joy_buffered_stream(void);
+#endif
 
-#define JOY_COMMAND_MASK    0xe0
+#define JOY_COMMAND_MASK      0xe0
 
-#define JOY_COMMAND_EXIT    0x80
-#define JOY_COMMAND_WAIT    0x20
-#define JOY_COMMAND_OUT     0x00
+#define JOY_COMMAND_REPEAT    0xe0  // play last out/wait <value> more times
+#define JOY_COMMAND_END_LOOP  0xc0  // end of loop block
+#define JOY_COMMAND_LOOP      0xa0  // loop block <value> more times
+#define JOY_COMMAND_EXIT      0x80
+#define JOY_COMMAND_WAIT_LONG 0x60  // wait <value> * 100ms
+#define JOY_COMMAND_WAIT_FINE 0x40  // wait <value> * 100us
+#define JOY_COMMAND_WAIT      0x20  // wait <value> * 10ms
+#define JOY_COMMAND_OUT       0x00
 
 #define JOY_COMMAND_OK      0
 #define JOY_COMMAND_ERROR   1
 
+// ring buffer of buffered joy stream (power of 2)
+#ifndef JOY_BUFFER_SIZE
+#define JOY_BUFFER_SIZE     128
+#endif
+
+// max nesting of loop blocks
+#define JOY_LOOP_DEPTH      2
+
 #endif
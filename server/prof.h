@@ -0,0 +1,79 @@
+/*
+ * prof.h - cycle profiler of the firmware hot paths
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+// ----- profiled functions -----
+#define PROF_DTV_SEND_BYTE      0
+#define PROF_DTV_RECV_BYTE      1
+#define PROF_UART_READ          2
+#define PROF_UART_SEND          3
+#define PROF_TRANSFER_MEM       4
+#define PROF_CMDLINE_HANDLE     5
+
+#define PROF_NUM                6
+
+// flags of profile command
+#define PROF_FLAG_RESET         0x01
+
+// Times are cycles of timer_hires() between enter and exit and include
+// all nested calls (e.g. transfer_mem contains dtvlow and uart). This
+// needs a linear cycle counter so only the ARM port (DWT) supports it.
+
+typedef struct {
+  uint32_t calls;
+  uint64_t cycles;
+  // longest single call
+  uint32_t max;
+} prof_entry_t;
+
+#ifdef USE_PROF
+
+#ifndef USE_HIRES_TIMER
+#error "USE_PROF needs USE_HIRES_TIMER"
+#endif
+
+extern prof_entry_t prof[PROF_NUM];
+
+// account a call of the given cycles
+void prof_add(uint8_t id,uint32_t cycles);
+// reset all entries
+void prof_reset(void);
+// timer_hires() ticks per us
+uint8_t prof_ticks_per_us(void);
+
+#define PROF_ENTER(id)    uint32_t prof_start_##id = timer_hires()
+#define PROF_EXIT(id)     prof_add(id,timer_hires() - prof_start_##id)
+
+#else
+
+#define PROF_ENTER(id)
+#define PROF_EXIT(id)
+
+#endif
+
+#endif
@@ -25,6 +25,7 @@
  */
 
 #include <stdint.h>
+#include <util/crc16.h>
 
 #include "board.h"
 
@@ -150,3 +151,81 @@ host_transfer_funcs_t serial_host_write_funcs =
   .transfer_byte  = serial_write_byte
 };
 
+#ifdef USE_MEMCMD
+
+// ----- crc -----
+
+static uint8_t serial_skip_byte(uint8_t *data)
+{
+  // only the block crc16 is sent to the host
+  return TRANSFER_OK;
+}
+
+host_transfer_funcs_t serial_host_crc_funcs =
+{
+  .begin_transfer = serial_begin_write_transfer,
+  .end_transfer   = serial_end_write_transfer,
+  .check_block    = serial_check_write_block,
+  .transfer_byte  = serial_skip_byte
+};
+
+// ----- range list -----
+
+static uint8_t serial_read_tribyte(uint32_t *value,uint16_t *crc16)
+{
+  uint8_t i,data;
+  uint32_t v = 0;
+  for(i=0;i<3;i++) {
+    if(!uart_read(&data))
+      return TRANSFER_ERROR_CLIENT_TIMEOUT;
+    *crc16 = _crc16_update(*crc16,data);
+    v = (v << 8) | data;
+  }
+  *value = v;
+  return TRANSFER_OK;
+}
+
+uint8_t serial_recv_range_list(transfer_range_t *ranges,uint8_t num)
+{
+  uint8_t status = TRANSFER_OK;
+  uint16_t crc16 = 0xffff;
+  uint8_t i;
+
+  uart_start_reception();
+
+  // read range descriptors
+  for(i=0;i<num;i++) {
+    uint8_t mode;
+    if(!uart_read(&mode)) {
+      status = TRANSFER_ERROR_CLIENT_TIMEOUT;
+      break;
+    }
+    crc16 = _crc16_update(crc16,mode);
+    ranges[i].mode = mode;
+
+    status = serial_read_tribyte(&ranges[i].base,&crc16);
+    if(status==TRANSFER_OK)
+      status = serial_read_tribyte(&ranges[i].length,&crc16);
+    if(status!=TRANSFER_OK)
+      break;
+  }
+
+  // read and compare crc16 of descriptors
+  if(status==TRANSFER_OK) {
+    uint8_t data[2];
+    if(!uart_read(&data[0]) || !uart_read(&data[1]))
+      status = TRANSFER_ERROR_CLIENT_TIMEOUT;
+    else if(((uint16_t)data[0]<<8 | data[1]) != crc16)
+      status = TRANSFER_ERROR_CRC16_MISMATCH;
+  }
+
+  uart_stop_reception();
+
+  // acknowledge descriptors
+  if(!uart_send(status))
+    status = TRANSFER_ERROR_CLIENT_TIMEOUT;
+
+  return status;
+}
+
+#endif
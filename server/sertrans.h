@@ -33,5 +33,12 @@
 extern host_transfer_funcs_t serial_host_read_funcs;
 // write to host via serial
 extern host_transfer_funcs_t serial_host_write_funcs;
+#ifdef USE_MEMCMD
+// write only block crc16s to host via serial
+extern host_transfer_funcs_t serial_host_crc_funcs;
+
+// read num range descriptors from host and acknowledge them. returns status
+extern uint8_t serial_recv_range_list(transfer_range_t *ranges,uint8_t num);
+#endif
 
 #endif
@@ -0,0 +1,924 @@
+/*
+ * simbench.c - cycle benchmarks of the firmware running in simavr
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+// Host tool run by 'make bench': a firmware elf is executed in simavr with
+// a scripted peer on both sides. The host peer talks to the UART like the
+// client does (paced at one byte per frame and honoring CTS). The DTV peer
+// answers the dtvlow handshake of dtvlow.c without delay and implements
+// the read and write commands of a dtvtrans server with 64 KiB of RAM.
+//
+// Cycles are counted per instruction. Functions of a watch list get their
+// inclusive cycles (including interrupts taken inside) by tracking calls
+// via the stack pointer. Function addresses come from the .sym file of
+// the build. Static functions inlined by the compiler are not reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+#include "avr_uart.h"
+
+// transfer modes of transfercmd.h
+#define TRANSFER_MODE_NORMAL        0
+#define TRANSFER_MODE_SERIAL_ONLY   1
+#define TRANSFER_MODE_DTV_ONLY      2
+
+// size and location of the benchmark transfers
+#define BENCH_SIZE        0x2000
+#define BENCH_READ_BASE   0x000000
+#define BENCH_WRITE_BASE  0x008000
+
+// time outs in ms of simulated time
+#define BOOT_TIME         100
+#define REPLY_TIMEOUT     100
+#define TRANSFER_TIMEOUT  5000
+
+// ----- boards -----
+
+// pins of the DTV port and the host flow control
+typedef struct {
+  const char *name;
+  char    dtv_port;     // data and clk
+  uint8_t data_shift;
+  uint8_t clk_bit;
+  char    ack_port;
+  uint8_t ack_bit;
+  char    flow_port;    // cts output and rts input
+  uint8_t cts_bit;
+  uint8_t rts_bit;
+} board_t;
+
+static const board_t boards[] = {
+  { "cvm8board",   'C', 0, 3, 'C', 4, 'D', 2, 3 },
+  { "arduino2009", 'C', 0, 3, 'C', 4, 'D', 2, 3 },
+  { 0 }
+};
+
+static avr_t *avr;
+static const board_t *board;
+// cycles of a serial frame (start, 8 data and stop bit)
+static uint32_t frame_cycles;
+
+static void fail(const char *msg,const char *arg)
+{
+  fprintf(stderr,"simbench: %s%s%s\n",msg,arg?": ":"",arg?arg:"");
+  exit(1);
+}
+
+static avr_cycle_count_t ms_to_cycles(uint32_t ms)
+{
+  return (avr_cycle_count_t)ms * (avr->frequency / 1000);
+}
+
+// ----- watched functions -----
+
+static const char *watch_names[] = {
+  "dtvlow_send_byte",
+  "dtvlow_recv_byte",
+  "uart_read",
+  "uart_send",
+  "serial_read_byte",
+  "serial_write_byte",
+  "diagnose_transfer_byte",
+  "dtvtrans_send_mem_block",
+  "dtvtrans_recv_mem_block",
+  "diagnose_dtv_send_block",
+  "diagnose_dtv_recv_block",
+  0
+};
+
+#define WATCH_DTVLOW_SEND     0
+#define WATCH_DTVLOW_RECV     1
+#define WATCH_SERIAL_READ     4
+#define WATCH_SERIAL_WRITE    5
+#define WATCH_DIAGNOSE_BYTE   6
+#define WATCH_FIRST_BLOCK     7
+#define WATCH_MAX             16
+
+#define MAX_FRAMES            32
+
+typedef struct {
+  uint8_t id;
+  uint16_t sp;
+  avr_cycle_count_t start;
+} frame_t;
+
+// watch id + 1 for each flash word. 0 = not watched
+static uint8_t *watch_at;
+static uint32_t watch_words;
+static avr_cycle_count_t watch_cycles[WATCH_MAX];
+static frame_t frames[MAX_FRAMES];
+static int num_frames;
+
+static void load_symbols(const char *path)
+{
+  FILE *fh = fopen(path,"r");
+  if(fh==NULL)
+    fail("can't open symbols",path);
+
+  // avr-nm -n output: <addr> <type> <name>
+  char line[256];
+  while(fgets(line,sizeof(line),fh)) {
+    unsigned long addr;
+    char type;
+    char name[200];
+    if(sscanf(line,"%lx %c %199s",&addr,&type,name)!=3)
+      continue;
+    if((type!='T')&&(type!='t'))
+      continue;
+    for(int i=0;watch_names[i];i++) {
+      if(!strcmp(name,watch_names[i]) && ((addr>>1)<watch_words))
+        watch_at[addr>>1] = i + 1;
+    }
+  }
+  fclose(fh);
+}
+
+static void watch_reset(void)
+{
+  memset(watch_cycles,0,sizeof(watch_cycles));
+}
+
+static uint16_t get_sp(void)
+{
+  return avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+}
+
+// called after each instruction
+static void watch_step(void)
+{
+  uint16_t sp = get_sp();
+
+  // returned from watched functions?
+  while((num_frames>0) && (sp>frames[num_frames-1].sp)) {
+    frame_t *f = &frames[--num_frames];
+    watch_cycles[f->id] += avr->cycle - f->start;
+  }
+
+  // entered a watched function?
+  uint32_t word = avr->pc >> 1;
+  if((word>=watch_words)||(watch_at[word]==0))
+    return;
+  uint8_t id = watch_at[word] - 1;
+  if(num_frames>0) {
+    frame_t *top = &frames[num_frames-1];
+    // jump back to the entry of the running function
+    if((top->id==id)&&(top->sp==sp))
+      return;
+  }
+  if(num_frames<MAX_FRAMES) {
+    frame_t *f = &frames[num_frames++];
+    f->id = id;
+    f->sp = sp;
+    f->start = avr->cycle;
+  }
+}
+
+// ----- simulation -----
+
+static void step(void)
+{
+  int state = avr_run(avr);
+  if((state==cpu_Done)||(state==cpu_Crashed))
+    fail("cpu stopped",0);
+  watch_step();
+}
+
+static void run_cycles(avr_cycle_count_t cycles)
+{
+  avr_cycle_count_t end = avr->cycle + cycles;
+  while(avr->cycle<end)
+    step();
+}
+
+// run until cond() is true. returns 0 on time out
+static int run_until(int (*cond)(void),uint32_t ms)
+{
+  avr_cycle_count_t end = avr->cycle + ms_to_cycles(ms);
+  while(!cond()) {
+    if(avr->cycle>=end)
+      return 0;
+    step();
+  }
+  return 1;
+}
+
+// ----- pins -----
+
+static uint8_t ext_mask[8];
+static uint8_t ext_value[8];
+
+// pull a pin of the mcu externally like an attached device
+static void drive_pin(char port,uint8_t bit,uint8_t value)
+{
+  int p = port - 'A';
+  ext_mask[p] |= 1 << bit;
+  if(value)
+    ext_value[p] |= 1 << bit;
+  else
+    ext_value[p] &= ~(1 << bit);
+
+  avr_ioport_external_t ext;
+  ext.name  = port;
+  ext.mask  = ext_mask[p];
+  ext.value = ext_value[p];
+  avr_ioctl(avr,AVR_IOCTL_IOPORT_SET_EXTERNAL(port),&ext);
+  avr_raise_irq(avr_io_getirq(avr,AVR_IOCTL_IOPORT_GETIRQ(port),IOPORT_IRQ_PIN0+bit),value);
+}
+
+static void hook_port(char port,int irq,avr_irq_notify_t func)
+{
+  avr_irq_t *i = avr_io_getirq(avr,AVR_IOCTL_IOPORT_GETIRQ(port),irq);
+  if(i==NULL)
+    fail("port not found",0);
+  avr_irq_register_notify(i,func,NULL);
+}
+
+// ----- dtv peer -----
+
+// a dtvtrans server with 64 KiB RAM. higher banks are mirrored
+#define DTV_MEM_SIZE 0x10000
+
+#define DTV_CMD       0
+#define DTV_ARGS      1
+#define DTV_DATA      2
+#define DTV_CHK       3
+#define DTV_REPLY_CHK 4
+
+static uint8_t dtv_mem[DTV_MEM_SIZE];
+
+static struct {
+  uint8_t port_reg;   // PORT and DDR of the dtv port
+  uint8_t ddr_reg;
+  uint8_t clk;        // last clk level
+  uint8_t phase;      // handshake phase of the current byte
+  uint8_t sending;    // peer sends the current byte
+  uint8_t byte;
+
+  uint8_t state;      // server state
+  uint8_t cmd;
+  uint8_t args[6];
+  uint8_t num_args;
+  uint16_t addr;
+  uint16_t len;
+  uint16_t pos;
+  uint8_t chk;
+
+  uint32_t payload;        // data bytes of read and write commands
+  avr_cycle_count_t last;  // cycle of the last byte
+} dtv;
+
+static void dtv_lines(uint8_t data,uint8_t ack)
+{
+  for(int i=0;i<3;i++)
+    drive_pin(board->dtv_port,board->data_shift+i,(data>>i)&1);
+  drive_pin(board->ack_port,board->ack_bit,ack);
+}
+
+static void dtv_send(uint8_t data)
+{
+  dtv.sending = 1;
+  dtv.byte = data;
+}
+
+static uint8_t dtv_read_next(void)
+{
+  uint8_t data = dtv_mem[dtv.addr++];
+  dtv.chk += data + 1;
+  return data;
+}
+
+// a byte was transferred: advance the server
+static void dtv_byte_done(uint8_t data)
+{
+  dtv.last = avr->cycle;
+  dtv.sending = 0;
+
+  switch(dtv.state) {
+  case DTV_CMD:
+    // only read (1) and write (2) are supported
+    dtv.cmd = data;
+    dtv.num_args = 0;
+    if((data==0x01)||(data==0x02))
+      dtv.state = DTV_ARGS;
+    break;
+  case DTV_ARGS:
+    // mode, bank, offset lo/hi, length lo/hi
+    dtv.args[dtv.num_args++] = data;
+    if(dtv.num_args==6) {
+      dtv.addr = (dtv.args[1] << 14) + (dtv.args[2] | dtv.args[3] << 8);
+      dtv.len  = dtv.args[4] | dtv.args[5] << 8;
+      dtv.pos  = 0;
+      dtv.chk  = 0;
+      dtv.state = DTV_DATA;
+      if(dtv.cmd==0x01)
+        dtv_send(dtv_read_next());
+    }
+    break;
+  case DTV_DATA:
+    if(dtv.cmd==0x02) {
+      dtv_mem[dtv.addr++] = data;
+      dtv.chk += data + 1;
+    }
+    dtv.pos++;
+    dtv.payload++;
+    if(dtv.pos==dtv.len) {
+      dtv.state = DTV_CHK;
+      if(dtv.cmd==0x01)
+        dtv_send(dtv.chk);
+    } else if(dtv.cmd==0x01) {
+      dtv_send(dtv_read_next());
+    }
+    break;
+  case DTV_CHK:
+    // write: got check sum of avr and reply with ours
+    if(dtv.cmd==0x02) {
+      dtv.state = DTV_REPLY_CHK;
+      dtv_send(dtv.chk);
+    } else {
+      dtv.state = DTV_CMD;
+    }
+    break;
+  case DTV_REPLY_CHK:
+    dtv.state = DTV_CMD;
+    break;
+  }
+}
+
+// follow the clk edges of dtvlow_send_byte() and dtvlow_recv_byte()
+static void dtv_update(void)
+{
+  // open drain: inputs are pulled high
+  uint8_t level = ~dtv.ddr_reg | dtv.port_reg;
+  uint8_t clk = (level >> board->clk_bit) & 1;
+  if(clk==dtv.clk)
+    return;
+  dtv.clk = clk;
+
+  uint8_t bits = (level >> board->data_shift) & 7;
+  uint8_t ack = dtv.phase & 1;
+  if(dtv.sending) {
+    switch(dtv.phase) {
+    case 0: dtv_lines(dtv.byte >> 5,ack); break;
+    case 1: dtv_lines(dtv.byte >> 2,ack); break;
+    case 2: dtv_lines(dtv.byte & 3,ack); break;
+    case 3: dtv_lines(7,ack); break;
+    }
+  } else {
+    switch(dtv.phase) {
+    case 0: dtv.byte  = bits << 5; break;
+    case 1: dtv.byte |= bits << 2; break;
+    case 2: dtv.byte |= bits & 3; break;
+    }
+    drive_pin(board->ack_port,board->ack_bit,ack);
+  }
+
+  dtv.phase = (dtv.phase + 1) & 3;
+  if(dtv.phase==0)
+    dtv_byte_done(dtv.byte);
+}
+
+static void dtv_port_hook(struct avr_irq_t *irq,uint32_t value,void *param)
+{
+  dtv.port_reg = value;
+  dtv_update();
+}
+
+static void dtv_ddr_hook(struct avr_irq_t *irq,uint32_t value,void *param)
+{
+  dtv.ddr_reg = value;
+  dtv_update();
+}
+
+static int dtv_done(void)
+{
+  return (dtv.payload==BENCH_SIZE) && (dtv.state==DTV_CMD);
+}
+
+static void dtv_init(void)
+{
+  memset(&dtv,0,sizeof(dtv));
+  dtv.clk = 1;
+  dtv_lines(7,1);
+  hook_port(board->dtv_port,IOPORT_IRQ_REG_PORT,dtv_port_hook);
+  hook_port(board->dtv_port,IOPORT_IRQ_DIRECTION_ALL,dtv_ddr_hook);
+}
+
+// ----- host peer -----
+
+#define HOST_BUF_SIZE 0x6000
+
+static avr_irq_t *uart_in_irq;
+static uint8_t host_cts = 1;
+
+// to the firmware
+static uint8_t host_in[HOST_BUF_SIZE];
+static int host_in_len;
+static int host_in_pos;
+static avr_cycle_count_t host_in_last;
+
+// from the firmware with cycle of the UDR write
+static uint8_t host_out[HOST_BUF_SIZE];
+static avr_cycle_count_t host_out_cycle[HOST_BUF_SIZE];
+static int host_out_len;
+static int host_out_pos;
+
+static void uart_out_hook(struct avr_irq_t *irq,uint32_t value,void *param)
+{
+  if(host_out_len<HOST_BUF_SIZE) {
+    host_out[host_out_len] = value;
+    host_out_cycle[host_out_len] = avr->cycle;
+    host_out_len++;
+  }
+}
+
+static void flow_port_hook(struct avr_irq_t *irq,uint32_t value,void *param)
+{
+  // CTS is active low
+  host_cts = ((value >> board->cts_bit) & 1) == 0;
+}
+
+// feed one byte per frame while CTS is set
+static avr_cycle_count_t uart_pump(struct avr_t *a,avr_cycle_count_t when,void *param)
+{
+  if((host_in_pos<host_in_len)&&host_cts) {
+    avr_raise_irq(uart_in_irq,host_in[host_in_pos++]);
+    host_in_last = when;
+  }
+  return when + frame_cycles;
+}
+
+static int host_all_sent(void)
+{
+  return host_in_pos==host_in_len;
+}
+
+static void host_send(const uint8_t *data,int len)
+{
+  if(host_all_sent()) {
+    host_in_len = 0;
+    host_in_pos = 0;
+  }
+  if(host_in_len+len>HOST_BUF_SIZE)
+    fail("host send buffer overflow",0);
+  memcpy(host_in+host_in_len,data,len);
+  host_in_len += len;
+}
+
+static void host_send_byte(uint8_t data)
+{
+  host_send(&data,1);
+}
+
+static void host_flush(void)
+{
+  host_out_len = 0;
+  host_out_pos = 0;
+}
+
+static int host_want;
+
+static int host_has_bytes(void)
+{
+  return (host_out_len - host_out_pos) >= host_want;
+}
+
+// returns index of first byte
+static int host_read(int len,uint32_t ms)
+{
+  host_want = len;
+  if(!run_until(host_has_bytes,ms))
+    fail("host read timed out",0);
+  int pos = host_out_pos;
+  host_out_pos += len;
+  return pos;
+}
+
+static int host_has_line(void)
+{
+  return memchr(host_out+host_out_pos,'\n',host_out_len-host_out_pos)!=NULL;
+}
+
+// read a "XX\r\n" hex line and return its value
+static uint32_t host_read_hex_line(void)
+{
+  if(!run_until(host_has_line,REPLY_TIMEOUT))
+    fail("host reply timed out",0);
+  char *line = (char *)host_out + host_out_pos;
+  char *end = memchr(line,'\n',host_out_len-host_out_pos);
+  host_out_pos += end - line + 1;
+  return strtoul(line,NULL,16);
+}
+
+// wait until the firmware was quiet for a ms
+static void host_drain(void)
+{
+  for(;;) {
+    int len = host_out_len;
+    run_cycles(ms_to_cycles(1));
+    if(len==host_out_len)
+      break;
+  }
+  host_out_pos = host_out_len;
+}
+
+// send a command line and return its status. the latency covers the time
+// from the stop bit of CR to the write of the first status byte to UDR
+static uint8_t host_command(const char *line,avr_cycle_count_t *latency)
+{
+  host_flush();
+  host_send((const uint8_t *)line,strlen(line));
+  if(!run_until(host_all_sent,REPLY_TIMEOUT))
+    fail("command not accepted",line);
+  run_cycles(2 * frame_cycles);
+
+  host_send_byte('\r');
+  run_until(host_all_sent,REPLY_TIMEOUT);
+  avr_cycle_count_t cr = host_in_last;
+  uint8_t status = host_read_hex_line();
+  if(latency!=NULL)
+    *latency = host_out_cycle[0] - cr - frame_cycles;
+  return status;
+}
+
+static void host_command_ok(const char *line)
+{
+  if(host_command(line,NULL)!=0)
+    fail("command failed",line);
+}
+
+static void host_init(void)
+{
+  uart_in_irq = avr_io_getirq(avr,AVR_IOCTL_UART_GETIRQ('0'),UART_IRQ_INPUT);
+  avr_irq_t *out = avr_io_getirq(avr,AVR_IOCTL_UART_GETIRQ('0'),UART_IRQ_OUTPUT);
+  if((uart_in_irq==NULL)||(out==NULL))
+    fail("uart not found",0);
+  avr_irq_register_notify(out,uart_out_hook,NULL);
+
+  // keep the uart output off stdout
+  uint32_t flags = 0;
+  avr_ioctl(avr,AVR_IOCTL_UART_GET_FLAGS('0'),&flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(avr,AVR_IOCTL_UART_SET_FLAGS('0'),&flags);
+
+  // host is always ready to receive
+  drive_pin(board->flow_port,board->rts_bit,0);
+  hook_port(board->flow_port,IOPORT_IRQ_REG_PORT,flow_port_hook);
+
+  avr_cycle_timer_register(avr,frame_cycles,uart_pump,NULL);
+}
+
+// ----- results -----
+
+#define MAX_RESULTS 128
+
+typedef struct {
+  char key[48];
+  double value;
+} result_t;
+
+static result_t results[MAX_RESULTS];
+static int num_results;
+static result_t refs[MAX_RESULTS];
+static int num_refs;
+
+static void load_refs(const char *path)
+{
+  FILE *fh = fopen(path,"r");
+  if(fh==NULL)
+    return;
+  while(num_refs<MAX_RESULTS) {
+    result_t *r = &refs[num_refs];
+    if(fscanf(fh,"%47s %lf",r->key,&r->value)!=2)
+      break;
+    num_refs++;
+  }
+  fclose(fh);
+}
+
+static void add_result(const char *key,double value,const char *unit)
+{
+  if(num_results==MAX_RESULTS)
+    fail("too many results",key);
+  result_t *r = &results[num_results++];
+  snprintf(r->key,sizeof(r->key),"%s",key);
+  r->value = value;
+
+  printf("  %-36s %10.1f %-12s",key,value,unit);
+  for(int i=0;i<num_refs;i++) {
+    if(!strcmp(refs[i].key,key)) {
+      printf(" %+10.1f",value - refs[i].value);
+      break;
+    }
+  }
+  printf("\n");
+}
+
+static void save_results(const char *path)
+{
+  FILE *fh = fopen(path,"w");
+  if(fh==NULL)
+    fail("can't write results",path);
+  for(int i=0;i<num_results;i++)
+    fprintf(fh,"%s %.1f\n",results[i].key,results[i].value);
+  fclose(fh);
+}
+
+// ----- benchmarks -----
+
+static const char *parse_tests[] = {
+  "v",
+  "t",
+  "m00",
+  "pwg07",
+  "pws070400",
+  "r00",        // too few args
+  "zz",         // unknown command
+  0
+};
+
+static void bench_parse(void)
+{
+  char key[48];
+  for(int i=0;parse_tests[i];i++) {
+    avr_cycle_count_t latency;
+    host_command(parse_tests[i],&latency);
+    host_drain();
+    snprintf(key,sizeof(key),"parse.%s",parse_tests[i]);
+    add_result(key,latency,"cycles");
+  }
+}
+
+typedef struct {
+  const char *name;
+  uint8_t mode;
+  uint8_t write;
+} transfer_test_t;
+
+static const transfer_test_t transfer_tests[] = {
+  { "read",         TRANSFER_MODE_NORMAL,      0 },
+  { "write",        TRANSFER_MODE_NORMAL,      1 },
+  { "read_dtv",     TRANSFER_MODE_DTV_ONLY,    0 },
+  { "write_dtv",    TRANSFER_MODE_DTV_ONLY,    1 },
+  { "read_serial",  TRANSFER_MODE_SERIAL_ONLY, 0 },
+  { "write_serial", TRANSFER_MODE_SERIAL_ONLY, 1 },
+  { 0 }
+};
+
+// largest block size of a dtvtrans transfer (one bank)
+#define MAX_BLOCK_SIZE 0x4000
+
+static uint16_t block_size;
+
+static uint16_t crc16_update(uint16_t crc,uint8_t data)
+{
+  // same as _crc16_update() of avr-libc
+  crc ^= data;
+  for(int i=0;i<8;i++) {
+    if(crc & 1)
+      crc = (crc >> 1) ^ 0xa001;
+    else
+      crc = crc >> 1;
+  }
+  return crc;
+}
+
+static uint8_t test_data(uint32_t pos)
+{
+  return (uint8_t)(pos * 7);
+}
+
+// host side of a read: returns cycle of the last crc byte
+static avr_cycle_count_t host_read_blocks(void)
+{
+  avr_cycle_count_t last = 0;
+  host_send_byte(0);
+  for(uint32_t pos=0;pos<BENCH_SIZE;pos+=block_size) {
+    uint32_t len = BENCH_SIZE - pos;
+    if(len>block_size)
+      len = block_size;
+    int i = host_read(len + 2,TRANSFER_TIMEOUT);
+    uint16_t crc = 0xffff;
+    for(uint32_t j=0;j<len;j++)
+      crc = crc16_update(crc,host_out[i+j]);
+    if(crc!=(host_out[i+len] << 8 | host_out[i+len+1]))
+      fail("crc16 mismatch in read",0);
+    last = host_out_cycle[i+len+1];
+  }
+  host_send_byte(0);
+  run_until(host_all_sent,REPLY_TIMEOUT);
+  return last;
+}
+
+// host side of a write: returns cycle of the result byte
+static avr_cycle_count_t host_write_blocks(void)
+{
+  static uint8_t block[MAX_BLOCK_SIZE+2];
+  int i = host_read(1,REPLY_TIMEOUT);
+  if(host_out[i]!=0)
+    fail("write not started",0);
+  for(uint32_t pos=0;pos<BENCH_SIZE;pos+=block_size) {
+    uint32_t len = BENCH_SIZE - pos;
+    if(len>block_size)
+      len = block_size;
+    uint16_t crc = 0xffff;
+    for(uint32_t j=0;j<len;j++) {
+      block[j] = test_data(pos + j);
+      crc = crc16_update(crc,block[j]);
+    }
+    block[len]   = crc >> 8;
+    block[len+1] = crc & 0xff;
+    host_send(block,len + 2);
+  }
+  i = host_read(1,TRANSFER_TIMEOUT);
+  if(host_out[i]!=0)
+    fail("write failed",0);
+  return host_out_cycle[i];
+}
+
+static void bench_transfer(const transfer_test_t *t)
+{
+  char line[32];
+  char key[48];
+
+  snprintf(line,sizeof(line),"m%02X",t->mode);
+  host_command_ok(line);
+
+  uint32_t base = t->write ? BENCH_WRITE_BASE : BENCH_READ_BASE;
+  snprintf(line,sizeof(line),"%c00%06X%06X",t->write ? 'w':'r',base,BENCH_SIZE);
+  watch_reset();
+  dtv.payload = 0;
+  if(host_command(line,NULL)!=0)
+    fail("transfer command failed",line);
+  // data phase starts after the status line
+  avr_cycle_count_t start = host_out_cycle[host_out_pos-1];
+
+  avr_cycle_count_t end;
+  if(t->mode==TRANSFER_MODE_DTV_ONLY) {
+    if(!run_until(dtv_done,TRANSFER_TIMEOUT))
+      fail("dtv transfer timed out",t->name);
+    end = dtv.last;
+  } else if(t->write) {
+    end = host_write_blocks();
+  } else {
+    end = host_read_blocks();
+  }
+
+  // check transfer result
+  host_command_ok("t");
+  if(host_read_hex_line()!=0)
+    fail("transfer failed",t->name);
+  host_drain();
+
+  if((t->mode==TRANSFER_MODE_NORMAL)&&t->write) {
+    for(uint32_t i=0;i<BENCH_SIZE;i++)
+      if(dtv_mem[(base + i) & (DTV_MEM_SIZE-1)]!=test_data(i))
+        fail("dtv memory mismatch",t->name);
+  }
+
+  snprintf(key,sizeof(key),"%s.total",t->name);
+  add_result(key,(double)(end - start) / BENCH_SIZE,"cycles/byte");
+
+  avr_cycle_count_t callees = 0;
+  avr_cycle_count_t block = 0;
+  for(int i=0;watch_names[i];i++) {
+    if(watch_cycles[i]==0)
+      continue;
+    if(i>=WATCH_FIRST_BLOCK)
+      block += watch_cycles[i];
+    else if((i==WATCH_DTVLOW_SEND)||(i==WATCH_DTVLOW_RECV)||
+            (i==WATCH_SERIAL_READ)||(i==WATCH_SERIAL_WRITE)||
+            (i==WATCH_DIAGNOSE_BYTE))
+      callees += watch_cycles[i];
+    snprintf(key,sizeof(key),"%s.%s",t->name,watch_names[i]);
+    add_result(key,(double)watch_cycles[i] / BENCH_SIZE,"cycles/byte");
+  }
+  // everything of the block function besides the byte transfers
+  if(block>callees) {
+    snprintf(key,sizeof(key),"%s.loop+crc",t->name);
+    add_result(key,(double)(block - callees) / BENCH_SIZE,"cycles/byte");
+  }
+}
+
+// ----- main -----
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: simbench -B <board> -m <mcu> -f <f_cpu> -b <baud> -s <symfile>\n"
+    "                [-o <results>] [-r <reference>] <firmware.elf>\n");
+  exit(1);
+}
+
+int main(int argc,char **argv)
+{
+  const char *board_name = NULL;
+  const char *mcu = NULL;
+  uint32_t f_cpu = 0;
+  uint32_t baud = 0;
+  const char *sym_file = NULL;
+  const char *out_file = NULL;
+  const char *ref_file = NULL;
+
+  int c;
+  while((c=getopt(argc,argv,"B:m:f:b:s:o:r:"))!=-1) {
+    switch(c) {
+    case 'B': board_name = optarg; break;
+    case 'm': mcu = optarg; break;
+    case 'f': f_cpu = strtoul(optarg,NULL,0); break;
+    case 'b': baud = strtoul(optarg,NULL,0); break;
+    case 's': sym_file = optarg; break;
+    case 'o': out_file = optarg; break;
+    case 'r': ref_file = optarg; break;
+    default: usage();
+    }
+  }
+  if((optind!=argc-1)||!board_name||!mcu||!f_cpu||!baud||!sym_file)
+    usage();
+
+  for(board=boards;board->name;board++)
+    if(!strcmp(board->name,board_name))
+      break;
+  if(board->name==NULL)
+    fail("unsupported board",board_name);
+
+  // setup simavr
+  elf_firmware_t f;
+  memset(&f,0,sizeof(f));
+  if(elf_read_firmware(argv[optind],&f))
+    fail("can't read firmware",argv[optind]);
+  snprintf(f.mmcu,sizeof(f.mmcu),"%s",mcu);
+  f.frequency = f_cpu;
+  avr = avr_make_mcu_by_name(f.mmcu);
+  if(avr==NULL)
+    fail("unknown mcu",mcu);
+  avr_init(avr);
+  avr_load_firmware(avr,&f);
+
+  frame_cycles = (uint32_t)((uint64_t)f_cpu * 10 / baud);
+  watch_words = (avr->flashend + 1) >> 1;
+  watch_at = calloc(watch_words,1);
+  load_symbols(sym_file);
+  if(ref_file!=NULL)
+    load_refs(ref_file);
+
+  dtv_init();
+  host_init();
+
+  printf("--- simavr bench BOARD=%s MCU=%s F_CPU=%u UART_BAUD=%u ---\n",
+         board->name,mcu,f_cpu,baud);
+
+  // boot and check that the firmware talks to us
+  run_cycles(ms_to_cycles(BOOT_TIME));
+  host_command_ok("v");
+  host_drain();
+
+  add_result("size.flash",f.flashsize,"bytes");
+  add_result("size.ram",f.datasize + f.bsssize,"bytes");
+  add_result("uart.frame",frame_cycles,"cycles/byte");
+
+  bench_parse();
+
+  host_command_ok("pwg07");
+  block_size = host_read_hex_line();
+  if((block_size==0)||(block_size>MAX_BLOCK_SIZE))
+    fail("invalid block size",0);
+
+  for(const transfer_test_t *t=transfer_tests;t->name;t++)
+    bench_transfer(t);
+  host_command_ok("m00");
+
+  if(out_file!=NULL)
+    save_results(out_file);
+  return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * stats.c - firmware performance counters
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include <stdint.h>
+
+#include "board.h"
+
+#include "stats.h"
+
+#ifdef USE_STATS
+
+uint32_t stats[STATS_NUM];
+#ifdef USE_ACK_HIST
+uint16_t stats_ack_hist[STATS_ACK_PHASES][STATS_ACK_BINS];
+#endif
+
+void stats_reset(void)
+{
+  for(uint8_t i=0;i<STATS_NUM;i++)
+    stats[i] = 0;
+#ifdef USE_ACK_HIST
+  for(uint8_t p=0;p<STATS_ACK_PHASES;p++)
+    for(uint8_t i=0;i<STATS_ACK_BINS;i++)
+      stats_ack_hist[p][i] = 0;
+#endif
+}
+
+#ifdef USE_ACK_HIST
+
+void stats_ack_sample(uint8_t phase,uint16_t us)
+{
+  // bin is the number of significant bits
+  uint8_t bin = 0;
+  while(us) {
+    bin++;
+    us >>= 1;
+  }
+  if(bin >= STATS_ACK_BINS)
+    bin = STATS_ACK_BINS - 1;
+
+  uint16_t *h = &stats_ack_hist[phase][bin];
+  if(*h != 0xffff)
+    (*h)++;
+}
+
+#endif // USE_ACK_HIST
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * stats.h - firmware performance counters
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+// ----- counters -----
+// bytes per direction
+#define STATS_HOST_RX_BYTES     0
+#define STATS_HOST_TX_BYTES     1
+#define STATS_DTV_TX_BYTES      2
+#define STATS_DTV_RX_BYTES      3
+// transferred blocks
+#define STATS_BLOCKS            4
+// missing acks per phase of a dtvlow byte (NOACK1..NOACK4)
+#define STATS_NOACK1            5
+#define STATS_NOACK2            6
+#define STATS_NOACK3            7
+#define STATS_NOACK4            8
+// dtvtrans checksum and host crc16 failures
+#define STATS_CHECKSUM_ERRORS   9
+#define STATS_CRC_ERRORS        10
+// time in ms waiting for RTS, the transmitter (UDRE) and received data
+#define STATS_RTS_WAIT_MS       11
+#define STATS_UDRE_WAIT_MS      12
+#define STATS_RX_WAIT_MS        13
+// time in us waiting for dtv acks and max time of a single ack
+#define STATS_ACK_WAIT_US       14
+#define STATS_ACK_MAX_US        15
+
+#define STATS_NUM               16
+
+// flags of stats command
+#define STATS_FLAG_RESET        0x01
+
+// Times are sums of 1ms timer differences. Short waits are only counted
+// when they cross a timer tick, so the sums are right on average. The
+// ack times are measured in us with the high resolution timer and stay
+// 0 without USE_HIRES_TIMER.
+
+// ----- ack latency histogram -----
+// one histogram per phase of a dtvlow byte. bin 0 counts acks seen
+// immediately, bin n acks after 2^(n-1)..2^n-1 us and the last bin all
+// slower ones. counters saturate at 0xffff. the histogram costs a high
+// resolution timer read per handshake, so it needs USE_ACK_HIST.
+#define STATS_ACK_PHASES        4
+#define STATS_ACK_BINS          16
+
+#ifdef USE_STATS
+
+extern uint32_t stats[STATS_NUM];
+
+#define STATS_INC(n)      stats[n]++
+#define STATS_ADD(n,v)    stats[n]+=(v)
+#define STATS_MAX(n,v)    do { if((v)>stats[n]) stats[n]=(v); } while(0)
+
+// reset all counters and histograms
+void stats_reset(void);
+
+#ifdef USE_ACK_HIST
+#ifndef USE_HIRES_TIMER
+#error "USE_ACK_HIST needs USE_HIRES_TIMER"
+#endif
+
+extern uint16_t stats_ack_hist[STATS_ACK_PHASES][STATS_ACK_BINS];
+
+// add an ack latency in us of the given phase (0..3)
+void stats_ack_sample(uint8_t phase,uint16_t us);
+#endif
+
+#else
+
+#define STATS_INC(n)
+#define STATS_ADD(n,v)
+#define STATS_MAX(n,v)
+
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * telemetry.h - live telemetry stream on a second channel
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Telemetry is a stream of text lines sent on a channel separate from the
+// data protocol (the second cdc interface of the arm port). Lines are only
+// formatted while a host listens and are dropped if the ring buffer is
+// full, so the transfer is never delayed.
+//
+// all numbers are hex, t is the time stamp in us:
+//   B tttttttt bb llll dddddddd rr
+//     dtv block: bank, length, duration in us, result
+//   T tttttttt rr llllllll ssssssss dddddddd eeeeeeee
+//     transfer: result, length, setup/data/end phase in us
+//   E tttttttt
+//     error condition entered
+//   S tttttttt nnnn cccccccc...
+//     periodic: dropped lines and the counters of the 's' command
+
+// ring buffer size (power of 2)
+#ifndef TELEMETRY_SIZE
+#define TELEMETRY_SIZE            1024
+#endif
+
+// interval of S lines in ms
+#define TELEMETRY_STATS_INTERVAL  1000
+
+#ifdef USE_TELEMETRY
+
+void telemetry_block_begin(void);
+void telemetry_block_end(uint8_t bank,uint16_t length,uint8_t result);
+// report the finished transfer_state
+void telemetry_transfer(void);
+void telemetry_error(void);
+// send S lines and kick transmission. call in main loop
+void telemetry_poll(void);
+
+#define TELEMETRY_BLOCK_BEGIN()           telemetry_block_begin()
+#define TELEMETRY_BLOCK_END(b,l,r)        telemetry_block_end(b,l,r)
+#define TELEMETRY_TRANSFER()              telemetry_transfer()
+#define TELEMETRY_ERROR()                 telemetry_error()
+
+#else
+
+#define TELEMETRY_BLOCK_BEGIN()
+#define TELEMETRY_BLOCK_END(b,l,r)
+#define TELEMETRY_TRANSFER()
+#define TELEMETRY_ERROR()
+
+#endif
+
+#endif
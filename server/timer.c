@@ -77,11 +77,20 @@ void timer_init(void)
 
 // timer counter
 volatile uint16_t timer_1ms = 0;
+#ifdef USE_HIRES_TIMER
+// high word of the ms count for 32 bit time stamps
+static volatile uint16_t timer_1ms_hi = 0;
+#endif
 
 // timer1 compare A handler
 ISR(TIMER1_COMPA_vect)
 {
+#ifdef USE_HIRES_TIMER
+  if(++timer_1ms == 0)
+    timer_1ms_hi++;
+#else
   timer_1ms++;
+#endif
 }
 
 void timer_delay_1ms(uint16_t timeout)
@@ -104,3 +113,123 @@ uint16_t timer_now(void)
   sei();
   return now;
 }
+
+#ifdef USE_HIRES_TIMER
+
+// ----- high resolution stamps -----
+// 1ms counter in the high word and TIMER1 ticks (8 / F_CPU) in the low word
+
+#ifdef TIFR1
+#define TIMER1_FLAGS  TIFR1
+#else
+#define TIMER1_FLAGS  TIFR
+#endif
+
+// us = ticks * TIMER1_US_SCALE / 256
+#define TIMER1_US_SCALE  ((8000000UL * 256 + F_CPU / 2) / F_CPU)
+
+// read the 32 bit ms count and the TIMER1 ticks of the current ms
+static uint16_t read_ticks(uint32_t *ms)
+{
+  uint16_t lo,hi,ticks;
+  // keep interrupt state as stamps are also taken in interrupt handlers
+  uint8_t sreg = SREG;
+  cli();
+  lo = timer_1ms;
+  hi = timer_1ms_hi;
+  ticks = TCNT1;
+  // compare match already happened but its interrupt is still pending
+  if(TIMER1_FLAGS & _BV(OCF1A)) {
+    if(++lo == 0)
+      hi++;
+    ticks = TCNT1;
+  }
+  SREG = sreg;
+  *ms = ((uint32_t)hi << 16) | lo;
+  return ticks;
+}
+
+uint32_t timer_hires(void)
+{
+  uint32_t ms;
+  uint16_t ticks = read_ticks(&ms);
+  return (ms << 16) | ticks;
+}
+
+uint32_t timer_us(void)
+{
+  uint32_t ms;
+  uint16_t ticks = read_ticks(&ms);
+  return ms * 1000 + (((uint32_t)ticks * TIMER1_US_SCALE) >> 8);
+}
+
+uint16_t timer_hires_us(uint32_t start)
+{
+  uint32_t now = timer_hires();
+  uint16_t ms = (uint16_t)(now >> 16) - (uint16_t)(start >> 16);
+  if(ms > 65)
+    return 0xffff;
+  int32_t ticks = (int32_t)ms * (TIMER1_COMPARE_VAL + 1)
+                + (int32_t)(uint16_t)now - (int32_t)(uint16_t)start;
+  uint32_t us = ((uint32_t)ticks * TIMER1_US_SCALE) >> 8;
+  if(us > 0xffff)
+    return 0xffff;
+  return (uint16_t)us;
+}
+
+#endif // USE_HIRES_TIMER
+
+#ifdef USE_JOYBUF
+
+// ----- TIMER2 (8bit) -----
+// 100us tick for timed playback
+
+// n = F_CPU / (prescaler * 10000) -> compare val m = n - 1
+#define TIMER2_COMPARE_VAL  ((F_CPU / (8 * 10000UL)) - 1)
+
+static volatile timer_func_t timer_fast_func;
+
+#ifdef TIMER2_COMPA_vect
+ISR(TIMER2_COMPA_vect)
+#else
+ISR(TIMER2_COMP_vect)
+#endif
+{
+  timer_fast_func();
+}
+
+void timer_fast_start(timer_func_t func)
+{
+  cli();
+  timer_fast_func = func;
+  TCNT2 = 0;
+#ifdef TCCR2A
+  // CTC on OCR2A with prescale 8
+  TCCR2A = _BV(WGM21);
+  TCCR2B = _BV(CS21);
+  OCR2A  = TIMER2_COMPARE_VAL;
+  TIFR2  = _BV(OCF2A);
+  TIMSK2 = _BV(OCIE2A);
+#else
+  TCCR2  = _BV(WGM21) | _BV(CS21);
+  OCR2   = TIMER2_COMPARE_VAL;
+  TIFR   = _BV(OCF2);
+  TIMSK |= _BV(OCIE2);
+#endif
+  sei();
+}
+
+void timer_fast_stop(void)
+{
+  cli();
+#ifdef TCCR2A
+  TIMSK2 = 0;
+  TCCR2B = 0;
+#else
+  TIMSK &= ~_BV(OCIE2);
+  TCCR2  = 0;
+#endif
+  sei();
+}
+
+#endif // USE_JOYBUF
@@ -44,5 +44,23 @@ uint8_t timer_expired(timeout_t *t);
 
 uint16_t timer_now(void);
 
+#ifdef USE_HIRES_TIMER
+// 32 bit time stamp in us. wraps after about 71 minutes
+uint32_t timer_us(void);
+
+// high resolution stamp for measuring short intervals
+uint32_t timer_hires(void);
+// us elapsed since a stamp. saturates at 0xffff
+uint16_t timer_hires_us(uint32_t start);
+#endif
+
+#ifdef USE_JOYBUF
+// fast 100us tick calling func from the timer interrupt
+typedef void (*timer_func_t)(void);
+
+void timer_fast_start(timer_func_t func);
+void timer_fast_stop(void);
+#endif
+
 #endif
 
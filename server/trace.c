@@ -0,0 +1,105 @@
+/*
+ * trace.c - on-device protocol event trace
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include <stdint.h>
+
+#include "board.h"
+
+#include "hal.h"
+#include "timer.h"
+#include "trace.h"
+
+#ifdef USE_TRACE
+
+static trace_entry_t trace_buf[TRACE_SIZE];
+// next entry to write
+static uint16_t trace_head;
+// number of valid entries
+static uint16_t trace_count;
+// number of overwritten entries
+static uint16_t trace_overwritten;
+// events are only recorded if enabled
+static volatile uint8_t trace_enabled = 1;
+
+void trace_add(uint8_t event,uint8_t arg)
+{
+  if(!trace_enabled)
+    return;
+
+  uint8_t irq = hal_irq_disable();
+
+  trace_entry_t *e = &trace_buf[trace_head];
+  e->us    = timer_us();
+  e->event = event;
+  e->arg   = arg;
+  trace_head = (trace_head + 1) & (TRACE_SIZE-1);
+
+  // full ring overwrites the oldest entry
+  if(trace_count < TRACE_SIZE)
+    trace_count++;
+  else if(trace_overwritten != 0xffff)
+    trace_overwritten++;
+
+  hal_irq_restore(irq);
+}
+
+void trace_clear(void)
+{
+  uint8_t irq = hal_irq_disable();
+  trace_head = 0;
+  trace_count = 0;
+  trace_overwritten = 0;
+  hal_irq_restore(irq);
+}
+
+void trace_enable(uint8_t on)
+{
+  trace_enabled = on;
+}
+
+uint8_t trace_get(uint16_t i,trace_entry_t *e)
+{
+  uint8_t ok = 0;
+  uint8_t irq = hal_irq_disable();
+  if(i < trace_count) {
+    *e = trace_buf[(trace_head - trace_count + i) & (TRACE_SIZE-1)];
+    ok = 1;
+  }
+  hal_irq_restore(irq);
+  return ok;
+}
+
+uint16_t trace_num(void)
+{
+  return trace_count;
+}
+
+uint16_t trace_lost(void)
+{
+  return trace_overwritten;
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * trace.h - on-device protocol event trace
+ *
+ * Written by
+ *  Christian Vogelgsang <chris@vogelgsang.org>
+ *
+ * This file is part of dtv2ser.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// ----- events -----
+// command line executed (arg: first char of command)
+#define TRACE_CMD_BEGIN         0x01
+#define TRACE_CMD_END           0x02
+// dtv block transfer (arg: bank on begin, result on end)
+#define TRACE_BLOCK_BEGIN       0x03
+#define TRACE_BLOCK_END         0x04
+// missing dtv ack (arg: transfer error code)
+#define TRACE_NOACK             0x05
+// host block crc check (arg: result)
+#define TRACE_CRC               0x06
+// host flow control (arg: 1=CTS on/rx ready 0=CTS off/rx blocked)
+#define TRACE_CTS               0x07
+// error cycle
+#define TRACE_ERROR_BEGIN       0x08
+#define TRACE_ERROR_END         0x09
+
+// flags of trace command
+#define TRACE_FLAG_CLEAR        0x01
+
+// ring buffer of trace entries (power of 2)
+#ifndef TRACE_SIZE
+#define TRACE_SIZE              32
+#endif
+
+typedef struct {
+  // time stamp in us
+  uint32_t us;
+  uint8_t  event;
+  uint8_t  arg;
+} trace_entry_t;
+
+#ifdef USE_TRACE
+
+#ifndef USE_HIRES_TIMER
+#error "USE_TRACE needs the us time stamps of USE_HIRES_TIMER"
+#endif
+
+// add an event. also safe in interrupt handlers
+void trace_add(uint8_t event,uint8_t arg);
+// clear trace
+void trace_clear(void);
+// stop (0) or resume (1) recording of events
+void trace_enable(uint8_t on);
+
+// copy entry i (0=oldest) of the trace. returns 0 if no entry
+uint8_t trace_get(uint16_t i,trace_entry_t *e);
+// number of valid entries and entries lost by overwriting
+uint16_t trace_num(void);
+uint16_t trace_lost(void);
+
+#define TRACE(e,a)    trace_add(e,a)
+
+#else
+
+#define TRACE(e,a)
+
+#endif
+
+#endif
@@ -35,6 +35,10 @@
 #include "timer.h"
 #include "param.h"
 #include "sertrans.h"
+#include "stats.h"
+#include "trace.h"
+#include "telemetry.h"
+#include "prof.h"
 
 #define min(a,b) ((a<b)?(a):(b))
 
@@ -51,15 +55,36 @@ dtv_transfer_block_func_t current_dtv_transfer_block_func = 0;
 
 // ----- main transfer loop -----
 
+// begin of the data phase
+#ifdef USE_HIRES_TIMER
+static uint32_t data_start;
+#else
+static uint16_t data_start;
+#endif
+
 static uint8_t transfer_begin(uint8_t mode,uint32_t length)
 {
   // reset transfer state
-  transfer_state.length  = 0;
-  transfer_state.ms_time = 0;
-  transfer_state.result  = TRANSFER_OK;
+  transfer_state.length   = 0;
+#ifdef USE_HIRES_TIMER
+  transfer_state.setup_us = 0;
+  transfer_state.data_us  = 0;
+  transfer_state.end_us   = 0;
+#else
+  transfer_state.ms_time  = 0;
+#endif
+  transfer_state.result   = TRANSFER_OK;
 
   // begin host transfer
+#ifdef USE_HIRES_TIMER
+  uint32_t start = timer_us();
+  uint8_t result = current_host_transfer_funcs->begin_transfer(length);
+  data_start = timer_us();
+  transfer_state.setup_us = data_start - start;
+#else
   uint8_t result = current_host_transfer_funcs->begin_transfer(length);
+  data_start = timer_now();
+#endif
   if(result!=TRANSFER_OK) {
     transfer_state.result = result;
     return result;
@@ -73,32 +98,38 @@ static uint8_t transfer_begin(uint8_t mode,uint32_t length)
   return TRANSFER_OK;
 }
 
-static uint8_t transfer_end(uint8_t result,uint32_t total_length,uint16_t ms_time)
+static uint8_t transfer_end(uint8_t result,uint32_t total_length)
 {
+#ifdef USE_HIRES_TIMER
+  uint32_t end_start = timer_us();
+  transfer_state.data_us = end_start - data_start;
+#else
+  // time of the data phase in 10ms
+  transfer_state.ms_time = (uint16_t)(timer_now() - data_start) / 10;
+#endif
+
   led_transmit_off();
 
   // end host transfer
   result = current_host_transfer_funcs->end_transfer(result);
 
   // set transfer result
-  transfer_state.length  = total_length;
-  transfer_state.ms_time = ms_time;
-  transfer_state.result  = result;
+  transfer_state.length = total_length;
+#ifdef USE_HIRES_TIMER
+  transfer_state.end_us = timer_us() - end_start;
+#endif
+  transfer_state.result = result;
+  TELEMETRY_TRANSFER();
 
   return result;
 }
 
-uint8_t transfer_mem(uint8_t mode,uint32_t base,uint32_t length,uint16_t block_size)
+static uint8_t transfer_range(uint32_t base,uint32_t length,uint16_t block_size,
+                              uint32_t *total_length)
 {
-  uint8_t result = transfer_begin(mode,length);
-  if(result!=TRANSFER_OK)
-    return result;
-
-  // start timer
-  uint32_t start = timer_now();
+  uint8_t result = TRANSFER_OK;
 
   // block copy loop
-  uint32_t total_length = 0;
   uint8_t toggle = 1;
   while(length) {
     uint16_t offset = (uint16_t)(base & 0x3fff);
@@ -113,20 +144,32 @@ uint8_t transfer_mem(uint8_t mode,uint32_t base,uint32_t length,uint16_t block_s
 
     // call dtv func to transfer a single block
     // (calls host_funcs transfer_byte)
+    TRACE(TRACE_BLOCK_BEGIN,dtv_transfer_state.bank);
+    TELEMETRY_BLOCK_BEGIN();
     result = current_dtv_transfer_block_func();
-    if(result!=TRANSFER_OK)
+    TRACE(TRACE_BLOCK_END,result);
+    TELEMETRY_BLOCK_END(dtv_transfer_state.bank,len,result);
+    STATS_INC(STATS_BLOCKS);
+    if(result!=TRANSFER_OK) {
+      if(result==TRANSFER_ERROR_DTVTRANS_CHECKSUM)
+        STATS_INC(STATS_CHECKSUM_ERRORS);
       break;
+    }
 
     // host check block
     result = current_host_transfer_funcs->check_block(dtv_transfer_state.crc16);
-    if(result!=TRANSFER_OK)
+    TRACE(TRACE_CRC,result);
+    if(result!=TRANSFER_OK) {
+      if(result==TRANSFER_ERROR_CRC16_MISMATCH)
+        STATS_INC(STATS_CRC_ERRORS);
       break;
+    }
 
     // update
     uint16_t transfer_length = dtv_transfer_state.transfer_length;
     base   += transfer_length;
     length -= transfer_length;
-    total_length += transfer_length;
+    *total_length += transfer_length;
 
     // toggle led
     toggle = toggle^1;
@@ -141,11 +184,49 @@ uint8_t transfer_mem(uint8_t mode,uint32_t base,uint32_t length,uint16_t block_s
       break;
   }
 
-  return transfer_end(result,
-                      total_length,
-                      (timer_now() - start)/10);
+  return result;
 }
 
+uint8_t transfer_mem(uint8_t mode,uint32_t base,uint32_t length,uint16_t block_size)
+{
+  PROF_ENTER(PROF_TRANSFER_MEM);
+  uint8_t result = transfer_begin(mode,length);
+  if(result==TRANSFER_OK) {
+    uint32_t total_length = 0;
+    result = transfer_range(base,length,block_size,&total_length);
+    result = transfer_end(result,total_length);
+  }
+  PROF_EXIT(PROF_TRANSFER_MEM);
+  return result;
+}
+
+#ifdef USE_MEMCMD
+
+uint8_t transfer_mem_list(transfer_range_t *ranges,uint8_t num,uint16_t block_size)
+{
+  uint8_t i;
+  uint32_t length = 0;
+  for(i=0;i<num;i++)
+    length += ranges[i].length;
+
+  uint8_t result = transfer_begin(ranges[0].mode,length);
+  if(result!=TRANSFER_OK)
+    return result;
+
+  // transfer all ranges in a single host transfer
+  uint32_t total_length = 0;
+  for(i=0;i<num;i++) {
+    dtv_transfer_state.mode = ranges[i].mode;
+    result = transfer_range(ranges[i].base,ranges[i].length,block_size,&total_length);
+    if(result!=TRANSFER_OK)
+      break;
+  }
+
+  return transfer_end(result,total_length);
+}
+
+#endif
+
 uint8_t transfer_mem_block(uint8_t mode,uint8_t bank,uint16_t offset,uint16_t length)
 {
   uint8_t result = transfer_begin(mode,length);
@@ -159,9 +240,7 @@ uint8_t transfer_mem_block(uint8_t mode,uint8_t bank,uint16_t offset,uint16_t le
   // trigger a single block transfer
   result = current_dtv_transfer_block_func();
 
-  return transfer_end(result,
-                      dtv_transfer_state.transfer_length,
-                      0);
+  return transfer_end(result,dtv_transfer_state.transfer_length);
 }
 
 // ----- diagnose transfer functions ----------------------------------------
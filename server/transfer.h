@@ -54,8 +54,15 @@
 typedef struct {
   // number of bytes transferred
   uint32_t length;
-  // time in ms of full transfer
+#ifdef USE_HIRES_TIMER
+  // time in us of host setup, block transfers and host teardown
+  uint32_t setup_us;
+  uint32_t data_us;
+  uint32_t end_us;
+#else
+  // time in 10ms of block transfers
   uint16_t ms_time;
+#endif
   // result of last transfer
   uint8_t result;
 } transfer_state_t;
@@ -112,6 +119,26 @@ extern dtv_transfer_block_func_t current_dtv_transfer_block_func;
 // transfer memory from/to host/dtv. updates transfer result (see above)
 extern uint8_t transfer_mem(uint8_t mode,uint32_t base,uint32_t length,uint16_t block_size);
 
+#ifdef USE_MEMCMD
+
+// a range of a transfer list
+typedef struct {
+  // mode: 00=ram 01=rom
+  uint8_t mode;
+  // start address
+  uint32_t base;
+  // number of bytes
+  uint32_t length;
+} transfer_range_t;
+
+// max number of ranges in a transfer list
+#define TRANSFER_MAX_RANGES  8
+
+// transfer a list of memory ranges from/to host/dtv in a single transfer
+extern uint8_t transfer_mem_list(transfer_range_t *ranges,uint8_t num,uint16_t block_size);
+
+#endif
+
 // transfer a single memory block only
 extern uint8_t transfer_mem_block(uint8_t mode,uint8_t bank,uint16_t offset,uint16_t length);
 
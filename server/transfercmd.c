@@ -38,6 +38,7 @@
 #include "param.h"
 #include "timer.h"
 #include "joycmd.h"
+#include "util.h"
 #include "transfercmd.h"
 
 // transfer mode
@@ -70,6 +71,40 @@ static void generic_transfer(void)
   }
 }
 
+#ifdef USE_MEMCMD
+
+static void generic_list_transfer(void)
+{
+  uint8_t num = CMDLINE_ARG_BYTE(0);
+  transfer_range_t ranges[TRANSFER_MAX_RANGES];
+
+  // fetch range descriptors
+  uint8_t status;
+  if((num==0)||(num>TRANSFER_MAX_RANGES)) {
+    status = TRANSFER_ERROR_COMMAND;
+  } else {
+    status = serial_recv_range_list(ranges,num);
+  }
+
+  // perform transfer
+  if(status==TRANSFER_OK) {
+    uint16_t block_size = PARAM_WORD(PARAM_WORD_DTV_TRANSFER_BLOCK_SIZE);
+    status = transfer_mem_list(ranges,num,block_size);
+  } else {
+    transfer_state.result = status;
+  }
+
+#ifdef USE_LCD
+  lcd_print_byte(3,0,'s',status);
+#endif
+
+  if(status!=TRANSFER_OK) {
+    error_condition();
+  }
+}
+
+#endif
+
 #ifdef USE_BLOCKCMD
 
 static void generic_block_transfer(void)
@@ -168,6 +203,48 @@ void exec_write_memory(void)
   generic_transfer();
 }
 
+#ifdef USE_MEMCMD
+
+void exec_write_verify_memory(void)
+{
+  set_write_pointers();
+  // read back each block from the dtv after writing it
+#ifdef USE_DIAGNOSE
+  if(transfer_mode!=TRANSFER_MODE_SERIAL_ONLY)
+#endif
+    current_dtv_transfer_block_func = dtvtrans_send_verify_mem_block;
+  generic_transfer();
+}
+
+// ----- Read/Write Memory Lists -----
+
+void exec_read_memory_list(void)
+{
+  set_read_pointers();
+  generic_list_transfer();
+}
+
+void exec_write_memory_list(void)
+{
+  set_write_pointers();
+  generic_list_transfer();
+}
+
+// ----- CRC Memory -----
+
+void exec_crc_memory(void)
+{
+  // read from dtv but only send block crc16s to host
+  set_read_pointers();
+#ifdef USE_DIAGNOSE
+  if(transfer_mode!=TRANSFER_MODE_DTV_ONLY)
+#endif
+    current_host_transfer_funcs = &serial_host_crc_funcs;
+  generic_transfer();
+}
+
+#endif
+
 // ----- Read/Write Block Memory -----
 
 #ifdef USE_BLOCKCMD
@@ -186,6 +263,99 @@ void exec_block_write_memory(void)
 
 #endif
 
+// ----- Peek/Poke Memory -----
+
+#ifdef USE_MEMCMD
+
+static uint8_t poke_pos;
+
+static uint8_t inline_begin_transfer(uint32_t length)
+{ poke_pos = 0; return TRANSFER_OK; }
+
+static uint8_t inline_end_transfer(uint8_t lastStatus)
+{ return lastStatus; }
+
+static uint8_t inline_check_block(uint16_t crc16)
+{ return TRANSFER_OK; }
+
+static uint8_t peek_byte(uint8_t *data)
+{
+  // send data directly as hex to host
+  uint8_t hex[2];
+  byte_to_hex(*data,hex);
+  if(uart_send_data(hex,2))
+    return TRANSFER_OK;
+  else
+    return TRANSFER_ERROR_CLIENT_TIMEOUT;
+}
+
+static uint8_t poke_byte(uint8_t *data)
+{
+  // fetch data from the command line args
+  *data = CMDLINE_ARG_BYTE(1 + poke_pos);
+  poke_pos++;
+  return TRANSFER_OK;
+}
+
+static host_transfer_funcs_t peek_host_funcs =
+{
+  .begin_transfer = inline_begin_transfer,
+  .end_transfer   = inline_end_transfer,
+  .check_block    = inline_check_block,
+  .transfer_byte  = peek_byte
+};
+
+static host_transfer_funcs_t poke_host_funcs =
+{
+  .begin_transfer = inline_begin_transfer,
+  .end_transfer   = inline_end_transfer,
+  .check_block    = inline_check_block,
+  .transfer_byte  = poke_byte
+};
+
+void exec_peek_memory(void)
+{
+  uint8_t mode = CMDLINE_ARG_BYTE(0);
+  uint8_t len  = CMDLINE_ARG_BYTE(1);
+  uint32_t addr = CMDLINE_ARG_DWORD(0);
+
+  // data bytes are sent as hex in a single line
+  uint8_t status = TRANSFER_ERROR_COMMAND;
+  if((len>0)&&(len<=PEEK_MAX_SIZE)) {
+    current_host_transfer_funcs = &peek_host_funcs;
+    current_dtv_transfer_block_func = dtvtrans_recv_mem_block;
+    status = transfer_mem(mode,addr,len,len);
+
+    // pad missing bytes of a failed transfer to keep the line size
+    uint8_t pos = (uint8_t)transfer_state.length;
+    uint8_t zero = 0;
+    while(pos<len) {
+      peek_byte(&zero);
+      pos++;
+    }
+  }
+  uart_send_crlf();
+  uart_send_hex_byte_crlf(status);
+}
+
+void exec_poke_memory(void)
+{
+  uint8_t mode = CMDLINE_ARG_BYTE(0);
+  uint32_t addr = CMDLINE_ARG_DWORD(0);
+  // use var args here:
+  uint8_t len  = CMDLINE_NUM_ARG_BYTE - 1;
+
+  uint8_t status = TRANSFER_ERROR_COMMAND;
+  if(len>0) {
+    current_host_transfer_funcs = &poke_host_funcs;
+    current_dtv_transfer_block_func = dtvtrans_send_mem_block;
+    status = transfer_mem(mode,addr,len,len);
+  }
+  uart_send_hex_byte_crlf(status);
+}
+
+#endif
+
 // ----- Transfer Mode -----
 
 void exec_transfer_mode(void)
@@ -199,6 +369,13 @@ void exec_transfer_result(void)
 {
   // send result code
   uart_send_hex_byte_crlf(transfer_state.result);
+#ifdef USE_HIRES_TIMER
+  // send durations of setup, data and teardown phase in us
+  uart_send_hex_dword_crlf(transfer_state.setup_us);
+  uart_send_hex_dword_crlf(transfer_state.data_us);
+  uart_send_hex_dword_crlf(transfer_state.end_us);
+#else
   // send transfer time in 10ms
   uart_send_hex_word_crlf(transfer_state.ms_time);
+#endif
 }
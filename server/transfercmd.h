@@ -38,6 +38,19 @@
 void exec_read_memory(void);
 void exec_write_memory(void);
 
+#ifdef USE_MEMCMD
+void exec_write_verify_memory(void);
+void exec_crc_memory(void);
+void exec_read_memory_list(void);
+void exec_write_memory_list(void);
+
+// max number of bytes returned by a peek
+#define PEEK_MAX_SIZE   32
+
+void exec_peek_memory(void);
+void exec_poke_memory(void);
+#endif
+
 void exec_transfer_result(void);
 void exec_transfer_mode(void);
 
@@ -35,6 +35,8 @@
 #include "timer.h"
 #include "param.h"
 #include "display.h"
+#include "stats.h"
+#include "trace.h"
 
 #ifdef UBRR0H
 
@@ -103,6 +105,7 @@ ISR(USART_RX_vect)
   uart_rx_size++;
   if(uart_rx_size == UART_RX_CLR_CTS_POS) {
     uart_set_cts(0);
+    TRACE(TRACE_CTS,0);
   }
 
 //#define CHECK_UART_ERROR
@@ -147,12 +150,16 @@ void uart_start_reception(void)
 uint8_t uart_read(uint8_t *data)
 {
   // read for buffe to be filled
-  timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_SERIAL_READ_AVAIL_TIMEOUT));
-  while(uart_rx_start==uart_rx_end) {
-    if (timer_expired(&t)) {
-      return 0;
+  if(uart_rx_start==uart_rx_end) {
+    timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_SERIAL_READ_AVAIL_TIMEOUT));
+    while(uart_rx_start==uart_rx_end) {
+      if (timer_expired(&t)) {
+        return 0;
+      }
     }
+    STATS_ADD(STATS_RX_WAIT_MS,(uint16_t)(timer_now() - t.start));
   }
+  STATS_INC(STATS_HOST_RX_BYTES);
 
   // read buffer
   cli();
@@ -172,6 +179,7 @@ uint8_t uart_read(uint8_t *data)
   if(size == UART_RX_SET_CTS_POS) {
     led_ready_off();
     uart_set_cts(1);
+    TRACE(TRACE_CTS,1);
   }
 
   return 1;
@@ -183,34 +191,41 @@ uint8_t uart_send(uint8_t data)
 {
 #ifndef IGNORE_RTS
   // wait for RTS with timeout
-  timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_SERIAL_RTS_TIMEOUT));
+  if(uart_get_rts()==0) {
+    timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_SERIAL_RTS_TIMEOUT));
 
 #ifdef SHOW_WAIT_RTS
-  led_ready_on();
+    led_ready_on();
 #endif
-  while(uart_get_rts()==0) {
-    if(timer_expired(&t)) {
+    while(uart_get_rts()==0) {
+      if(timer_expired(&t)) {
 #ifdef SHOW_WAIT_RTS
-      led_ready_off();
+        led_ready_off();
 #endif
-      return 0;
+        return 0;
+      }
     }
-  }
 #ifdef SHOW_WAIT_RTS
-  led_ready_off();
+    led_ready_off();
 #endif
+    STATS_ADD(STATS_RTS_WAIT_MS,(uint16_t)(timer_now() - t.start));
+  }
 #endif
 
   // wait for transmitter to become ready
-  timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_SERIAL_SEND_READY_TIMEOUT));
-  while(!( UCSRA & (1<<UDRE))) {
-    if (timer_expired(&t)) {
-      return 0;
+  if(!( UCSRA & (1<<UDRE))) {
+    timeout_t t = TIMEOUT(PARAM_WORD(PARAM_WORD_SERIAL_SEND_READY_TIMEOUT));
+    while(!( UCSRA & (1<<UDRE))) {
+      if (timer_expired(&t)) {
+        return 0;
+      }
     }
+    STATS_ADD(STATS_UDRE_WAIT_MS,(uint16_t)(timer_now() - t.start));
   }
 
   // send byte
   UDR = data;
+  STATS_INC(STATS_HOST_TX_BYTES);
 
   return 1;
 }
@@ -55,7 +55,7 @@ uint8_t uart_send_crlf(void)
   return uart_send_string((uint8_t *)"\r\n");
 }
 
-static uint8_t buf[6];
+static uint8_t buf[8];
 
 uint8_t uart_send_hex_byte_crlf(uint8_t data)
 {
@@ -84,3 +84,11 @@ uint8_t uart_send_hex_dword6_crlf(uint32_t data)
     return 0;
 }
 
+uint8_t uart_send_hex_dword_crlf(uint32_t data)
+{
+  dword_to_hex(data,buf);
+  if(uart_send_data(buf,8))
+    return uart_send_crlf();
+  else
+    return 0;
+}
@@ -40,6 +40,8 @@ uint8_t uart_send_hex_byte_crlf(uint8_t data);
 uint8_t uart_send_hex_word_crlf(uint16_t data);
 // send a hex6 dword
 uint8_t uart_send_hex_dword6_crlf(uint32_t data);
+// send a hex dword
+uint8_t uart_send_hex_dword_crlf(uint32_t data);
 
 #endif
 
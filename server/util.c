@@ -58,6 +58,12 @@ void dword_to_hex6(uint32_t addr,uint8_t *out)
   word_to_hex((uint16_t)(addr&0xffff),out+2);
 }
 
+void dword_to_hex(uint32_t in,uint8_t *out)
+{
+  word_to_hex((uint16_t)(in>>16),out);
+  word_to_hex((uint16_t)(in&0xffff),out+4);
+}
+
 // parse
 
 uint8_t parse_nybble(uint8_t c,uint8_t *value)
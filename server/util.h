@@ -36,6 +36,8 @@ extern void byte_to_hex(uint8_t in,uint8_t *out);
 extern void word_to_hex(uint16_t in,uint8_t *out);
 // convert dword to 6 hex chars
 extern void dword_to_hex6(uint32_t in,uint8_t *out);
+// convert dword to 8 hex chars
+extern void dword_to_hex(uint32_t in,uint8_t *out);
 
 // ----- parse functions: 01=ok, 00=error -----
 // parse a nybble
@@ -0,0 +1,148 @@
+;
+; disp_srv.asm - resident servlet dispatcher
+;
+; Written by
+;  Christian Vogelgsang <chris@vogelgsang.org>
+;
+; This file is part of dtv2ser.
+; See README for copyright notice.
+;
+;  This program is free software; you can redistribute it and/or modify
+;  it under the terms of the GNU General Public License as published by
+;  the Free Software Foundation; either version 2 of the License, or
+;  (at your option) any later version.
+;
+;  This program is distributed in the hope that it will be useful,
+;  but WITHOUT ANY WARRANTY; without even the implied warranty of
+;  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;  GNU General Public License for more details.
+;
+;  You should have received a copy of the GNU General Public License
+;  along with this program; if not, write to the Free Software
+;  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+;  02111-1307  USA.
+;
+
+  include "dtv.asm"
+  include "zeropage.asm"
+
+  ; ----- memory layout -----
+DISP_ORG     equ $0e00
+DISP_MAILBOX equ $0f00
+DISP_ID      equ DISP_MAILBOX
+DISP_STATUS  equ DISP_MAILBOX+1
+DISP_VECTORS equ DISP_MAILBOX+$20
+DISP_ARGS    equ DISP_MAILBOX+$40
+DISP_MAX_ID  equ 16
+
+  ; ----- variables -----
+  ; kept in the mailbox header so the code image never changes and the
+  ; client can verify it by checksum. the host clears them with each call.
+disp_vec     equ DISP_MAILBOX+2
+acc_save     equ DISP_MAILBOX+4
+x_save       equ DISP_MAILBOX+5
+rem          equ DISP_MAILBOX+6
+sum1         equ DISP_MAILBOX+8
+sum2         equ DISP_MAILBOX+9
+
+  seg   code
+  org   DISP_ORG
+
+  ; ----- jump table ----
+  ; $0e00 - dispatch function in mailbox
+  echo "dispatch",.
+  jmp dispatch
+  ; $0e03 - checksum of memory range (function id 0)
+  echo "checksum",.
+  jmp checksum
+
+  ; ----- dispatch function in mailbox --------------------------------------
+  ; input:
+  ; $0f00: <function id>
+  ; $0f20: <lo>,<hi> vector for each function id
+  ; $0f40: arguments of function
+  ;   acc,x,y: passed to function
+  ;
+  ; output:
+  ; $0f01: 0=ok $ff=unknown function id
+  ;   acc,x,y: returned from function
+dispatch:
+  sta acc_save
+  stx x_save
+
+  ; fetch vector of function
+  lda DISP_ID
+  cmp #DISP_MAX_ID
+  bcs no_func
+  asl
+  tax
+  lda DISP_VECTORS,x
+  sta disp_vec
+  lda DISP_VECTORS+1,x
+  sta disp_vec+1
+  ora disp_vec
+  beq no_func
+
+  ; call function - it returns directly to the caller
+  lda #0
+  sta DISP_STATUS
+  ldx x_save
+  lda acc_save
+  jmp (disp_vec)
+
+no_func:
+  lda #$ff
+  sta DISP_STATUS
+  tax
+  tay
+  rts
+
+  ; ----- checksum of memory range ------------------------------------------
+  ; input:
+  ; $0f40: <addr lo>,<addr hi>,<len lo>,<len hi>
+  ;
+  ; output:
+  ;   acc: 0=ok
+  ;     x: sum of all bytes (mod 256)
+  ;     y: sum of all running sums (mod 256)
+checksum:
+  lda DISP_ARGS
+  sta ptr_zp
+  lda DISP_ARGS+1
+  sta ptr_zp+1
+  lda DISP_ARGS+2
+  sta rem
+  lda DISP_ARGS+3
+  sta rem+1
+  lda #0
+  sta sum1
+  sta sum2
+  ldy #0
+cs_loop:
+  lda rem
+  ora rem+1
+  beq cs_done
+  lda (ptr_zp),y
+  clc
+  adc sum1
+  sta sum1
+  clc
+  adc sum2
+  sta sum2
+  inc ptr_zp
+  bne cs_rem
+  inc ptr_zp+1
+cs_rem:
+  lda rem
+  bne cs_dec
+  dec rem+1
+cs_dec:
+  dec rem
+  jmp cs_loop
+cs_done:
+  lda #0
+  ldx sum1
+  ldy sum2
+  rts
+
+  echo "end",.
@@ -0,0 +1,377 @@
+;
+; pack_srv.asm - memory packer servlet code
+;
+; Written by
+;  Christian Vogelgsang <chris@vogelgsang.org>
+;
+; This file is part of dtv2ser.
+; See README for copyright notice.
+;
+;  This program is free software; you can redistribute it and/or modify
+;  it under the terms of the GNU General Public License as published by
+;  the Free Software Foundation; either version 2 of the License, or
+;  (at your option) any later version.
+;
+;  This program is distributed in the hope that it will be useful,
+;  but WITHOUT ANY WARRANTY; without even the implied warranty of
+;  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;  GNU General Public License for more details.
+;
+;  You should have received a copy of the GNU General Public License
+;  along with this program; if not, write to the Free Software
+;  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+;  02111-1307  USA.
+;
+
+  include "dtv.asm"
+  include "zeropage.asm"
+
+  ; ----- memory layout -----
+PACK_ORG    equ $9000
+PACK_PARAM  equ $9200
+PACK_BUFFER equ $9210
+
+  ; ----- variables -----
+  ; kept between parameters and buffer so the code image stays unchanged
+rem      equ PACK_PARAM+4
+dst_end  equ PACK_PARAM+6
+saved_sp equ PACK_PARAM+8
+max_run  equ PACK_PARAM+9
+run      equ PACK_PARAM+10
+cur      equ PACK_PARAM+11
+lit_cnt  equ PACK_PARAM+12
+tmp      equ PACK_PARAM+13
+sum1     equ PACK_PARAM+14
+sum2     equ PACK_PARAM+15
+
+  ; ----- zero page usage -----
+src_zp  equ ptr_zp
+dst_zp  equ ptr2_zp
+lit_zp  equ tmpptr_zp
+
+  seg   code
+  org   PACK_ORG
+
+  ; ----- jump table ----
+  ; $9000 - pack memory with RLE
+  echo "pack_rle",.
+  jmp pack_rle
+  ; $9003 - unpack LZ stream to memory
+  echo "unpack_lz",.
+  jmp unpack_lz
+
+  ; ----- pack memory with RLE ----------------------------------------------
+  ; input:
+  ; $9200: <src lo>,<src hi>,<len lo>,<len hi>
+  ;
+  ; output:
+  ; $9210: packed stream
+  ;   acc: 0=ok 1=packed stream is not smaller than input
+  ;     x: packed length lo
+  ;     y: packed length hi
+  ;
+  ; stream format:
+  ;   $00-$7f: copy the following n+1 literal bytes
+  ;   $80-$ff: repeat the following byte (n & $7f)+3 times
+RUN_MIN equ 3
+RUN_MAX equ 130
+LIT_MAX equ 128
+
+pack_rle:
+  ; keep stack pointer for overflow abort
+  tsx
+  stx saved_sp
+
+  ; setup pointers
+  lda PACK_PARAM
+  sta src_zp
+  lda PACK_PARAM+1
+  sta src_zp+1
+  lda PACK_PARAM+2
+  sta rem
+  lda PACK_PARAM+3
+  sta rem+1
+  lda #<PACK_BUFFER
+  sta dst_zp
+  lda #>PACK_BUFFER
+  sta dst_zp+1
+
+  ; output must stay below PACK_BUFFER + len
+  clc
+  lda #<PACK_BUFFER
+  adc rem
+  sta dst_end
+  lda #>PACK_BUFFER
+  adc rem+1
+  sta dst_end+1
+
+  lda #0
+  sta lit_cnt
+
+pr_loop:
+  ; all bytes consumed?
+  lda rem
+  ora rem+1
+  beq pr_done
+
+  ; max run = min(rem,RUN_MAX)
+  lda rem+1
+  bne pr_max
+  lda rem
+  cmp #RUN_MAX
+  bcc pr_have_max
+pr_max:
+  lda #RUN_MAX
+pr_have_max:
+  sta max_run
+
+  ; count equal bytes
+  ldy #0
+  lda (src_zp),y
+  sta cur
+  ldx #1
+pr_run:
+  cpx max_run
+  beq pr_run_done
+  txa
+  tay
+  lda (src_zp),y
+  cmp cur
+  bne pr_run_done
+  inx
+  bne pr_run
+pr_run_done:
+  stx run
+  cpx #RUN_MIN
+  bcc pr_literal
+
+  ; emit a run
+  jsr flush_lit
+  lda run
+  clc
+  adc #($80-RUN_MIN)
+  jsr put
+  lda cur
+  jsr put
+  lda run
+  jsr advance
+  jmp pr_loop
+
+  ; collect a literal byte
+pr_literal:
+  lda lit_cnt
+  bne pr_lit_add
+  lda src_zp
+  sta lit_zp
+  lda src_zp+1
+  sta lit_zp+1
+pr_lit_add:
+  inc lit_cnt
+  lda #1
+  jsr advance
+  lda lit_cnt
+  cmp #LIT_MAX
+  bne pr_loop
+  jsr flush_lit
+  jmp pr_loop
+
+pr_done:
+  jsr flush_lit
+
+  ; return packed length
+  sec
+  lda dst_zp
+  sbc #<PACK_BUFFER
+  tax
+  lda dst_zp+1
+  sbc #>PACK_BUFFER
+  tay
+  lda #0
+  rts
+
+  ; --- write pending literals ---
+flush_lit:
+  lda lit_cnt
+  beq fl_done
+  sec
+  sbc #1
+  jsr put
+fl_loop:
+  ldy #0
+  lda (lit_zp),y
+  jsr put
+  inc lit_zp
+  bne fl_next
+  inc lit_zp+1
+fl_next:
+  dec lit_cnt
+  bne fl_loop
+fl_done:
+  rts
+
+  ; --- store acc in output and abort if there is no gain ---
+put:
+  ldy #0
+  sta (dst_zp),y
+  inc dst_zp
+  bne put_chk
+  inc dst_zp+1
+put_chk:
+  lda dst_zp+1
+  cmp dst_end+1
+  bcc put_ok
+  bne put_overflow
+  lda dst_zp
+  cmp dst_end
+  bcs put_overflow
+put_ok:
+  rts
+put_overflow:
+  ; drop all frames and return to caller of pack_rle
+  ldx saved_sp
+  txs
+  lda #1
+  ldx #0
+  ldy #0
+  rts
+
+  ; --- consume acc bytes of input ---
+advance:
+  sta tmp
+  clc
+  lda src_zp
+  adc tmp
+  sta src_zp
+  bcc adv_rem
+  inc src_zp+1
+adv_rem:
+  sec
+  lda rem
+  sbc tmp
+  sta rem
+  bcs adv_done
+  dec rem+1
+adv_done:
+  rts
+
+  ; ----- unpack LZ stream to memory ---------------------------------------
+  ; input:
+  ; $9200: <dst lo>,<dst hi>,<packed len lo>,<packed len hi>
+  ; $9210: packed stream
+  ;
+  ; output:
+  ;   acc: 0=ok
+  ;     x: fletcher16 sum1 of unpacked data
+  ;     y: fletcher16 sum2 of unpacked data
+  ;
+  ; stream format:
+  ;   $00-$7f: copy the following n+1 literal bytes
+  ;   $80-$ff: copy (n & $7f)+3 bytes from output - <off lo>,<off hi>
+MATCH_MIN equ 3
+
+unpack_lz:
+  ; setup pointers
+  lda PACK_PARAM
+  sta dst_zp
+  lda PACK_PARAM+1
+  sta dst_zp+1
+  lda PACK_PARAM+2
+  sta rem
+  lda PACK_PARAM+3
+  sta rem+1
+  lda #<PACK_BUFFER
+  sta src_zp
+  lda #>PACK_BUFFER
+  sta src_zp+1
+
+  lda #0
+  sta sum1
+  sta sum2
+
+ul_loop:
+  ; all bytes consumed?
+  lda rem
+  ora rem+1
+  beq ul_done
+
+  jsr get
+  cmp #$80
+  bcs ul_match
+
+  ; copy literals
+  tax
+  inx
+ul_lit:
+  jsr get
+  jsr out
+  dex
+  bne ul_lit
+  jmp ul_loop
+
+  ; copy a match from output
+ul_match:
+  and #$7f
+  clc
+  adc #MATCH_MIN
+  tax
+  jsr get
+  sta tmp
+  sec
+  lda dst_zp
+  sbc tmp
+  sta lit_zp
+  jsr get
+  sta tmp
+  lda dst_zp+1
+  sbc tmp
+  sta lit_zp+1
+ul_copy:
+  ldy #0
+  lda (lit_zp),y
+  jsr out
+  inc lit_zp
+  bne ul_next
+  inc lit_zp+1
+ul_next:
+  dex
+  bne ul_copy
+  jmp ul_loop
+
+ul_done:
+  lda #0
+  ldx sum1
+  ldy sum2
+  rts
+
+  ; --- fetch next stream byte in acc ---
+get:
+  ldy #0
+  lda (src_zp),y
+  inc src_zp
+  bne get_rem
+  inc src_zp+1
+get_rem:
+  ldy rem
+  bne get_dec
+  dec rem+1
+get_dec:
+  dec rem
+  rts
+
+  ; --- store acc in output and update checksum ---
+out:
+  ldy #0
+  sta (dst_zp),y
+  clc
+  adc sum1
+  sta sum1
+  clc
+  adc sum2
+  sta sum2
+  inc dst_zp
+  bne out_done
+  inc dst_zp+1
+out_done:
+  rts
+
+  echo "end",.